@@ -0,0 +1,700 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "avr_sim.h"
+
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+
+#include "EEPROM.h"
+#include "arduino.h"
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+// Interrupt vectors. Weak so a build links also when the firmware does not
+// define all of them.
+extern "C" void INT0_vect(void) __attribute__((weak));
+extern "C" void TIMER2_COMPA_vect(void) __attribute__((weak));
+extern "C" void TIMER1_CAPT_vect(void) __attribute__((weak));
+extern "C" void USART_RX_vect(void) __attribute__((weak));
+extern "C" void EE_READY_vect(void) __attribute__((weak));
+
+namespace avr_sim {
+
+  Reg8 regs[kNumRegs8];
+  Reg16 regs16[kNumRegs16];
+
+  // Backing values of the registers, as last written.
+  static uint8_t values[kNumRegs8];
+  static uint16_t values16[kNumRegs16];
+
+  static uint64_t now;
+  static bool interrupts_enabled;
+  static bool preemption;
+  static Waveform* rx_waveform;
+  static IsrObserver isr_observer;
+  static bool uart_echo;
+  static uint32_t rising_edges[3][8];
+  static Stats sim_stats;
+
+  // ----- Timer1 -----
+
+  // Timer1 counts from t1_base_count at cycle t1_base_cycle.
+  static uint64_t t1_base_cycle;
+  static uint16_t t1_base_count;
+
+  static uint32_t timer1Prescaler() {
+    switch (values[kTCCR1B] & 0x07) {
+      case 1: return 1;
+      case 2: return 8;
+      case 3: return 64;
+      case 4: return 256;
+      case 5: return 1024;
+      default: return 0;
+    }
+  }
+
+  static uint16_t timer1CountAt(uint64_t cycle) {
+    const uint32_t prescaler = timer1Prescaler();
+    if (!prescaler) {
+      return t1_base_count;
+    }
+    return (uint16_t)(t1_base_count + (cycle - t1_base_cycle) / prescaler);
+  }
+
+  static uint16_t timer1Count() {
+    return timer1CountAt(now);
+  }
+
+  // ICF1 is set by any qualifying ICP1 edge after this cycle.
+  static uint64_t icp1_flag_cleared;
+
+  // Cycle of the first capture event after the given cycle, or zero if none.
+  // ICP1 (PB0) follows the RX waveform. The edge is selected by ICES1 and the
+  // noise canceler (ICNC1) delays the event by four cycles.
+  static uint64_t icp1NextEventAfter(uint64_t after) {
+    if (!rx_waveform) {
+      return 0;
+    }
+    const bool rising = values[kTCCR1B] & (1 << ICES1);
+    const uint64_t delay = (values[kTCCR1B] & (1 << ICNC1)) ? 4 : 0;
+    uint64_t edge_after = after > delay ? after - delay : 0;
+    for (;;) {
+      bool level;
+      const uint64_t edge = rx_waveform->nextEdgeAfter(edge_after, &level);
+      if (!edge) {
+        return 0;
+      }
+      if (level == rising) {
+        return edge + delay;
+      }
+      edge_after = edge;
+    }
+  }
+
+  // ----- Timer2 -----
+
+  static uint64_t t2_base_cycle;
+  static uint8_t t2_base_count;
+  // OCF2A is set by any compare match after this cycle. Moved forward when
+  // the flag is cleared, by software or by entering the ISR.
+  static uint64_t t2_flag_cleared;
+
+  static uint32_t timer2Prescaler() {
+    switch (values[kTCCR2B] & 0x07) {
+      case 1: return 1;
+      case 2: return 8;
+      case 3: return 32;
+      case 4: return 64;
+      case 5: return 128;
+      case 6: return 256;
+      case 7: return 1024;
+      default: return 0;
+    }
+  }
+
+  // Counter top value. Only the modes used by the firmware are modeled: CTC
+  // and fast PWM with OCR2A as top (modes 2 and 7). Other modes count to 0xff.
+  static uint8_t timer2Top() {
+    const uint8_t wgm = (values[kTCCR2A] & 0x03) | ((values[kTCCR2B] >> 1) & 0x04);
+    return (wgm == 2 || wgm == 7) ? values[kOCR2A] : 0xff;
+  }
+
+  // Number of timer ticks from the base count until the counter first equals
+  // OCR2A. A compare match is blocked in the tick of a TCNT2 write, so a
+  // base count equal to OCR2A matches only after a full cycle.
+  static uint32_t timer2TicksToFirstMatch() {
+    const uint8_t top = timer2Top();
+    const uint8_t ocr = values[kOCR2A];
+    const uint8_t base = t2_base_count;
+    if (base < ocr) {
+      return ocr - base;
+    }
+    if (base <= top) {
+      return (top - base) + 1 + ocr;
+    }
+    // Above top, counts up to 0xff before wrapping around.
+    return (0x100 - base) + ocr;
+  }
+
+  static uint8_t timer2Count() {
+    const uint32_t prescaler = timer2Prescaler();
+    if (!prescaler) {
+      return t2_base_count;
+    }
+    const uint64_t ticks = (now - t2_base_cycle) / prescaler;
+    const uint32_t period = (uint32_t)timer2Top() + 1;
+    const uint8_t base = t2_base_count;
+    if (base < period) {
+      return (uint8_t)((base + ticks) % period);
+    }
+    if (ticks < (uint64_t)(0x100 - base)) {
+      return (uint8_t)(base + ticks);
+    }
+    return (uint8_t)((ticks - (0x100 - base)) % period);
+  }
+
+  // Cycle of the first compare match strictly after the given cycle, or
+  // zero if the timer is stopped.
+  static uint64_t timer2NextMatchAfter(uint64_t after) {
+    const uint32_t prescaler = timer2Prescaler();
+    if (!prescaler) {
+      return 0;
+    }
+    const uint64_t period = ((uint64_t)timer2Top() + 1) * prescaler;
+    uint64_t match = t2_base_cycle + (uint64_t)timer2TicksToFirstMatch() * prescaler;
+    if (match <= after) {
+      match += ((after - match) / period + 1) * period;
+    }
+    return match;
+  }
+
+  // ----- Pins -----
+
+  static uint8_t pinValue(uint8_t port_reg, uint8_t pin_reg) {
+    // Outputs read back the port value. Inputs are pulled up unless
+    // driven by the simulation.
+    uint8_t result = values[port_reg] | ~values[port_reg - 1];
+    // The RX waveform drives both PD2 (INT0) and PB0 (ICP1).
+    if (rx_waveform && !rx_waveform->levelAt(now)) {
+      if (pin_reg == kPIND) {
+        result &= ~(1 << 2);
+      } else if (pin_reg == kPINB) {
+        result &= ~(1 << 0);
+      }
+    }
+    return result;
+  }
+
+  // ----- INT0 -----
+
+  // INTF0 is set by any qualifying RX edge after this cycle.
+  static uint64_t int0_flag_cleared;
+
+  // Cycle of the first RX edge after the given cycle that matches the INT0
+  // sense control, or zero if none. Low level sensing is not modeled.
+  static uint64_t int0NextEventAfter(uint64_t after) {
+    if (!rx_waveform) {
+      return 0;
+    }
+    const uint8_t sense = values[kEICRA] & 0x03;
+    for (;;) {
+      bool level;
+      const uint64_t edge = rx_waveform->nextEdgeAfter(after, &level);
+      if (!edge || sense == 1 || (sense == 2 && !level) || (sense == 3 && level)) {
+        return edge;
+      }
+      after = edge;
+    }
+  }
+
+  static void trackRisingEdges(uint8_t port_index, uint8_t old_value, uint8_t new_value) {
+    const uint8_t rising = new_value & ~old_value;
+    for (uint8_t i = 0; i < 8; i++) {
+      if (rising & (1 << i)) {
+        rising_edges[port_index][i]++;
+      }
+    }
+  }
+
+  // ----- EEPROM -----
+
+  static uint8_t eeprom_cells[kEepromSize];
+  static uint32_t eeprom_writes[kEepromSize];
+  // Write in progress, committed to the cell at eeprom_write_end.
+  static bool eeprom_busy;
+  static uint16_t eeprom_write_address;
+  static uint8_t eeprom_write_value;
+  static uint64_t eeprom_write_end;
+  // Not modeled as a register side effect, the level triggered EE_READY
+  // interrupt has no flag.
+  static uint64_t eeprom_ready_serviced;
+
+  struct EepromInit {
+    EepromInit() { eepromErase(); }
+  };
+  static EepromInit eeprom_init;
+
+  // Completes a write whose time is up.
+  static void eepromUpdate() {
+    if (eeprom_busy && now >= eeprom_write_end) {
+      eeprom_cells[eeprom_write_address] = eeprom_write_value;
+      eeprom_writes[eeprom_write_address]++;
+      eeprom_busy = false;
+    }
+  }
+
+  static void eepromControl(uint8_t value) {
+    eepromUpdate();
+    const uint16_t address = values16[kEEAR] & (kEepromSize - 1);
+    // EERE and EEPE are ignored during a write. EEMPE is not timed out.
+    if (!eeprom_busy && (value & (1 << EEPE)) && (values[kEECR] & (1 << EEMPE))) {
+      eeprom_busy = true;
+      eeprom_write_address = address;
+      eeprom_write_value = values[kEEDR];
+      eeprom_write_end = now + kEepromWriteCycles;
+      value &= ~(1 << EEMPE);
+    } else if (!eeprom_busy && (value & (1 << EERE))) {
+      values[kEEDR] = eeprom_cells[address];
+      now += 4;
+    }
+    // Strobes. EEPE reads back the write in progress.
+    values[kEECR] = value & ~((1 << EERE) | (1 << EEPE));
+  }
+
+  // EE_READY is a level: raised for as long as no write is in progress.
+  static uint64_t eepromReadyNextEventAfter(uint64_t after) {
+    if (eeprom_busy && eeprom_write_end > after) {
+      return eeprom_write_end;
+    }
+    return after + 1;
+  }
+
+  uint8_t* eeprom() {
+    return eeprom_cells;
+  }
+
+  void eepromErase() {
+    memset(eeprom_cells, 0xff, sizeof(eeprom_cells));
+    memset(eeprom_writes, 0, sizeof(eeprom_writes));
+    eeprom_busy = false;
+  }
+
+  uint32_t eepromWrites(uint16_t address) {
+    return eeprom_writes[address & (kEepromSize - 1)];
+  }
+
+  void eepromPowerLoss() {
+    eepromUpdate();
+    if (!eeprom_busy) {
+      return;
+    }
+    const uint64_t elapsed = now + kEepromWriteCycles - eeprom_write_end;
+    uint8_t* const cell = &eeprom_cells[eeprom_write_address];
+    if (elapsed < kEepromWriteCycles / 2) {
+      *cell = 0xff;
+    } else {
+      // Programming clears bits. Some of them did not make it.
+      *cell = eeprom_write_value | (uint8_t)(elapsed * 0x9e3779b1u >> 24);
+    }
+    eeprom_writes[eeprom_write_address]++;
+    eeprom_busy = false;
+  }
+
+  // ----- UART -----
+
+  // TX: the byte in the shift register is out at tx_shift_end. The one
+  // written after it waits in UDR0 until then.
+  static uint64_t tx_shift_end;
+  static uint64_t tx_udr_empty_at;
+
+  // RX: bytes on the line, with the cycle they are complete.
+  struct RxByte {
+    RxByte(uint64_t e, uint8_t v) : end(e), value(v) {}
+    uint64_t end;
+    uint8_t value;
+  };
+  static std::deque<RxByte> rx_line;
+  // Received and not read yet, at most two.
+  static std::deque<uint8_t> rx_fifo;
+  static bool rx_overrun;
+  // Not modeled as a register side effect, RXC0 is a level.
+  static uint64_t rx_serviced;
+
+  static uint64_t uartByteCycles() {
+    const uint32_t ubrr = ((uint32_t)(values[kUBRR0H] & 0x0f) << 8) | values[kUBRR0L];
+    const uint32_t bit_cycles = ((values[kUCSR0A] & (1 << U2X0)) ? 8 : 16) * (ubrr + 1);
+    return 10 * (uint64_t)bit_cycles;
+  }
+
+  // Moves the bytes completed by now into the receiver.
+  static void uartUpdate() {
+    while (!rx_line.empty() && rx_line.front().end <= now) {
+      if (!(values[kUCSR0B] & (1 << RXEN0))) {
+        // Receiver off, ignored.
+      } else if (rx_fifo.size() < 2) {
+        rx_fifo.push_back(rx_line.front().value);
+      } else {
+        rx_overrun = true;
+      }
+      rx_line.pop_front();
+    }
+  }
+
+  static uint8_t uartStatus() {
+    uartUpdate();
+    uint8_t result = values[kUCSR0A] & ~((1 << RXC0) | (1 << UDRE0) | (1 << DOR0));
+    if (now >= tx_udr_empty_at) {
+      result |= 1 << UDRE0;
+    }
+    if (!rx_fifo.empty()) {
+      result |= 1 << RXC0;
+    }
+    if (rx_overrun) {
+      result |= 1 << DOR0;
+    }
+    return result;
+  }
+
+  static uint8_t uartRead() {
+    uartUpdate();
+    if (rx_fifo.empty()) {
+      return 0;
+    }
+    const uint8_t b = rx_fifo.front();
+    rx_fifo.pop_front();
+    rx_overrun = false;
+    return b;
+  }
+
+  static void uartWrite(uint8_t value) {
+    if (uart_echo) {
+      fputc(value, stdout);
+    }
+    if (!(values[kUCSR0B] & (1 << TXEN0))) {
+      return;
+    }
+    // Moves to the shift register when the previous byte is out.
+    const uint64_t start = tx_shift_end > now ? tx_shift_end : now;
+    tx_udr_empty_at = start;
+    tx_shift_end = start + uartByteCycles();
+  }
+
+  // RXC0 is a level: raised for as long as the receiver holds a byte.
+  static uint64_t uartRxNextEventAfter(uint64_t after) {
+    uartUpdate();
+    if (!rx_fifo.empty()) {
+      return after + 1;
+    }
+    for (size_t i = 0; i < rx_line.size(); i++) {
+      if (rx_line[i].end > after) {
+        return rx_line[i].end;
+      }
+    }
+    return 0;
+  }
+
+  void uartReceive(const uint8_t* data, size_t n) {
+    uint64_t end = uartRxIdleCycle();
+    for (size_t i = 0; i < n; i++) {
+      end += uartByteCycles();
+      rx_line.push_back(RxByte(end, data[i]));
+    }
+  }
+
+  uint64_t uartRxIdleCycle() {
+    return (!rx_line.empty() && rx_line.back().end > now) ? rx_line.back().end : now;
+  }
+
+  // ----- Register access -----
+
+  // Runs the interrupts that are due, if preemption is on. Called before
+  // each register access from the main code. ISRs run with interrupts
+  // disabled so this does not nest.
+  static void preempt() {
+    if (preemption && interrupts_enabled) {
+      runUntil(now);
+    }
+  }
+
+  uint8_t readReg(uint8_t id) {
+    preempt();
+    now += kIoAccessCycles;
+    switch (id) {
+      case kPINB: return pinValue(kPORTB, kPINB);
+      case kPINC: return pinValue(kPORTC, kPINC);
+      case kPIND: return pinValue(kPORTD, kPIND);
+      case kTCNT2: return timer2Count();
+      case kTIFR2: {
+        const uint64_t match = timer2NextMatchAfter(t2_flag_cleared);
+        return match && match <= now ? 1 << OCF2A : 0;
+      }
+      case kUCSR0A: return uartStatus();
+      case kUDR0: return uartRead();
+      case kEECR:
+        eepromUpdate();
+        return values[kEECR] | (eeprom_busy ? 1 << EEPE : 0);
+      default: return values[id];
+    }
+  }
+
+  void writeReg(uint8_t id, uint8_t value) {
+    preempt();
+    now += kIoAccessCycles;
+    const uint8_t old_value = values[id];
+    switch (id) {
+      case kPORTB: trackRisingEdges(0, old_value, value); break;
+      case kPORTC: trackRisingEdges(1, old_value, value); break;
+      case kPORTD: trackRisingEdges(2, old_value, value); break;
+      case kTCNT2:
+        t2_base_cycle = now;
+        t2_base_count = value;
+        break;
+      case kTCCR2B:
+        // Restart counting from the current value with the new clock.
+        t2_base_count = timer2Count();
+        t2_base_cycle = now;
+        break;
+      case kTCCR1B: {
+        // Rebase to the last tick, keeping the prescaler phase. The input
+        // capture ISR writes this register on every edge.
+        const uint32_t prescaler = timer1Prescaler();
+        if (prescaler) {
+          const uint64_t ticks = (now - t1_base_cycle) / prescaler;
+          t1_base_count += ticks;
+          t1_base_cycle += ticks * prescaler;
+        }
+        break;
+      }
+      case kUDR0:
+        uartWrite(value);
+        return;
+      case kEECR:
+        eepromControl(value);
+        return;
+    }
+    // Writing one to an interrupt flag clears it. The flags are derived
+    // from the event times so only the clearing time is kept.
+    if (id == kTIFR2 && (value & (1 << OCF2A))) {
+      t2_flag_cleared = now;
+    }
+    if (id == kEIFR && (value & (1 << INTF0))) {
+      int0_flag_cleared = now;
+    }
+    if (id == kTIFR1 && (value & (1 << ICF1))) {
+      icp1_flag_cleared = now;
+    }
+    if (id == kTIFR1 || id == kTIFR2 || id == kEIFR) {
+      value = 0;
+    }
+    values[id] = value;
+  }
+
+  uint16_t readReg16(uint8_t id) {
+    preempt();
+    now += 2 * kIoAccessCycles;
+    if (id == kTCNT1) {
+      return timer1Count();
+    }
+    return values16[id];
+  }
+
+  void writeReg16(uint8_t id, uint16_t value) {
+    preempt();
+    now += 2 * kIoAccessCycles;
+    if (id == kTCNT1) {
+      t1_base_count = value;
+      t1_base_cycle = now;
+    }
+    values16[id] = value;
+  }
+
+  void disableInterrupts() {
+    now += 1;
+    interrupts_enabled = false;
+  }
+
+  void enableInterrupts() {
+    now += 1;
+    interrupts_enabled = true;
+    preempt();
+  }
+
+  // ----- Simulation control -----
+
+  void reset() {
+    memset(values, 0, sizeof(values));
+    memset(values16, 0, sizeof(values16));
+    memset(rising_edges, 0, sizeof(rising_edges));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    now = 0;
+    interrupts_enabled = false;
+    eeprom_busy = false;
+    eeprom_ready_serviced = 0;
+    t1_base_cycle = 0;
+    t1_base_count = 0;
+    t2_base_cycle = 0;
+    t2_base_count = 0;
+    t2_flag_cleared = 0;
+    int0_flag_cleared = 0;
+    icp1_flag_cleared = 0;
+    tx_shift_end = 0;
+    tx_udr_empty_at = 0;
+    rx_line.clear();
+    rx_fifo.clear();
+    rx_overrun = false;
+    rx_serviced = 0;
+  }
+
+  uint64_t cycle() {
+    return now;
+  }
+
+  void spend(uint32_t cycles) {
+    now += cycles;
+  }
+
+  void setRxWaveform(Waveform* waveform) {
+    rx_waveform = waveform;
+  }
+
+  void setPreemption(bool preempt) {
+    preemption = preempt;
+  }
+
+  void setIsrObserver(IsrObserver observer) {
+    isr_observer = observer;
+  }
+
+  void setUartEcho(bool echo) {
+    uart_echo = echo;
+  }
+
+  uint32_t risingEdges(char port, uint8_t bit_index) {
+    return rising_edges[port - 'B'][bit_index & 7];
+  }
+
+  const Stats& stats() {
+    return sim_stats;
+  }
+
+  static void callIsr(Vector vector_id, void (*vector)(void)) {
+    const uint64_t start = now;
+    now += kIsrEntryCycles;
+    interrupts_enabled = false;
+    const std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+    vector();
+    const std::chrono::steady_clock::time_point host_end = std::chrono::steady_clock::now();
+    interrupts_enabled = true;
+    now += kIsrExitCycles;
+    sim_stats.isr_calls++;
+    sim_stats.vector_calls[vector_id]++;
+    sim_stats.isr_cycles += now - start;
+    if (isr_observer) {
+      isr_observer(vector_id, start, now, std::chrono::duration_cast<std::chrono::nanoseconds>(
+          host_end - host_start).count());
+    }
+  }
+
+  typedef uint64_t (*NextEventFunction)(uint64_t after);
+
+  // Returns the cycle at which an interrupt flag was first set after it was
+  // last cleared, or zero if it is not set up to 'limit'.
+  static uint64_t flagSetAt(NextEventFunction next_event_after, uint64_t cleared,
+      uint64_t limit) {
+    const uint64_t event = next_event_after(cleared);
+    return (event && event <= limit) ? event : 0;
+  }
+
+  // Count the events between the one that set the flag and now. They found
+  // the flag already set and were lost.
+  static void countLostEvents(NextEventFunction next_event_after, uint64_t event) {
+    for (uint64_t e = next_event_after(event); e && e <= now; e = next_event_after(e)) {
+      sim_stats.lost_interrupts++;
+    }
+  }
+
+  // Returns the last event of a flag between the one that set it and now.
+  static uint64_t lastEvent(NextEventFunction next_event_after, uint64_t event) {
+    for (uint64_t e = next_event_after(event); e && e <= now; e = next_event_after(e)) {
+      event = e;
+    }
+    return event;
+  }
+
+  void runUntil(uint64_t end_cycle) {
+    while (interrupts_enabled) {
+      // Interrupt sources in vector priority order.
+      struct Source {
+        void (*vector)(void);
+        bool enabled;
+        NextEventFunction next_event_after;
+        uint64_t* flag_cleared;
+      };
+      const Source sources[kNumVectors] = {
+        { INT0_vect, (values[kEIMSK] & (1 << INT0)) != 0, int0NextEventAfter,
+          &int0_flag_cleared },
+        { TIMER2_COMPA_vect, (values[kTIMSK2] & (1 << OCIE2A)) != 0, timer2NextMatchAfter,
+          &t2_flag_cleared },
+        { TIMER1_CAPT_vect, (values[kTIMSK1] & (1 << ICIE1)) != 0, icp1NextEventAfter,
+          &icp1_flag_cleared },
+        { USART_RX_vect, (values[kUCSR0B] & (1 << RXCIE0)) != 0, uartRxNextEventAfter,
+          &rx_serviced },
+        { EE_READY_vect, (values[kEECR] & (1 << EERIE)) != 0, eepromReadyNextEventAfter,
+          &eeprom_ready_serviced },
+      };
+
+      // Find the earliest enabled interrupt whose flag gets set before
+      // end_cycle. If several flags are set already the lower vector number
+      // wins, as on the AVR.
+      int vector_id = kNumVectors;
+      uint64_t event = 0;
+      for (int i = 0; i < kNumVectors; i++) {
+        const Source& source = sources[i];
+        if (!source.vector || !source.enabled) {
+          continue;
+        }
+        const uint64_t e = flagSetAt(source.next_event_after, *source.flag_cleared, end_cycle);
+        if (e && (!event || (e < event && event > now))) {
+          vector_id = i;
+          event = e;
+        }
+      }
+      if (vector_id == kNumVectors) {
+        break;
+      }
+      const Source& source = sources[vector_id];
+
+      // An event that happened while another ISR was running was pending
+      // and is serviced right away.
+      if (now < event) {
+        now = event;
+      }
+      if (vector_id != kUsartRxVector && vector_id != kEeReadyVector) {
+        countLostEvents(source.next_event_after, event);
+      }
+      if (vector_id == kTimer1CaptVector) {
+        // ICR1 is overwritten by every capture event, pending or not.
+        values16[kICR1] = timer1CountAt(lastEvent(source.next_event_after, event));
+      }
+      // Entering the ISR clears the flag.
+      *source.flag_cleared = now;
+      callIsr(static_cast<Vector>(vector_id), source.vector);
+    }
+    if (now < end_cycle) {
+      now = end_cycle;
+    }
+  }
+}  // namespace avr_sim
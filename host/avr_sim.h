@@ -0,0 +1,248 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AVR_SIM_H
+#define AVR_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// A minimal ATmega328P stand-in for running the lin_processor library on a
+// Linux host. Registers are objects whose reads and writes are routed through
+// the simulator, which keeps a virtual 16Mhz cycle counter, models Timer1 and
+// Timer2, the EEPROM and UART0 and drives the LIN RX pins (PD2 and ICP1/PB0) from a
+// recorded waveform.
+//
+// Time only moves forward when the firmware touches a register (each access
+// is charged a few cycles) or when the simulator jumps to the next interrupt.
+// This is enough for the busy loops in the ISR to time out correctly but it is
+// NOT a cycle accurate model. Treat cycle counts as rough estimates.
+namespace avr_sim {
+
+  // A digital signal given as a list of level transitions in CPU cycles.
+  // Queries are expected with non decreasing cycles, as the simulation
+  // time only moves forward.
+  class Waveform {
+   public:
+    Waveform() : initial_level_(true), cursor_(0) {}
+
+    // Append a transition. Cycles must be strictly increasing.
+    void addEdge(uint64_t cycle, bool level) {
+      edges_.push_back(Edge(cycle, level));
+    }
+
+    bool levelAt(uint64_t cycle) {
+      while (cursor_ < edges_.size() && edges_[cursor_].cycle <= cycle) {
+        cursor_++;
+      }
+      return cursor_ ? edges_[cursor_ - 1].level : initial_level_;
+    }
+
+    // Find the first transition strictly after the given cycle. Returns its
+    // cycle and sets *level to the new level, or returns zero if none. Does
+    // not move the query cursor.
+    uint64_t nextEdgeAfter(uint64_t cycle, bool* level) const {
+      size_t lo = 0;
+      size_t hi = edges_.size();
+      while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (edges_[mid].cycle <= cycle) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      if (lo == edges_.size()) {
+        return 0;
+      }
+      *level = edges_[lo].level;
+      return edges_[lo].cycle;
+    }
+
+    // Cycle of the last transition, zero if none.
+    uint64_t lastEdgeCycle() const {
+      return edges_.empty() ? 0 : edges_.back().cycle;
+    }
+
+   private:
+    struct Edge {
+      Edge(uint64_t c, bool l) : cycle(c), level(l) {}
+      uint64_t cycle;
+      bool level;
+    };
+    const bool initial_level_;
+    std::vector<Edge> edges_;
+    // Index of the first edge after the last query.
+    size_t cursor_;
+  };
+
+  // Register identifiers. Used to dispatch the register side effects.
+  enum RegId {
+    kPINB, kDDRB, kPORTB,
+    kPINC, kDDRC, kPORTC,
+    kPIND, kDDRD, kPORTD,
+    kTCCR1A, kTCCR1B, kTIMSK1, kTIFR1,
+    kTCCR2A, kTCCR2B, kTCNT2, kOCR2A, kOCR2B, kTIMSK2, kTIFR2,
+    kUBRR0H, kUBRR0L, kUCSR0A, kUCSR0B, kUCSR0C, kUDR0,
+    kEICRA, kEIMSK, kEIFR,
+    kEECR, kEEDR,
+    kNumRegs8
+  };
+
+  enum Reg16Id {
+    kTCNT1, kOCR1A, kOCR1B, kICR1,
+    kEEAR,
+    kNumRegs16
+  };
+
+  extern uint8_t readReg(uint8_t id);
+  extern void writeReg(uint8_t id, uint8_t value);
+  extern uint16_t readReg16(uint8_t id);
+  extern void writeReg16(uint8_t id, uint16_t value);
+
+  // An 8 bit I/O register. The register id is its index in regs[].
+  class Reg8 {
+   public:
+    inline uint8_t id() const;
+    operator uint8_t() const { return readReg(id()); }
+    Reg8& operator=(uint8_t v) { writeReg(id(), v); return *this; }
+    Reg8& operator|=(uint8_t v) { writeReg(id(), readReg(id()) | v); return *this; }
+    Reg8& operator&=(uint8_t v) { writeReg(id(), readReg(id()) & v); return *this; }
+    Reg8& operator^=(uint8_t v) { writeReg(id(), readReg(id()) ^ v); return *this; }
+  };
+
+  // A 16 bit I/O register. The AVR temp byte is not modeled.
+  class Reg16 {
+   public:
+    inline uint8_t id() const;
+    operator uint16_t() const { return readReg16(id()); }
+    Reg16& operator=(uint16_t v) { writeReg16(id(), v); return *this; }
+  };
+
+  extern Reg8 regs[kNumRegs8];
+  extern Reg16 regs16[kNumRegs16];
+
+  inline uint8_t Reg8::id() const {
+    return static_cast<uint8_t>(this - regs);
+  }
+
+  inline uint8_t Reg16::id() const {
+    return static_cast<uint8_t>(this - regs16);
+  }
+
+  // Global interrupt enable flag (SREG I bit).
+  extern void disableInterrupts();
+  extern void enableInterrupts();
+
+  // ----- Simulation control -----
+
+  // Cycles charged for each register access.
+  const uint32_t kIoAccessCycles = 2;
+  // Cycles charged for entering and leaving an ISR (vector jump, register
+  // push/pop, reti).
+  const uint32_t kIsrEntryCycles = 20;
+  const uint32_t kIsrExitCycles = 20;
+
+  // Reset all registers and the cycle counter.
+  extern void reset();
+
+  // Current virtual cycle.
+  extern uint64_t cycle();
+
+  // Charge extra cycles to the current execution context.
+  extern void spend(uint32_t cycles);
+
+  // Drive the LIN RX pins (PD2 and PB0) from the given waveform. The waveform must
+  // outlive the simulation. Null means idle (recessive, high).
+  extern void setRxWaveform(Waveform* waveform);
+
+  // Run interrupts until the given cycle. Code between interrupts (the
+  // 'main loop') is executed by the caller after this returns.
+  extern void runUntil(uint64_t end_cycle);
+
+  // If true, interrupts that are due also run on every register access of
+  // the code between runUntil() calls, while interrupts are enabled, as on
+  // the chip. Needed when that code busy waits on a register. Off by
+  // default.
+  extern void setPreemption(bool preempt);
+
+  // Interrupt vectors known to the simulator, in AVR priority order.
+  enum Vector {
+    kInt0Vector,
+    kTimer2CompAVector,
+    kTimer1CaptVector,
+    kUsartRxVector,
+    kEeReadyVector,
+    kNumVectors
+  };
+
+  // Called after each ISR invocation. host_ns is the host wall time spent in
+  // the ISR body.
+  typedef void (*IsrObserver)(Vector vector, uint64_t start_cycle, uint64_t end_cycle,
+      uint64_t host_ns);
+  extern void setIsrObserver(IsrObserver observer);
+
+  // Number of low to high transitions written to the given PORTx bit.
+  // port is 'B', 'C' or 'D'. Useful to follow the debugging pins.
+  extern uint32_t risingEdges(char port, uint8_t bit_index);
+
+  // If true, bytes written to UDR0 are echoed to stdout.
+  extern void setUartEcho(bool echo);
+
+  // ----- UART -----
+
+  // UART0 sends and receives 10 bit frames at the rate set by UBRR0 and U2X0.
+  // UDRE0 is set while the data register is empty, so output is paced. The
+  // receiver holds two bytes. A byte received when both are taken is lost
+  // and sets DOR0 until UDR0 is read.
+
+  // Queues bytes on the RX line. They are sent back to back, starting now
+  // or after the bytes queued before. Dropped if the receiver is disabled.
+  extern void uartReceive(const uint8_t* data, size_t n);
+
+  // Cycle at which the RX line is idle again.
+  extern uint64_t uartRxIdleCycle();
+
+  // ----- EEPROM -----
+
+  const uint16_t kEepromSize = 1024;
+  // Cycles of an atomic erase and write of one byte, 3.4 ms.
+  const uint32_t kEepromWriteCycles = 54400;
+
+  // The EEPROM contents. Kept by reset(), as on the chip, and erased (0xff)
+  // at program start.
+  extern uint8_t* eeprom();
+
+  // Erase all cells and clear the write counters.
+  extern void eepromErase();
+
+  // Number of erase and write cycles of a cell.
+  extern uint32_t eepromWrites(uint16_t address);
+
+  // Cuts the power. A write in progress ends and leaves its cell torn:
+  // erased in the first half of the write, else partly programmed. Call
+  // reset() to boot again.
+  extern void eepromPowerLoss();
+
+  struct Stats {
+    uint64_t isr_calls;
+    uint64_t isr_cycles;
+    // Interrupt events that occurred while the same interrupt flag was
+    // already pending and thus were lost.
+    uint64_t lost_interrupts;
+    uint64_t vector_calls[kNumVectors];
+  };
+  extern const Stats& stats();
+}  // namespace avr_sim
+
+#endif
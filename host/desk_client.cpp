@@ -0,0 +1,260 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desk_client.h"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+  int64_t nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+}  // namespace
+
+DeskClient::DeskClient(int fd)
+  : fd_(fd),
+    handler_(NULL),
+    handler_context_(NULL) {
+}
+
+int DeskClient::openSerial(const char* path) {
+  const int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct termios tio;
+  if (tcgetattr(fd, &tio) != 0) {
+    close(fd);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  cfsetispeed(&tio, B115200);
+  cfsetospeed(&tio, B115200);
+  tio.c_cflag |= CLOCAL | CREAD;
+  if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool DeskClient::send(uint8_t type, const uint8_t* body, uint8_t body_length) {
+  uint8_t wire[desk_protocol::kMaxWirePacket];
+  const uint8_t n = desk_protocol::encodePacket(type, body, body_length, wire);
+  if (!n) {
+    return false;
+  }
+  uint8_t sent = 0;
+  while (sent < n) {
+    const ssize_t r = write(fd_, wire + sent, n - sent);
+    if (r < 0 && errno != EINTR) {
+      return false;
+    }
+    if (r > 0) {
+      sent += r;
+    }
+  }
+  return true;
+}
+
+bool DeskClient::receive(Packet* packet, int timeout_ms) {
+  const int64_t deadline = nowMillis() + timeout_ms;
+  for (;;) {
+    uint8_t buffer[64];
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    const int64_t left = deadline - nowMillis();
+    if (left <= 0) {
+      return false;
+    }
+    const int p = poll(&pfd, 1, (int)left);
+    if (p < 0 && errno != EINTR) {
+      return false;
+    }
+    if (p <= 0) {
+      continue;
+    }
+    // One byte at a time so that the bytes after a packet stay unread.
+    const ssize_t r = read(fd_, buffer, 1);
+    if (r < 0 && errno != EINTR && errno != EAGAIN) {
+      return false;
+    }
+    if (r == 1 && reader_.handleByte(buffer[0])) {
+      packet->type = reader_.type();
+      packet->body_length = reader_.body_length();
+      memcpy(packet->body, reader_.body(), packet->body_length);
+      return true;
+    }
+  }
+}
+
+bool DeskClient::waitFor(uint8_t type, Packet* packet, int timeout_ms) {
+  const int64_t deadline = nowMillis() + timeout_ms;
+  for (;;) {
+    const int64_t left = deadline - nowMillis();
+    if (left <= 0 || !receive(packet, (int)left)) {
+      return false;
+    }
+    if (packet->type == type) {
+      return true;
+    }
+    if (handler_) {
+      handler_(*packet, handler_context_);
+    }
+  }
+}
+
+int DeskClient::request(uint8_t type, const uint8_t* body, uint8_t body_length,
+    int timeout_ms) {
+  if (!send(type, body, body_length)) {
+    return kTimeout;
+  }
+  const int64_t deadline = nowMillis() + timeout_ms;
+  Packet packet;
+  for (;;) {
+    const int64_t left = deadline - nowMillis();
+    if (left <= 0 || !waitFor(desk_protocol::messages::ACK, &packet, (int)left)) {
+      return kTimeout;
+    }
+    // An ACK of an earlier, timed out request is skipped.
+    if (packet.body_length == 2 && packet.body[0] == type) {
+      return packet.body[1];
+    }
+  }
+}
+
+bool DeskClient::getStatus(Status* status, int timeout_ms) {
+  if (!send(desk_protocol::messages::GET_STATUS, NULL, 0)) {
+    return false;
+  }
+  Packet packet;
+  if (!waitFor(desk_protocol::messages::STATUS, &packet, timeout_ms) ||
+      packet.body_length != 12) {
+    return false;
+  }
+  status->position = desk_protocol::getU16(packet.body);
+  status->target = desk_protocol::getU16(packet.body + 2);
+  status->memory[0] = desk_protocol::getU16(packet.body + 4);
+  status->memory[1] = desk_protocol::getU16(packet.body + 6);
+  status->threshold = packet.body[8];
+  status->direction = packet.body[9];
+  status->speed = (int16_t)desk_protocol::getU16(packet.body + 10);
+  return true;
+}
+
+int DeskClient::moveTo(uint16_t position) {
+  uint8_t body[2];
+  desk_protocol::putU16(body, position);
+  return request(desk_protocol::messages::MOVE_TO, body, sizeof(body));
+}
+
+int DeskClient::stop() {
+  return request(desk_protocol::messages::STOP, NULL, 0);
+}
+
+bool DeskClient::getMemory(uint8_t slot, uint16_t* position, int timeout_ms) {
+  if (!send(desk_protocol::messages::GET_MEMORY, &slot, 1)) {
+    return false;
+  }
+  const int64_t deadline = nowMillis() + timeout_ms;
+  Packet packet;
+  for (;;) {
+    const int64_t left = deadline - nowMillis();
+    if (left <= 0 || !receive(&packet, (int)left)) {
+      return false;
+    }
+    if (packet.type == desk_protocol::messages::MEMORY && packet.body_length == 3 &&
+        packet.body[0] == slot) {
+      *position = desk_protocol::getU16(packet.body + 1);
+      return true;
+    }
+    if (packet.type == desk_protocol::messages::ACK && packet.body_length == 2 &&
+        packet.body[0] == desk_protocol::messages::GET_MEMORY) {
+      return false;
+    }
+    if (handler_) {
+      handler_(packet, handler_context_);
+    }
+  }
+}
+
+int DeskClient::setMemory(uint8_t slot, uint16_t position) {
+  uint8_t body[3] = {slot};
+  desk_protocol::putU16(body + 1, position);
+  return request(desk_protocol::messages::SET_MEMORY, body, sizeof(body));
+}
+
+int DeskClient::storeMemory(uint8_t slot) {
+  return request(desk_protocol::messages::STORE_MEMORY, &slot, 1);
+}
+
+int DeskClient::moveToMemory(uint8_t slot) {
+  return request(desk_protocol::messages::MOVE_TO_MEMORY, &slot, 1);
+}
+
+int DeskClient::setThreshold(uint8_t threshold) {
+  return request(desk_protocol::messages::SET_THRESHOLD, &threshold, 1);
+}
+
+int DeskClient::setLinDump(bool enable) {
+  const uint8_t body = enable;
+  return request(desk_protocol::messages::SET_LIN_DUMP, &body, 1);
+}
+
+int DeskClient::armTrace(uint8_t triggers, uint8_t id, uint16_t position_jump,
+    uint8_t post_trigger_percent) {
+  uint8_t body[5] = {triggers, id};
+  desk_protocol::putU16(body + 2, position_jump);
+  body[4] = post_trigger_percent;
+  return request(desk_protocol::messages::TRACE_ARM, body, sizeof(body));
+}
+
+bool DeskClient::dumpTrace(std::vector<uint8_t>* block, int timeout_ms) {
+  block->clear();
+  if (!send(desk_protocol::messages::TRACE_DUMP, NULL, 0)) {
+    return false;
+  }
+  // The deadline moves with every packet, the dump takes a while.
+  int64_t deadline = nowMillis() + timeout_ms;
+  Packet packet;
+  for (;;) {
+    const int64_t left = deadline - nowMillis();
+    if (left <= 0 || !receive(&packet, (int)left)) {
+      return false;
+    }
+    if (packet.type == desk_protocol::messages::TRACE_DATA && packet.body_length >= 2) {
+      if (desk_protocol::getU16(packet.body) != block->size()) {
+        return false;
+      }
+      block->insert(block->end(), packet.body + 2, packet.body + packet.body_length);
+      deadline = nowMillis() + timeout_ms;
+      continue;
+    }
+    if (packet.type == desk_protocol::messages::ACK && packet.body_length == 2 &&
+        packet.body[0] == desk_protocol::messages::TRACE_DUMP) {
+      return packet.body[1] == desk_protocol::results::OK;
+    }
+    if (handler_) {
+      handler_(packet, handler_context_);
+    }
+  }
+}
+
+int DeskClient::textMode() {
+  return request(desk_protocol::messages::TEXT_MODE, NULL, 0);
+}
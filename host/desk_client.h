@@ -0,0 +1,108 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DESK_CLIENT_H
+#define DESK_CLIENT_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "desk_protocol.h"
+
+// Host side client of the desk controller binary protocol (see
+// src/desk_protocol.h) over a serial port or any other file descriptor.
+// Text printed by the controller between packets is skipped.
+class DeskClient {
+ public:
+  struct Packet {
+    uint8_t type;
+    uint8_t body[desk_protocol::kMaxBody];
+    uint8_t body_length;
+  };
+
+  struct Status {
+    uint16_t position;
+    uint16_t target;
+    uint16_t memory[2];
+    uint8_t threshold;
+    uint8_t direction;
+    // Units per second, positive is up.
+    int16_t speed;
+  };
+
+  // Returned by request() when no ACK arrived in time.
+  static const int kTimeout = -1;
+
+  // Called with the packets that are not the reply to a pending request
+  // (POSITION, LIN_FRAME, LIN_ERRORS, unsolicited STATUS).
+  typedef void (*PacketHandler)(const Packet& packet, void* context);
+
+  // fd is not owned.
+  explicit DeskClient(int fd);
+
+  // Opens a serial device raw at 115200 baud. Returns the fd or -1.
+  static int openSerial(const char* path);
+
+  void setPacketHandler(PacketHandler handler, void* context) {
+    handler_ = handler;
+    handler_context_ = context;
+  }
+
+  bool send(uint8_t type, const uint8_t* body, uint8_t body_length);
+
+  // Waits up to timeout_ms for the next packet. Returns false on timeout
+  // or read error.
+  bool receive(Packet* packet, int timeout_ms);
+
+  // Sends a request and waits for its ACK. Returns the ACK result (see
+  // desk_protocol::results) or kTimeout.
+  int request(uint8_t type, const uint8_t* body, uint8_t body_length,
+      int timeout_ms = kDefaultTimeoutMs);
+
+  bool getStatus(Status* status, int timeout_ms = kDefaultTimeoutMs);
+  int moveTo(uint16_t position);
+  int stop();
+  // False for a slot that is not valid.
+  bool getMemory(uint8_t slot, uint16_t* position, int timeout_ms = kDefaultTimeoutMs);
+  int setMemory(uint8_t slot, uint16_t position);
+  int storeMemory(uint8_t slot);
+  int moveToMemory(uint8_t slot);
+  int setThreshold(uint8_t threshold);
+  int setLinDump(bool enable);
+  // Restarts the LIN trace recorder. triggers are lin_trace_format::triggers
+  // bits.
+  int armTrace(uint8_t triggers, uint8_t id, uint16_t position_jump,
+      uint8_t post_trigger_percent);
+  // Stops the LIN trace recorder and reads its block (see
+  // lin_trace_format.h). False on timeout, a gap or an error ACK.
+  bool dumpTrace(std::vector<uint8_t>* block, int timeout_ms = kDefaultTimeoutMs);
+  // Switches the controller back to text commands.
+  int textMode();
+
+  // Non empty byte runs that were not valid packets, text included.
+  uint16_t bad_packets() const {
+    return reader_.bad_packets();
+  }
+
+ private:
+  static const int kDefaultTimeoutMs = 1000;
+
+  // Waits for a packet of the given type. Others go to the handler.
+  bool waitFor(uint8_t type, Packet* packet, int timeout_ms);
+
+  const int fd_;
+  desk_protocol::PacketReader reader_;
+  PacketHandler handler_;
+  void* handler_context_;
+};
+
+#endif
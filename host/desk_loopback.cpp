@@ -0,0 +1,412 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Loopback test of the binary serial protocol. DeskClient talks over a
+// pseudo terminal to a stand-in of the controller that uses the same
+// desk_protocol code as the firmware and mixes text lines, unsolicited
+// packets and a corrupted packet into its output. Also reads a LIN trace
+// dump. Exits non zero on failure.
+//
+// Usage: desk_loopback
+
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+#include "desk_client.h"
+#include "desk_protocol.h"
+#include "lin_trace_file.h"
+
+namespace {
+  int failures = 0;
+
+  void check(bool ok, const char* what) {
+    if (!ok) {
+      fprintf(stderr, "FAIL: %s\n", what);
+      failures++;
+    }
+  }
+
+  void writeAll(int fd, const void* data, size_t n) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (n) {
+      const ssize_t r = write(fd, p, n);
+      if (r <= 0) {
+        return;
+      }
+      p += r;
+      n -= r;
+    }
+  }
+
+  // The controller side, simplified from src/main.cpp.
+  class FakeDesk {
+   public:
+    // As the default custom_defs::kNumPresets.
+    static const uint8_t kPresets = 8;
+
+    explicit FakeDesk(int fd)
+      : fd_(fd), binary_(false), position_(1200), target_(1200), threshold_(120),
+        stop_(false) {
+      for (uint8_t i = 0; i < kPresets; i++) {
+        memory_[i] = 3500;
+      }
+    }
+
+    void run() {
+      writeText("IKEA Hackant v1.0\r\nType 'HELP' to display all commands.\r\n");
+      while (!stop_) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 20) <= 0) {
+          continue;
+        }
+        uint8_t b;
+        if (read(fd_, &b, 1) != 1) {
+          continue;
+        }
+        if (b == 0) {
+          binary_ = true;
+        }
+        if (binary_ && reader_.handleByte(b)) {
+          handlePacket();
+        }
+      }
+    }
+
+    void stop() {
+      stop_ = true;
+    }
+
+   private:
+    void writeText(const char* text) {
+      writeAll(fd_, text, strlen(text));
+    }
+
+    void sendPacket(uint8_t type, const uint8_t* body, uint8_t n) {
+      uint8_t wire[desk_protocol::kMaxWirePacket];
+      writeAll(fd_, wire, desk_protocol::encodePacket(type, body, n, wire));
+    }
+
+    void sendAck(uint8_t type, uint8_t result) {
+      const uint8_t body[2] = {type, result};
+      sendPacket(desk_protocol::messages::ACK, body, 2);
+    }
+
+    // A position frame and an error, in TRACE_DATA packets of 12 bytes.
+    void sendTrace() {
+      using namespace lin_trace_format;
+      const uint8_t frame[] = {0x92, 0xb0, 0x04, 0xb9};
+      const uint8_t records = 2 * kRecordHeaderBytes + sizeof(frame) + 1;
+      uint8_t block[kHeaderBytes + records] = {kMagic0, kMagic1, kVersion, triggers::ERROR};
+      desk_protocol::putU16(block + kTicksPerMilliOffset, 250);
+      desk_protocol::putU16(block + kBaudOffset, 19200);
+      desk_protocol::putU16(block + kRecordBytesOffset, records);
+      desk_protocol::putU16(block + kLostRecordsOffset, 3);
+      uint8_t* p = block + kHeaderBytes;
+      *p++ = kindAndCount(kinds::FRAME, sizeof(frame));
+      desk_protocol::putU16(p, 0x5678);
+      desk_protocol::putU16(p + 2, 0x0012);
+      p[4] = 0x05;
+      memcpy(p + 5, frame, sizeof(frame));
+      p += 5 + sizeof(frame);
+      *p++ = kindAndCount(kinds::ERROR, 1);
+      desk_protocol::putU16(p, 0x5700);
+      desk_protocol::putU16(p + 2, 0x0012);
+      p[4] = 0x10;
+      p[5] = 0x12;
+      for (uint16_t offset = 0; offset < sizeof(block); offset += 12) {
+        uint8_t data[14];
+        const uint8_t n = sizeof(block) - offset < 12 ? sizeof(block) - offset : 12;
+        desk_protocol::putU16(data, offset);
+        memcpy(data + 2, block + offset, n);
+        sendPacket(desk_protocol::messages::TRACE_DATA, data, 2 + n);
+      }
+    }
+
+    static bool inRange(uint16_t position) {
+      return position > 150 && position < 6400;
+    }
+
+    void handlePacket() {
+      using namespace desk_protocol;
+      const uint8_t type = reader_.type();
+      const uint8_t* body = reader_.body();
+      const uint8_t n = reader_.body_length();
+      uint8_t result = results::OK;
+      switch (type) {
+        case messages::GET_STATUS: {
+          uint8_t status[12];
+          putU16(status, position_);
+          putU16(status + 2, target_);
+          putU16(status + 4, memory_[0]);
+          putU16(status + 6, memory_[1]);
+          status[8] = threshold_;
+          status[9] = 0;
+          putU16(status + 10, (uint16_t)-42);
+          sendPacket(messages::STATUS, status, sizeof(status));
+          return;
+        }
+        case messages::MOVE_TO:
+          if (n != 2) {
+            result = results::BAD_REQUEST;
+          } else if (!inRange(getU16(body))) {
+            result = results::OUT_OF_RANGE;
+          } else {
+            target_ = getU16(body);
+            // The table moves: position updates, a button message and a
+            // line hit, before the ACK.
+            for (uint16_t p = position_; p != target_; p += (target_ > p ? 1 : -1)) {
+              if ((p % 100) == 0) {
+                uint8_t pos[4];
+                putU16(pos, p);
+                putU16(pos + 2, 350);
+                sendPacket(messages::POSITION, pos, 4);
+              }
+            }
+            position_ = target_;
+            writeText("Button UP Pressed\r\n");
+            const uint8_t corrupt[] = {0x00, 0x03, 0x01, 0x55, 0x00};
+            writeAll(fd_, corrupt, sizeof(corrupt));
+            const uint8_t frame[] = {0x0f, 0x92, 0x00, 0x00, 0x12, 0x34, 0x6d};
+            sendPacket(messages::LIN_FRAME, frame, sizeof(frame));
+          }
+          break;
+        case messages::STOP:
+          target_ = position_;
+          break;
+        case messages::SET_MEMORY:
+          if (n != 3 || body[0] < 1 || body[0] > kPresets) {
+            result = results::BAD_REQUEST;
+          } else if (!inRange(getU16(body + 1))) {
+            result = results::OUT_OF_RANGE;
+          } else {
+            memory_[body[0] - 1] = getU16(body + 1);
+          }
+          break;
+        case messages::STORE_MEMORY:
+          if (n != 1 || body[0] < 1 || body[0] > kPresets) {
+            result = results::BAD_REQUEST;
+          } else {
+            memory_[body[0] - 1] = position_;
+          }
+          break;
+        case messages::MOVE_TO_MEMORY:
+          if (n != 1 || body[0] < 1 || body[0] > kPresets) {
+            result = results::BAD_REQUEST;
+          } else {
+            target_ = memory_[body[0] - 1];
+          }
+          break;
+        case messages::GET_MEMORY:
+          if (n != 1 || body[0] < 1 || body[0] > kPresets) {
+            result = results::BAD_REQUEST;
+          } else {
+            uint8_t reply[3] = {body[0]};
+            putU16(reply + 1, memory_[body[0] - 1]);
+            sendPacket(messages::MEMORY, reply, sizeof(reply));
+            return;
+          }
+          break;
+        case messages::SET_THRESHOLD:
+          if (n != 1) {
+            result = results::BAD_REQUEST;
+          } else if (body[0] <= 50 || body[0] >= 254) {
+            result = results::OUT_OF_RANGE;
+          } else {
+            threshold_ = body[0];
+          }
+          break;
+        case messages::TRACE_ARM:
+          if (n != 5 || body[4] > 100) {
+            result = results::BAD_REQUEST;
+          }
+          break;
+        case messages::TRACE_DUMP:
+          sendTrace();
+          break;
+        case messages::TEXT_MODE:
+          sendAck(type, result);
+          binary_ = false;
+          writeText("Text mode. Type 'HELP' to display all commands.\r\n");
+          return;
+        default:
+          result = results::BAD_REQUEST;
+          break;
+      }
+      sendAck(type, result);
+    }
+
+    const int fd_;
+    desk_protocol::PacketReader reader_;
+    bool binary_;
+    uint16_t position_;
+    uint16_t target_;
+    uint16_t memory_[kPresets];
+    uint8_t threshold_;
+    std::atomic<bool> stop_;
+  };
+
+  struct Unsolicited {
+    Unsolicited() : positions(0), last_position(0), last_speed(0), lin_frames(0) {}
+    int positions;
+    uint16_t last_position;
+    int16_t last_speed;
+    int lin_frames;
+  };
+
+  void onPacket(const DeskClient::Packet& packet, void* context) {
+    Unsolicited* u = static_cast<Unsolicited*>(context);
+    if (packet.type == desk_protocol::messages::POSITION && packet.body_length == 4) {
+      u->positions++;
+      u->last_position = desk_protocol::getU16(packet.body);
+      u->last_speed = (int16_t)desk_protocol::getU16(packet.body + 2);
+    } else if (packet.type == desk_protocol::messages::LIN_FRAME) {
+      u->lin_frames++;
+    }
+  }
+
+  void testCodec() {
+    // CRC-8/SMBUS check value.
+    const char* digits = "123456789";
+    check(desk_protocol::crc8(reinterpret_cast<const uint8_t*>(digits), 9) == 0xf4, "crc8");
+
+    uint32_t random_state = 1;
+    for (int round = 0; round < 2000; round++) {
+      uint8_t in[desk_protocol::kMaxPacket];
+      uint8_t encoded[desk_protocol::kMaxPacket + 1];
+      uint8_t decoded[desk_protocol::kMaxPacket + 1];
+      const uint8_t n = 1 + round % desk_protocol::kMaxPacket;
+      for (uint8_t i = 0; i < n; i++) {
+        random_state = random_state * 1103515245 + 12345;
+        // Plenty of zeros.
+        in[i] = (random_state >> 16) & 3 ? 0 : (random_state >> 8);
+      }
+      const uint8_t e = desk_protocol::cobsEncode(in, n, encoded);
+      if (e != n + 1 || memchr(encoded, 0, e) ||
+          desk_protocol::cobsDecode(encoded, e, decoded) != n || memcmp(in, decoded, n)) {
+        check(false, "COBS round trip");
+        return;
+      }
+    }
+  }
+}  // namespace
+
+int main() {
+  testCodec();
+
+  const int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) {
+    perror("posix_openpt");
+    return 2;
+  }
+  const int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    perror("open pty");
+    return 2;
+  }
+  // Raw, as a serial port opened by DeskClient::openSerial().
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  FakeDesk desk(slave);
+  std::thread desk_thread(&FakeDesk::run, &desk);
+
+  DeskClient client(master);
+  Unsolicited unsolicited;
+  client.setPacketHandler(onPacket, &unsolicited);
+
+  DeskClient::Status status;
+  check(client.getStatus(&status), "getStatus");
+  check(status.position == 1200 && status.target == 1200, "initial position");
+  check(status.memory[0] == 3500 && status.threshold == 120, "initial settings");
+  // The banner printed in text mode.
+  check(client.bad_packets() == 1, "banner skipped");
+
+  check(client.moveTo(1580) == desk_protocol::results::OK, "moveTo");
+  check(unsolicited.positions == 4 && unsolicited.last_position == 1500, "positions");
+  check(unsolicited.last_speed == 350, "position speed");
+  check(unsolicited.lin_frames == 1, "LIN frame dump");
+  // The text line and the corrupted packet.
+  check(client.bad_packets() == 3, "noise skipped");
+  check(client.moveTo(10) == desk_protocol::results::OUT_OF_RANGE, "moveTo range");
+
+  check(client.setMemory(2, 2000) == desk_protocol::results::OK, "setMemory");
+  check(client.setMemory(9, 2000) == desk_protocol::results::BAD_REQUEST, "setMemory slot");
+  check(client.setMemory(8, 3100) == desk_protocol::results::OK, "setMemory last slot");
+  uint16_t memory = 0;
+  check(client.getMemory(8, &memory) && memory == 3100, "getMemory");
+  check(!client.getMemory(0, &memory), "getMemory slot");
+  check(client.storeMemory(1) == desk_protocol::results::OK, "storeMemory");
+  check(client.setThreshold(20) == desk_protocol::results::OUT_OF_RANGE, "setThreshold range");
+  check(client.setThreshold(100) == desk_protocol::results::OK, "setThreshold");
+  check(client.moveToMemory(2) == desk_protocol::results::OK, "moveToMemory");
+  check(client.request(0xfe, NULL, 0) == desk_protocol::results::BAD_REQUEST, "unknown request");
+
+  check(client.getStatus(&status), "getStatus after");
+  check(status.position == 1580 && status.target == 2000, "position after");
+  check(status.memory[0] == 1580 && status.memory[1] == 2000, "memories after");
+  check(status.threshold == 100, "threshold after");
+  check(status.speed == -42, "speed");
+
+  check(client.armTrace(lin_trace_format::triggers::ERROR, 0, 100, 50) ==
+      desk_protocol::results::OK, "armTrace");
+  std::vector<uint8_t> block;
+  lin_trace_file::Trace trace;
+  std::string error;
+  check(client.dumpTrace(&block), "dumpTrace");
+  check(lin_trace_file::parse(block.data(), block.size(), &trace, &error), "trace parse");
+  check(trace.records.size() == 2 && trace.lost_records == 3 &&
+      trace.cause == lin_trace_format::triggers::ERROR, "trace header");
+  if (trace.records.size() == 2) {
+    check(trace.records[0].kind == lin_trace_format::kinds::FRAME &&
+        trace.records[0].ticks == 0x125678 && trace.records[0].count == 4 &&
+        trace.records[0].bytes[1] == 0xb0, "trace frame");
+    check(trace.records[1].kind == lin_trace_format::kinds::ERROR &&
+        trace.records[1].flags == 0x10 && trace.records[1].bytes[0] == 0x12, "trace error");
+  }
+  block.pop_back();
+  check(!lin_trace_file::parse(block.data(), block.size(), &trace, &error),
+      "truncated trace");
+
+  check(client.textMode() == desk_protocol::results::OK, "textMode");
+  char text[64];
+  size_t n = 0;
+  while (n < sizeof(text) - 1) {
+    struct pollfd pfd = {master, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) <= 0 || read(master, text + n, 1) != 1 || text[n] == '\n') {
+      break;
+    }
+    n++;
+  }
+  text[n] = 0;
+  check(!strncmp(text, "Text mode.", 10), "text after textMode");
+
+  desk.stop();
+  desk_thread.join();
+  close(slave);
+  close(master);
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("desk_loopback: all checks passed\n");
+  return 0;
+}
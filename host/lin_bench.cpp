@@ -0,0 +1,368 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host benchmark of the LIN decoder. Generates a random LIN schedule as a bit
+// level waveform, runs the lin_processor ISR against it in the simulator and
+// reports decoding results and ISR cost per decoder state.
+//
+// Usage: lin_bench [--frames N] [--baud-error PERCENT] [--jitter PERCENT]
+//                  [--poll-us N] [--seed N] [--id N]
+//                  [--checksums classic|enhanced|mixed]
+//
+// --jitter moves each edge randomly by up to the given percent of a bit time.
+// --id subscribes to a single frame id (e.g. 0x12) so the decoder drops the
+// other frames. --checksums selects the LIN version of the frames, mixed
+// uses the enhanced checksum for odd ids. Default is the configured version.
+// Build once per LIN_DECODER backend to compare them.
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "avr_sim.h"
+#include "custom_defs.h"
+#include "hardware_clock.h"
+#include "isr_latency.h"
+#include "isr_profiler.h"
+#include "lin_processor.h"
+#include "lin_wave.h"
+
+namespace {
+  struct Options {
+    Options() : frames(5000), baud_error_percent(0), jitter_percent(0), poll_us(1000),
+        seed(1), id(-1),
+        checksums(custom_defs::kUseLinChecksumVersion2 ? kEnhanced : kClassic) {}
+    enum Checksums { kClassic, kEnhanced, kMixed };
+    uint32_t frames;
+    double baud_error_percent;
+    double jitter_percent;
+    uint32_t poll_us;
+    uint32_t seed;
+    // Subscribed frame id, -1 for all.
+    int id;
+    Checksums checksums;
+  };
+
+  Options options;
+
+  // ISR cost of one decoder state.
+  struct StateCost {
+    StateCost() : calls(0), cycles(0), max_cycles(0), host_ns(0) {}
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t max_cycles;
+    uint64_t host_ns;
+
+    void add(uint64_t c, uint64_t ns) {
+      calls++;
+      cycles += c;
+      if (c > max_cycles) {
+        max_cycles = c;
+      }
+      host_ns += ns;
+    }
+  };
+
+  // The sample debug pin (PB4) pulses once per StateReadData::handleIsr().
+  // Every other bit tick is a StateDetectBreak::handleIsr(). RX edge
+  // interrupts are break detection in the edge triggered mode.
+  const uint8_t kSamplePinBit = 4;
+  StateCost detect_break_cost;
+  StateCost read_data_cost;
+  StateCost rx_edge_cost;
+  StateCost rx_capture_cost;
+  uint32_t last_sample_edges;
+
+  void isrObserver(avr_sim::Vector vector, uint64_t start_cycle, uint64_t end_cycle,
+      uint64_t host_ns) {
+    const uint32_t sample_edges = avr_sim::risingEdges('B', kSamplePinBit);
+    StateCost* cost = &detect_break_cost;
+    if (vector == avr_sim::kInt0Vector) {
+      cost = &rx_edge_cost;
+    } else if (vector == avr_sim::kTimer1CaptVector) {
+      cost = &rx_capture_cost;
+    } else if (sample_edges != last_sample_edges) {
+      cost = &read_data_cost;
+    }
+    last_sample_edges = sample_edges;
+    cost->add(end_cycle - start_cycle, host_ns);
+  }
+
+  // Deterministic across platforms, unlike rand().
+  uint32_t random_state;
+  uint32_t nextRandom(uint32_t range) {
+    random_state = random_state * 1103515245 + 12345;
+    return ((random_state >> 8) & 0xffffff) % range;
+  }
+
+  LinFrameSpec randomFrame() {
+    LinFrameSpec spec;
+    // About a third of the traffic is the desk position frame.
+    // Includes the diagnostic frames 0x3c and 0x3d.
+    spec.id = nextRandom(3) == 0 ? 0x12 : nextRandom(0x3e);
+    spec.num_data_bytes = 1 + nextRandom(8);
+    for (uint8_t i = 0; i < spec.num_data_bytes; i++) {
+      spec.data[i] = nextRandom(256);
+    }
+    switch (options.checksums) {
+      case Options::kClassic: spec.enhanced_checksum = false; break;
+      case Options::kEnhanced: spec.enhanced_checksum = true; break;
+      case Options::kMixed: spec.enhanced_checksum = spec.id & 1; break;
+    }
+    // Diagnostic frames always use the classic checksum.
+    if (spec.id >= 0x3c) {
+      spec.enhanced_checksum = false;
+    }
+    spec.inter_byte_bits = nextRandom(3);
+    spec.response_space_bits = nextRandom(5);
+    return spec;
+  }
+
+  bool parseArgs(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+      const char* arg = argv[i];
+      const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+      if (!value) {
+        return false;
+      }
+      if (!strcmp(arg, "--frames")) {
+        options->frames = strtoul(value, NULL, 10);
+      } else if (!strcmp(arg, "--baud-error")) {
+        options->baud_error_percent = strtod(value, NULL);
+      } else if (!strcmp(arg, "--jitter")) {
+        options->jitter_percent = strtod(value, NULL);
+      } else if (!strcmp(arg, "--poll-us")) {
+        options->poll_us = strtoul(value, NULL, 10);
+      } else if (!strcmp(arg, "--seed")) {
+        options->seed = strtoul(value, NULL, 10);
+      } else if (!strcmp(arg, "--id")) {
+        options->id = strtol(value, NULL, 0) & 0x3f;
+      } else if (!strcmp(arg, "--checksums")) {
+        if (!strcmp(value, "classic")) {
+          options->checksums = Options::kClassic;
+        } else if (!strcmp(value, "enhanced")) {
+          options->checksums = Options::kEnhanced;
+        } else if (!strcmp(value, "mixed")) {
+          options->checksums = Options::kMixed;
+        } else {
+          return false;
+        }
+      } else {
+        return false;
+      }
+      i++;
+    }
+    return options->frames > 0 && options->poll_us > 0;
+  }
+
+  bool sameBytes(const LinFrame& frame, const uint8_t* bytes, uint8_t n) {
+    if (frame.num_bytes() != n) {
+      return false;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+      if (frame.get_byte(i) != bytes[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void printCost(const char* name, const StateCost& cost, double host_seconds) {
+    const double avg = cost.calls ? (double)cost.cycles / cost.calls : 0;
+    const double ns = cost.calls ? (double)cost.host_ns / cost.calls : 0;
+    printf("  %-14s calls %10llu  avg %7.1f cycles  max %7llu cycles  host %6.1f ns/call"
+        "  %12.0f calls/s\n",
+        name, (unsigned long long)cost.calls, avg, (unsigned long long)cost.max_cycles, ns,
+        host_seconds > 0 ? cost.calls / host_seconds : 0);
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!parseArgs(argc, argv, &options)) {
+    fprintf(stderr, "Usage: %s [--frames N] [--baud-error PERCENT] [--jitter PERCENT]"
+        " [--poll-us N] [--seed N] [--id N] [--checksums classic|enhanced|mixed]\n", argv[0]);
+    return 2;
+  }
+  random_state = options.seed;
+
+  // Generate the bus waveform up front so generation is not benchmarked.
+  avr_sim::Waveform wave;
+  LinWaveBuilder builder(&wave, custom_defs::kLinSpeed, options.baud_error_percent);
+  builder.setEdgeJitter(options.jitter_percent / 100.0, options.seed);
+  std::vector<LinFrameSpec> sent;
+  sent.reserve(options.frames);
+  // Cycle at the end of each frame's last stop bit.
+  std::vector<uint64_t> sent_end_cycles;
+  sent_end_cycles.reserve(options.frames);
+  builder.idle(20);
+  for (uint32_t i = 0; i < options.frames; i++) {
+    sent.push_back(randomFrame());
+    builder.frame(sent.back());
+    sent_end_cycles.push_back(builder.endCycle());
+    // The decoder ends a frame after kMaxSpaceBits of silence so the inter
+    // frame space must be longer than that.
+    builder.idle(10 + nextRandom(20));
+  }
+  builder.idle(20);
+
+  // The frames the decoder should report.
+  std::vector<uint32_t> expected;
+  for (uint32_t i = 0; i < sent.size(); i++) {
+    if (options.id < 0 || sent[i].id == options.id) {
+      expected.push_back(i);
+    }
+  }
+
+  avr_sim::reset();
+  avr_sim::setRxWaveform(&wave);
+  avr_sim::setIsrObserver(isrObserver);
+  hardware_clock::setup();
+  lin_processor::setup();
+  if (options.id >= 0) {
+    lin_processor::subscribe(options.id, NULL);
+  }
+  sei();
+
+  // Run the ISRs, with the main loop draining the frame queue every poll_us.
+  const uint64_t poll_cycles = (uint64_t)options.poll_us * (F_CPU / 1000000);
+  const uint64_t end_cycle = builder.endCycle();
+  uint32_t next_expected = 0;
+  uint32_t decoded_ok = 0;
+  uint32_t decoded_valid = 0;
+  uint32_t dropped = 0;
+  uint32_t corrupted = 0;
+  uint32_t error_counts[8] = { 0 };
+  // Host time in readNextFrame(). The capture backend decodes there.
+  uint64_t read_host_ns = 0;
+  uint64_t read_calls = 0;
+  // Frame timestamp() minus the actual end of the frame, in hardware clock
+  // ticks.
+  int32_t min_stamp_error = INT32_MAX;
+  int32_t max_stamp_error = INT32_MIN;
+
+  const std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+  for (uint64_t t = 0; t < end_cycle;) {
+    t += poll_cycles;
+    avr_sim::runUntil(t);
+
+    const uint8_t errors = lin_processor::getAndClearErrorFlags();
+    for (uint8_t i = 0; i < 8; i++) {
+      if (errors & (1 << i)) {
+        error_counts[i]++;
+      }
+    }
+
+    LinFrame frame;
+    for (;;) {
+      const std::chrono::steady_clock::time_point read_start = std::chrono::steady_clock::now();
+      const bool has_frame = lin_processor::readNextFrame(&frame);
+      read_host_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - read_start).count();
+      read_calls++;
+      if (!has_frame) {
+        break;
+      }
+      if (frame.isValid()) {
+        decoded_valid++;
+      }
+      // Match against the next few sent frames. Skipped ones were dropped.
+      const uint32_t kLookahead = 32;
+      bool matched = false;
+      for (uint32_t i = next_expected; i < expected.size() && i < next_expected + kLookahead;
+          i++) {
+        uint8_t bytes[10];
+        const uint8_t n = lin_wire::expectedBytes(sent[expected[i]], bytes);
+        if (sameBytes(frame, bytes, n)) {
+          // The hardware clock counts from cycle zero at 64 cycles per tick.
+          const int32_t error = (int16_t)(frame.timestamp() -
+              (uint16_t)(sent_end_cycles[expected[i]] / 64));
+          min_stamp_error = std::min(min_stamp_error, error);
+          max_stamp_error = std::max(max_stamp_error, error);
+          dropped += i - next_expected;
+          next_expected = i + 1;
+          matched = true;
+          break;
+        }
+      }
+      if (matched) {
+        decoded_ok++;
+      } else {
+        corrupted++;
+      }
+    }
+  }
+  const double host_seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - host_start).count();
+  dropped += expected.size() - next_expected;
+
+  const avr_sim::Stats& stats = avr_sim::stats();
+  const double sim_seconds = (double)end_cycle / F_CPU;
+  printf("LIN decoder bench (%s): %u baud, baud error %.2f%%, jitter %.1f%%, poll %u us,"
+      " seed %u\n", LIN_DECODER == LIN_DECODER_CAPTURE ? "input capture" : "timer2",
+      (unsigned)custom_defs::kLinSpeed, options.baud_error_percent, options.jitter_percent,
+      options.poll_us, options.seed);
+  printf("Frames: sent %u  expected %u  decoded %u  valid %u  dropped %u (%.3f%%)"
+      "  corrupted %u\n", options.frames, (unsigned)expected.size(), decoded_ok, decoded_valid,
+      dropped, expected.empty() ? 0.0 : 100.0 * dropped / expected.size(), corrupted);
+  printf("Frame timestamps: %d to %d ticks (%d to %d us) after the frame end\n",
+      decoded_ok ? min_stamp_error : 0, decoded_ok ? max_stamp_error : 0,
+      decoded_ok ? min_stamp_error * 4 : 0, decoded_ok ? max_stamp_error * 4 : 0);
+  printf("Error flags raised:");
+  for (uint8_t i = 0; i < 7; i++) {
+    printf(" %u", error_counts[i]);
+  }
+  printf("  (SHRT LONG STRT STOP SYNC OVRN OTHR)\n");
+  printf("Simulated: %.3f s, %llu bits\n", sim_seconds, (unsigned long long)builder.bits());
+  printf("ISR cost by state:\n");
+  printCost("DETECT_BREAK", detect_break_cost, host_seconds);
+  printCost("READ_DATA", read_data_cost, host_seconds);
+  printCost("RX_EDGE", rx_edge_cost, host_seconds);
+  printCost("RX_CAPTURE", rx_capture_cost, host_seconds);
+  printf("Simulated ISR entries: %.0f/s  CPU load in ISR: %.1f%%  lost interrupts: %llu\n",
+      stats.isr_calls / sim_seconds, 100.0 * stats.isr_cycles / end_cycle,
+      (unsigned long long)stats.lost_interrupts);
+#if LIN_ISR_PROFILER
+  // The firmware's own view, in whole hardware clock ticks.
+  const uint32_t sim_millis = end_cycle / (F_CPU / 1000);
+  printf("isr_profiler:\n");
+  for (uint8_t i = 0; i < isr_profiler::kNumSlots; i++) {
+    isr_profiler::SlotStats slot;
+    isr_profiler::get(i, &slot);
+    printf("  %-14s calls %10u  avg %7.1f cycles  max %7u cycles  CPU %5.2f%%\n",
+        reinterpret_cast<const char*>(isr_profiler::slotName(i)), slot.calls,
+        slot.calls ? 64.0 * slot.total_ticks / slot.calls : 0,
+        64 * slot.max_ticks, isr_profiler::cpuPercentX100(slot, sim_millis) / 100.0);
+  }
+#endif
+#if LIN_ISR_LATENCY
+  printf("Bit tick ISR entry latency (cycles, from the compare match):\n");
+  for (uint8_t i = 0; i < isr_latency::kNumSections; i++) {
+    uint32_t buckets[isr_latency::kNumBuckets];
+    uint8_t max_count;
+    isr_latency::get(i, buckets, &max_count);
+    printf("  %-14s", reinterpret_cast<const char*>(isr_latency::sectionName(i)));
+    for (uint8_t b = 0; b < isr_latency::kNumBuckets; b++) {
+      printf(" %7u", buckets[b]);
+    }
+    printf("  max %u\n", max_count * isr_latency::cyclesPerCount());
+  }
+#endif
+  printf("readNextFrame: %llu calls, host %.1f ns/call\n", (unsigned long long)read_calls,
+      read_calls ? (double)read_host_ns / read_calls : 0);
+  printf("Host: %.3f s, %.0f bits/s, %.0f frames/s (%.1fx real time)\n", host_seconds,
+      builder.bits() / host_seconds, options.frames / host_seconds, sim_seconds / host_seconds);
+  return 0;
+}
@@ -0,0 +1,238 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host benchmark of LinFrame validation. Compares validating a frame after
+// it was queued (parity bit computation and a checksum loop over the bytes,
+// the old LinFrame::isValid()) with the checksums accumulated by
+// append_byte() and stamped by lin_checksum::validate(). The latter moves
+// the work from main into the decoder ISR, both sides are reported.
+//
+// Usage: lin_frame_bench [--frames N] [--rounds N] [--corrupt PERCENT]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "custom_defs.h"
+#include "lin_checksum.h"
+#include "lin_frame.h"
+#include "lin_wave.h"
+
+namespace {
+  // Deterministic across platforms, unlike rand().
+  uint32_t random_state = 1;
+  uint32_t nextRandom(uint32_t range) {
+    random_state = random_state * 1103515245 + 12345;
+    return ((random_state >> 8) & 0xffffff) % range;
+  }
+
+  struct WireFrame {
+    uint8_t bytes[10];
+    uint8_t n;
+  };
+
+  // The validation done by the main code before this change.
+  bool legacyIsValid(const LinFrame& frame) {
+    const uint8 n = frame.num_bytes();
+    if (n != 1 && (n < 3 || n > 10)) {
+      return false;
+    }
+    const uint8 id_byte = frame.get_byte(0);
+    if (id_byte != LinFrame::setLinIdChecksumBits(id_byte)) {
+      return false;
+    }
+    if (n > 1 && frame.get_byte(n - 1) != frame.computeChecksum()) {
+      return false;
+    }
+    return true;
+  }
+
+  // The frame buffer of the decoder before the running sums.
+  struct PlainFrame {
+    uint8_t bytes[10];
+    uint8_t n;
+  };
+
+  // Each timing is the best of this many runs, the others are noise.
+  const int kRuns = 5;
+
+  // Keeps the optimizer from dropping the measured work.
+  volatile uint32_t sink;
+
+  double nsPerFrame(std::chrono::steady_clock::time_point start, uint64_t frames) {
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / frames;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t num_frames = 10000;
+  uint32_t rounds = 200;
+  uint32_t corrupt_percent = 10;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--frames")) {
+      num_frames = strtoul(argv[i + 1], NULL, 10);
+    } else if (!strcmp(argv[i], "--rounds")) {
+      rounds = strtoul(argv[i + 1], NULL, 10);
+    } else if (!strcmp(argv[i], "--corrupt")) {
+      corrupt_percent = strtoul(argv[i + 1], NULL, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--frames N] [--rounds N] [--corrupt PERCENT]\n", argv[0]);
+      return 2;
+    }
+  }
+  if ((argc % 2) != 1 || !num_frames || !rounds) {
+    fprintf(stderr, "Usage: %s [--frames N] [--rounds N] [--corrupt PERCENT]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<WireFrame> frames(num_frames);
+  for (uint32_t i = 0; i < num_frames; i++) {
+    LinFrameSpec spec;
+    spec.id = nextRandom(0x3c);
+    spec.num_data_bytes = 1 + nextRandom(8);
+    for (uint8_t j = 0; j < spec.num_data_bytes; j++) {
+      spec.data[j] = nextRandom(256);
+    }
+    spec.enhanced_checksum = custom_defs::kUseLinChecksumVersion2;
+    frames[i].n = lin_wire::expectedBytes(spec, frames[i].bytes);
+    if (nextRandom(100) < corrupt_percent) {
+      frames[i].bytes[nextRandom(frames[i].n)] ^= 1 << nextRandom(8);
+    }
+  }
+
+  // Both methods must agree on every frame.
+  uint32_t valid = 0;
+  for (uint32_t i = 0; i < num_frames; i++) {
+    LinFrame frame;
+    for (uint8_t j = 0; j < frames[i].n; j++) {
+      frame.append_byte(frames[i].bytes[j]);
+    }
+    lin_checksum::validate(&frame);
+    if (frame.isValid() != legacyIsValid(frame)) {
+      fprintf(stderr, "Mismatch on frame %u\n", i);
+      return 1;
+    }
+    valid += frame.isValid();
+  }
+
+  const uint64_t total = (uint64_t)num_frames * rounds;
+  LinFrame frame;
+  double ns;
+
+  // Decoder side, before: the bytes are only stored.
+  PlainFrame plain;
+  double plain_ns = 1e9;
+  for (int run = 0; run < kRuns; run++) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+      for (uint32_t i = 0; i < num_frames; i++) {
+        plain.n = 0;
+        for (uint8_t j = 0; j < frames[i].n; j++) {
+          plain.bytes[plain.n++] = frames[i].bytes[j];
+        }
+        sink = plain.n;
+      }
+    }
+    ns = nsPerFrame(start, total);
+    plain_ns = ns < plain_ns ? ns : plain_ns;
+  }
+
+  // Decoder side, after: the sums are accumulated as the bytes arrive and
+  // the flags stamped at the frame end.
+  double append_ns = 1e9;
+  for (int run = 0; run < kRuns; run++) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+      for (uint32_t i = 0; i < num_frames; i++) {
+        frame.reset();
+        for (uint8_t j = 0; j < frames[i].n; j++) {
+          frame.append_byte(frames[i].bytes[j]);
+        }
+        sink = frame.num_bytes();
+      }
+    }
+    ns = nsPerFrame(start, total);
+    append_ns = ns < append_ns ? ns : append_ns;
+  }
+
+  double stamp_ns = 1e9;
+  for (int run = 0; run < kRuns; run++) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+      for (uint32_t i = 0; i < num_frames; i++) {
+        frame.reset();
+        for (uint8_t j = 0; j < frames[i].n; j++) {
+          frame.append_byte(frames[i].bytes[j]);
+        }
+        lin_checksum::validate(&frame);
+        sink = frame.flags();
+      }
+    }
+    ns = nsPerFrame(start, total);
+    stamp_ns = ns < stamp_ns ? ns : stamp_ns;
+  }
+
+  // Main side, before: validate the queued frame.
+  std::vector<LinFrame> queued(num_frames);
+  for (uint32_t i = 0; i < num_frames; i++) {
+    for (uint8_t j = 0; j < frames[i].n; j++) {
+      queued[i].append_byte(frames[i].bytes[j]);
+    }
+    lin_checksum::validate(&queued[i]);
+  }
+  double legacy_ns = 1e9;
+  for (int run = 0; run < kRuns; run++) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+      for (uint32_t i = 0; i < num_frames; i++) {
+        count += legacyIsValid(queued[i]);
+      }
+    }
+    sink = count;
+    ns = nsPerFrame(start, total);
+    legacy_ns = ns < legacy_ns ? ns : legacy_ns;
+  }
+
+  // Main side, after: read the stamped flag.
+  double flag_ns = 1e9;
+  for (int run = 0; run < kRuns; run++) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+      for (uint32_t i = 0; i < num_frames; i++) {
+        count += queued[i].isValid();
+      }
+    }
+    sink = count;
+    ns = nsPerFrame(start, total);
+    flag_ns = ns < flag_ns ? ns : flag_ns;
+  }
+
+  printf("LinFrame validation bench: %u frames x %u rounds, %u%% corrupted, %u valid, "
+      "best of %d\n", num_frames, rounds, corrupt_percent, valid, kRuns);
+  printf("  decoder (ISR) side:\n");
+  printf("    before: store the bytes                   %7.2f ns/frame\n", plain_ns);
+  printf("    after:  append_byte() with running sums   %7.2f ns/frame (%+.2f)\n",
+      append_ns, append_ns - plain_ns);
+  printf("            and validate() at frame end       %7.2f ns/frame (%+.2f)\n",
+      stamp_ns, stamp_ns - plain_ns);
+  printf("  main side:\n");
+  printf("    before: validate the queued frame         %7.2f ns/frame\n", legacy_ns);
+  printf("    after:  read the isValid() flag           %7.2f ns/frame\n", flag_ns);
+  printf("  per frame, both sides: before %.2f, after %.2f ns\n", plain_ns + legacy_ns,
+      stamp_ns + flag_ns);
+  return 0;
+}
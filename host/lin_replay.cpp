@@ -0,0 +1,688 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Replays LIN traces (lin_trace_format.h blocks, e.g. dumped with
+// lin_trace_tool) through the firmware on the AVR simulator, as fast as the
+// host runs: the bus waveform of the recorded frames, the decoder ISRs,
+// lin_processor::dispatchFrames() and the position frame handling of
+// src/main.cpp into position_tracker and motion. Reports per trace the
+// frames per second, the decoded frames that do not match the recording
+// and the motor decisions, and checks them against a baseline.
+//
+// Usage: lin_replay [--trace FILE [--target N]]... [--poll-us N]
+//                   [--baseline FILE] [--write-baseline FILE]
+//                   [--throughput-tolerance PERCENT] [--save-builtin DIR]
+//                   [--verbose]
+//
+// Without --trace the built-in traces run: synthetic Bekant traffic of a
+// table moving up, moving down, at rest with noisy positions and moving
+// with corrupted position frames. --target is the target position of the
+// previous --trace, sent after its first position frame. The table in a
+// trace does not react to the decisions, so they are only compared against
+// the baseline. --save-builtin writes the built-in traces as trace files.
+//
+// With --baseline the run fails (exit 1) if a trace has more mismatches or
+// other decisions than in the baseline, or processes fewer frames per
+// second than the baseline minus the tolerance (50% by default, the
+// baseline depends on the host). Each trace runs in a child process, so it
+// starts from a reset firmware.
+
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "avr_sim.h"
+#include "coast_estimator.h"
+#include "custom_defs.h"
+#include "hardware_clock.h"
+#include "lin_processor.h"
+#include "lin_trace_file.h"
+#include "lin_wave.h"
+#include "motion.h"
+#include "position_tracker.h"
+#include "settings_store.h"
+#include "system_clock.h"
+
+namespace {
+  // As src/main.cpp.
+  const uint8_t kPositionFrameId = 0x12;
+  const uint8_t kThreshold = 120;
+  // Bus idle before the first frame and after the last one.
+  const uint32_t kLeadMillis = 50;
+  const uint32_t kTailMillis = 2000;
+  // The decoder ends a frame after a few bits of silence.
+  const double kMinIdleBits = 10;
+
+  struct TraceInput {
+    std::string name;
+    lin_trace_file::Trace trace;
+    // -1 for none.
+    int target;
+  };
+
+  struct Decision {
+    // Since the start of the replay.
+    uint32_t millis;
+    uint8_t direction;
+    uint16_t position;
+  };
+
+  struct Result {
+    Result() : expected(0), decoded(0), mismatches(0), fps(0), final_state(0) {}
+    std::string name;
+    uint32_t expected;
+    uint32_t decoded;
+    // Missing, corrupted or with another validity than recorded.
+    uint32_t mismatches;
+    double fps;
+    std::vector<Decision> decisions;
+    uint8_t final_state;
+  };
+
+  struct Options {
+    Options() : poll_us(1000), baseline(NULL), write_baseline(NULL), tolerance_percent(50),
+        save_builtin(NULL), verbose(false) {}
+    std::vector<TraceInput> traces;
+    uint32_t poll_us;
+    const char* baseline;
+    const char* write_baseline;
+    double tolerance_percent;
+    const char* save_builtin;
+    bool verbose;
+  };
+
+  Options options;
+
+  const char* directionName(uint8_t direction) {
+    switch (direction) {
+      case motion::kUp: return "UP";
+      case motion::kDown: return "DOWN";
+    }
+    return "STOP";
+  }
+
+  const char* stateName(uint8_t state) {
+    switch (state) {
+      case motion::states::IDLE: return "IDLE";
+      case motion::states::MOVING_UP: return "MOVING_UP";
+      case motion::states::MOVING_DOWN: return "MOVING_DOWN";
+      case motion::states::SETTLING: return "SETTLING";
+      case motion::states::FAULT: return "FAULT";
+    }
+    return "?";
+  }
+
+  // ----- Built-in traces -----
+
+  // Synthetic table, as host/motion_harness.cpp.
+  const double kUpSpeed = 350;
+  const double kDownSpeed = 420;
+  const double kAccel = 1500;
+  const double kBrakeUp = 1360;
+  const double kBrakeDown = 3530;
+  // Position frame period of the LIN schedule. The other frame, a stand-in
+  // for the rest of the schedule, is sent half a period later.
+  const uint32_t kFramePeriodMillis = 25;
+  const uint8_t kOtherFrameId = 0x08;
+
+  struct Scenario {
+    const char* name;
+    uint16_t from;
+    uint16_t to;
+    int target;
+    // Position noise amplitude.
+    double noise;
+    // Every nth position frame has a bad checksum, 0 for none.
+    uint32_t bad_every;
+  };
+
+  const Scenario kScenarios[] = {
+    { "move_up", 1000, 2500, 2500, 0, 0 },
+    { "move_down", 3000, 1200, 1200, 0, 0 },
+    { "rest_noise", 1500, 1500, -1, 6, 0 },
+    { "bad_checksums", 1000, 2500, 2500, 0, 4 },
+  };
+
+  void addFrame(lin_trace_file::Trace* trace, uint32_t ticks, uint8_t id, const uint8_t* data,
+      uint8_t n, bool bad_checksum) {
+    lin_trace_file::Record record;
+    record.kind = lin_trace_format::kinds::FRAME;
+    record.ticks = ticks;
+    record.count = n + 2;
+    record.bytes[0] = lin_wire::protectedId(id);
+    memcpy(record.bytes + 1, data, n);
+    record.bytes[n + 1] = lin_wire::checksum(record.bytes[0], data, n,
+        custom_defs::kUseLinChecksumVersion2);
+    if (bad_checksum) {
+      record.bytes[n + 1] ^= 0x5a;
+    }
+    // Only kValid is compared.
+    record.flags = bad_checksum ? 0 : 1;
+    trace->records.push_back(record);
+  }
+
+  // The table rests for a second, moves to the target with the motor cut
+  // where it coasts to it and rests again.
+  TraceInput synthesize(const Scenario& scenario) {
+    TraceInput input;
+    input.name = std::string("builtin:") + scenario.name;
+    input.target = scenario.target;
+    lin_trace_file::Trace& trace = input.trace;
+    trace.cause = 0;
+    trace.ticks_per_milli = hardware_clock::kTicksPerMilli;
+    trace.baud = custom_defs::kLinSpeed;
+    trace.lost_records = 0;
+
+    const double dt = 0.001;
+    const int sign = scenario.to > scenario.from ? 1 : -1;
+    double position = scenario.from;
+    double speed = 0;
+    bool motor = false;
+    bool moved = false;
+    uint32_t stopped_millis = 0;
+    uint32_t position_frames = 0;
+    uint32_t random_state = 1;
+    uint8_t counter = 0;
+    // The firmware has run for a while when the recording starts.
+    const uint32_t start_millis = 100;
+    for (uint32_t millis = 0; !stopped_millis || millis < stopped_millis + 1500; millis++) {
+      if (millis == 1000 && scenario.to != scenario.from) {
+        motor = true;
+        moved = true;
+      }
+      if (motor) {
+        speed = sign > 0 ? fmin(kUpSpeed, speed + kAccel * dt)
+            : fmax(-kDownSpeed, speed - kAccel * dt);
+        const double coast = speed * speed / (2 * (sign > 0 ? kBrakeUp : kBrakeDown));
+        if (sign * (scenario.to - position) <= coast) {
+          motor = false;
+        }
+      } else if (speed > 0) {
+        speed = fmax(0, speed - kBrakeUp * dt);
+      } else {
+        speed = fmin(0, speed + kBrakeDown * dt);
+      }
+      position += speed * dt;
+      if (!stopped_millis && millis >= 1000 && !motor && speed == 0 &&
+          (moved || scenario.to == scenario.from)) {
+        stopped_millis = millis;
+      }
+
+      const uint32_t ticks = (start_millis + millis) * hardware_clock::kTicksPerMilli;
+      if (millis % kFramePeriodMillis == 0) {
+        random_state = random_state * 1103515245 + 12345;
+        const double noise = scenario.noise * (((random_state >> 8) & 0xffff) / 32767.5 - 1);
+        const uint16_t measured = (uint16_t)lround(position + noise);
+        const uint8_t data[2] = { (uint8_t)measured, (uint8_t)(measured >> 8) };
+        position_frames++;
+        addFrame(&trace, ticks, kPositionFrameId, data, sizeof(data),
+            scenario.bad_every && position_frames % scenario.bad_every == 0);
+      } else if (millis % kFramePeriodMillis == kFramePeriodMillis / 2) {
+        uint8_t data[8];
+        for (uint8_t i = 0; i < sizeof(data); i++) {
+          data[i] = counter + i;
+        }
+        counter++;
+        addFrame(&trace, ticks, kOtherFrameId, data, sizeof(data), false);
+      }
+    }
+    return input;
+  }
+
+  // ----- Replay, in the child process -----
+
+  struct Expected {
+    const lin_trace_file::Record* record;
+    uint64_t end_cycle;
+  };
+
+  std::vector<Expected> expected;
+  uint32_t next_expected;
+  Result result;
+  int target = -1;
+  bool target_sent = false;
+  uint32_t start_millis;
+  uint16_t last_position;
+
+  uint32_t replayMillis() {
+    return system_clock::timeMillis() - start_millis;
+  }
+
+  void onMotor(uint8_t direction) {
+    Decision decision = { replayMillis(), direction, last_position };
+    result.decisions.push_back(decision);
+  }
+
+  bool sameBytes(const LinFrame& frame, const lin_trace_file::Record& record) {
+    if (frame.num_bytes() != record.count) {
+      return false;
+    }
+    for (uint8_t i = 0; i < record.count; i++) {
+      if (frame.get_byte(i) != record.bytes[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Matches a decoded frame against the next few recorded ones. Skipped
+  // ones were not decoded.
+  void checkFrame(const LinFrame& frame) {
+    result.decoded++;
+    const uint32_t kLookahead = 32;
+    for (uint32_t i = next_expected; i < expected.size() && i < next_expected + kLookahead;
+        i++) {
+      const lin_trace_file::Record& record = *expected[i].record;
+      if (sameBytes(frame, record)) {
+        result.mismatches += i - next_expected;
+        if (frame.isValid() != ((record.flags & LinFrame::kValid) != 0)) {
+          result.mismatches++;
+        }
+        next_expected = i + 1;
+        return;
+      }
+    }
+    result.mismatches++;
+  }
+
+  // As processPositionFrame() of src/main.cpp.
+  void onFrame(const LinFrame& frame) {
+    checkFrame(frame);
+    if ((frame.get_byte(0) & 0x3f) != kPositionFrameId || !frame.isValid()) {
+      return;
+    }
+    const uint16_t position = frame.get_byte(1) | (frame.get_byte(2) << 8);
+    position_tracker::addSample(position, frame.timestamp());
+    last_position = position;
+    motion::onPosition(position, position_tracker::velocity(),
+        system_clock::extendMillis(frame.timestamp()), system_clock::timeMillis());
+    if (target >= 0 && !target_sent) {
+      target_sent = true;
+      motion::onTarget(target, system_clock::timeMillis());
+    }
+  }
+
+  Result replay(const TraceInput& input) {
+    result = Result();
+    result.name = input.name;
+    target = input.target;
+
+    // The recorded frames at their recorded times, as far as the minimum
+    // idle between frames allows.
+    avr_sim::Waveform wave;
+    LinWaveBuilder builder(&wave, input.trace.baud, 0);
+    const std::vector<lin_trace_file::Record>& records = input.trace.records;
+    const double cycles_per_tick = F_CPU / 1000.0 / input.trace.ticks_per_milli;
+    double first_ticks = -1;
+    for (size_t i = 0; i < records.size(); i++) {
+      if (records[i].kind != lin_trace_format::kinds::FRAME || !records[i].count) {
+        continue;
+      }
+      if (first_ticks < 0) {
+        first_ticks = records[i].ticks - kLeadMillis * input.trace.ticks_per_milli;
+      }
+      const double end = (records[i].ticks - first_ticks) * cycles_per_tick;
+      const double frame_bits = LinWaveBuilder::rawFrameBits(records[i].count);
+      const double idle_bits = (end - builder.endCycle()) / builder.cyclesPerBit() - frame_bits;
+      builder.idle(idle_bits > kMinIdleBits ? idle_bits : kMinIdleBits);
+      builder.rawFrame(records[i].bytes, records[i].count);
+      Expected e = { &records[i], builder.endCycle() };
+      expected.push_back(e);
+    }
+    result.expected = expected.size();
+    builder.idle(kTailMillis * input.trace.baud / 1000.0);
+
+    avr_sim::reset();
+    avr_sim::eepromErase();
+    avr_sim::setRxWaveform(&wave);
+    hardware_clock::setup();
+    lin_processor::setup();
+    for (uint8_t id = 0; id < 64; id++) {
+      lin_processor::subscribe(id, onFrame);
+    }
+    sei();
+    settings_store::setup();
+    coast_estimator::setup(kThreshold);
+    motion::setup(onMotor, kThreshold);
+    system_clock::loop();
+    start_millis = system_clock::timeMillis();
+
+    const uint64_t poll_cycles = (uint64_t)options.poll_us * (F_CPU / 1000000);
+    const uint64_t end_cycle = builder.endCycle();
+    const std::chrono::steady_clock::time_point host_start = std::chrono::steady_clock::now();
+    for (uint64_t t = 0; t < end_cycle;) {
+      t += poll_cycles;
+      avr_sim::runUntil(t);
+      system_clock::loop();
+      lin_processor::dispatchFrames();
+      const uint32_t now = system_clock::timeMillis();
+      if (motion::hasDeadline() && (int32_t)(now - motion::deadline()) >= 0) {
+        motion::onTimeout(now);
+      }
+    }
+    const double host_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - host_start).count();
+    result.mismatches += expected.size() - next_expected;
+    result.fps = host_seconds > 0 ? result.decoded / host_seconds : 0;
+    result.final_state = motion::state();
+    return result;
+  }
+
+  // ----- Results as text, for the pipe and the baseline -----
+
+  void writeResult(const Result& r, FILE* out) {
+    fprintf(out, "trace %s\n", r.name.c_str());
+    fprintf(out, "frames %u decoded %u mismatches %u\n", r.expected, r.decoded, r.mismatches);
+    fprintf(out, "fps %.0f\n", r.fps);
+    for (size_t i = 0; i < r.decisions.size(); i++) {
+      fprintf(out, "decision %u %s %u\n", r.decisions[i].millis,
+          directionName(r.decisions[i].direction), r.decisions[i].position);
+    }
+    fprintf(out, "state %s\n", stateName(r.final_state));
+    fprintf(out, "end\n");
+  }
+
+  // Reads the results from text written by writeResult(). Lines starting
+  // with # are comments.
+  bool parseResults(const std::string& text, std::vector<Result>* results) {
+    Result r;
+    bool in_trace = false;
+    size_t start = 0;
+    while (start < text.size()) {
+      size_t end = text.find('\n', start);
+      if (end == std::string::npos) {
+        end = text.size();
+      }
+      const std::string line = text.substr(start, end - start);
+      start = end + 1;
+      char word[256];
+      unsigned a, b, c;
+      if (line.empty() || line[0] == '#') {
+        continue;
+      } else if (!in_trace && line.compare(0, 6, "trace ") == 0) {
+        r = Result();
+        r.name = line.substr(6);
+        in_trace = true;
+      } else if (in_trace && sscanf(line.c_str(), "frames %u decoded %u mismatches %u", &a, &b,
+          &c) == 3) {
+        r.expected = a;
+        r.decoded = b;
+        r.mismatches = c;
+      } else if (in_trace && sscanf(line.c_str(), "fps %lf", &r.fps) == 1) {
+      } else if (in_trace && sscanf(line.c_str(), "decision %u %255s %u", &a, word, &b) == 3) {
+        Decision d = { a, motion::kStop, (uint16_t)b };
+        if (!strcmp(word, "UP")) {
+          d.direction = motion::kUp;
+        } else if (!strcmp(word, "DOWN")) {
+          d.direction = motion::kDown;
+        }
+        r.decisions.push_back(d);
+      } else if (in_trace && sscanf(line.c_str(), "state %255s", word) == 1) {
+        for (uint8_t s = motion::states::IDLE; s <= motion::states::FAULT; s++) {
+          if (!strcmp(word, stateName(s))) {
+            r.final_state = s;
+          }
+        }
+      } else if (in_trace && line == "end") {
+        results->push_back(r);
+        in_trace = false;
+      } else {
+        return false;
+      }
+    }
+    return !in_trace;
+  }
+
+  // Runs replay() in a child process. False if the child failed.
+  bool runChild(const TraceInput& input, Result* r) {
+    int fds[2];
+    if (pipe(fds)) {
+      perror("pipe");
+      return false;
+    }
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return false;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      FILE* out = fdopen(fds[1], "w");
+      writeResult(replay(input), out);
+      fclose(out);
+      _exit(0);
+    }
+    close(fds[1]);
+    std::string text;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+      text.append(buffer, n);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::vector<Result> results;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) || !parseResults(text, &results) ||
+        results.size() != 1) {
+      fprintf(stderr, "%s: replay failed\n", input.name.c_str());
+      return false;
+    }
+    *r = results[0];
+    return true;
+  }
+
+  bool readFile(const char* path, std::string* text) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+      perror(path);
+      return false;
+    }
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+      text->append(buffer, n);
+    }
+    fclose(f);
+    return true;
+  }
+
+  bool loadTrace(const char* path, TraceInput* input) {
+    std::string data;
+    std::string error;
+    if (!readFile(path, &data)) {
+      return false;
+    }
+    input->name = path;
+    input->target = -1;
+    if (!lin_trace_file::parse(reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+        &input->trace, &error)) {
+      fprintf(stderr, "%s: %s\n", path, error.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  bool parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+      const char* arg = argv[i];
+      if (!strcmp(arg, "--verbose")) {
+        options.verbose = true;
+        continue;
+      }
+      const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+      if (!value) {
+        return false;
+      }
+      if (!strcmp(arg, "--trace")) {
+        TraceInput input;
+        if (!loadTrace(value, &input)) {
+          return false;
+        }
+        options.traces.push_back(input);
+      } else if (!strcmp(arg, "--target")) {
+        if (options.traces.empty()) {
+          return false;
+        }
+        options.traces.back().target = strtol(value, NULL, 10);
+      } else if (!strcmp(arg, "--poll-us")) {
+        options.poll_us = strtoul(value, NULL, 10);
+      } else if (!strcmp(arg, "--baseline")) {
+        options.baseline = value;
+      } else if (!strcmp(arg, "--write-baseline")) {
+        options.write_baseline = value;
+      } else if (!strcmp(arg, "--throughput-tolerance")) {
+        options.tolerance_percent = strtod(value, NULL);
+      } else if (!strcmp(arg, "--save-builtin")) {
+        options.save_builtin = value;
+      } else {
+        return false;
+      }
+      i++;
+    }
+    return options.poll_us > 0;
+  }
+
+  bool sameDecisions(const Result& a, const Result& b) {
+    if (a.decisions.size() != b.decisions.size() || a.final_state != b.final_state) {
+      return false;
+    }
+    for (size_t i = 0; i < a.decisions.size(); i++) {
+      if (a.decisions[i].millis != b.decisions[i].millis ||
+          a.decisions[i].direction != b.decisions[i].direction ||
+          a.decisions[i].position != b.decisions[i].position) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns the number of regressions of r against the baseline.
+  int compare(const Result& r, const std::vector<Result>& baseline) {
+    for (size_t i = 0; i < baseline.size(); i++) {
+      const Result& b = baseline[i];
+      if (b.name != r.name) {
+        continue;
+      }
+      int regressions = 0;
+      if (r.mismatches > b.mismatches) {
+        fprintf(stderr, "FAIL %s: %u mismatches, baseline %u\n", r.name.c_str(), r.mismatches,
+            b.mismatches);
+        regressions++;
+      }
+      if (!sameDecisions(r, b)) {
+        fprintf(stderr, "FAIL %s: decisions differ from the baseline\n", r.name.c_str());
+        regressions++;
+      }
+      const double min_fps = b.fps * (1 - options.tolerance_percent / 100);
+      if (r.fps < min_fps) {
+        fprintf(stderr, "FAIL %s: %.0f frames/s, baseline %.0f (min %.0f)\n", r.name.c_str(),
+            r.fps, b.fps, min_fps);
+        regressions++;
+      }
+      return regressions;
+    }
+    fprintf(stderr, "FAIL %s: not in the baseline\n", r.name.c_str());
+    return 1;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!parseArgs(argc, argv)) {
+    fprintf(stderr, "Usage: %s [--trace FILE [--target N]]... [--poll-us N]"
+        " [--baseline FILE] [--write-baseline FILE] [--throughput-tolerance PERCENT]"
+        " [--save-builtin DIR] [--verbose]\n", argv[0]);
+    return 2;
+  }
+  if (options.traces.empty()) {
+    for (size_t i = 0; i < sizeof(kScenarios) / sizeof(kScenarios[0]); i++) {
+      options.traces.push_back(synthesize(kScenarios[i]));
+    }
+  }
+  if (options.save_builtin) {
+    for (size_t i = 0; i < sizeof(kScenarios) / sizeof(kScenarios[0]); i++) {
+      const TraceInput input = synthesize(kScenarios[i]);
+      const std::string path = std::string(options.save_builtin) + "/" + kScenarios[i].name +
+          ".bin";
+      std::vector<uint8_t> block;
+      lin_trace_file::serialize(input.trace, &block);
+      FILE* f = fopen(path.c_str(), "wb");
+      if (!f) {
+        perror(path.c_str());
+        return 1;
+      }
+      fwrite(block.data(), 1, block.size(), f);
+      fclose(f);
+    }
+  }
+
+  std::vector<Result> baseline;
+  if (options.baseline) {
+    std::string text;
+    if (!readFile(options.baseline, &text) || !parseResults(text, &baseline)) {
+      fprintf(stderr, "%s: bad baseline\n", options.baseline);
+      return 2;
+    }
+  }
+
+  std::vector<Result> results;
+  int regressions = 0;
+  for (size_t i = 0; i < options.traces.size(); i++) {
+    Result r;
+    if (!runChild(options.traces[i], &r)) {
+      return 1;
+    }
+    printf("%-24s frames %6u  decoded %6u  mismatches %4u  %8.0f frames/s  decisions %2u"
+        "  %s\n", r.name.c_str(), r.expected, r.decoded, r.mismatches, r.fps,
+        (unsigned)r.decisions.size(), stateName(r.final_state));
+    if (options.verbose) {
+      for (size_t j = 0; j < r.decisions.size(); j++) {
+        printf("  %6u ms  %-4s at %u\n", r.decisions[j].millis,
+            directionName(r.decisions[j].direction), r.decisions[j].position);
+      }
+    }
+    if (options.baseline) {
+      regressions += compare(r, baseline);
+    }
+    results.push_back(r);
+  }
+
+  if (options.write_baseline) {
+    FILE* f = fopen(options.write_baseline, "w");
+    if (!f) {
+      perror(options.write_baseline);
+      return 1;
+    }
+    fprintf(f, "# lin_replay baseline, poll %u us. Frames per second depend on the host.\n",
+        options.poll_us);
+    for (size_t i = 0; i < results.size(); i++) {
+      writeResult(results[i], f);
+    }
+    fclose(f);
+  }
+  if (regressions) {
+    fprintf(stderr, "%d regression(s)\n", regressions);
+    return 1;
+  }
+  if (options.baseline) {
+    printf("lin_replay: no regressions\n");
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lin_trace_file.h"
+
+namespace lin_trace_file {
+  namespace {
+    // As lin_processor::errors and LinFrame flags.
+    const char* const kErrorNames[] = { "SHRT", "LONG", "STRT", "STOP", "SYNC", "OVRN", "OTHR" };
+    const char* const kTriggerNames[] = { "ERROR", "ID", "POSITION_JUMP", "MANUAL" };
+    const uint8_t kValid = 1 << 0;
+    const uint8_t kClassicChecksumOk = 1 << 2;
+    const uint8_t kEnhancedChecksumOk = 1 << 3;
+
+    uint16_t getU16(const uint8_t* p) {
+      return p[0] | ((uint16_t)p[1] << 8);
+    }
+
+    void putU16(uint8_t* p, uint16_t value) {
+      p[0] = (uint8_t)value;
+      p[1] = (uint8_t)(value >> 8);
+    }
+
+    uint32_t getU32(const uint8_t* p) {
+      return getU16(p) | ((uint32_t)getU16(p + 2) << 16);
+    }
+
+    void writeNames(FILE* out, uint8_t bits, const char* const* names, int n) {
+      bool first = true;
+      for (int i = 0; i < n; i++) {
+        if (bits & (1 << i)) {
+          fprintf(out, "%s%s", first ? "" : "|", names[i]);
+          first = false;
+        }
+      }
+    }
+
+    void writeHex(FILE* out, const uint8_t* bytes, int n) {
+      for (int i = 0; i < n; i++) {
+        fprintf(out, "%02X", bytes[i]);
+      }
+    }
+  }  // namespace
+
+  bool parse(const uint8_t* block, size_t n, Trace* trace, std::string* error) {
+    using namespace lin_trace_format;
+    if (n < kHeaderBytes || block[0] != kMagic0 || block[1] != kMagic1) {
+      *error = "not a LIN trace block";
+      return false;
+    }
+    if (block[2] != kVersion) {
+      *error = "unknown LIN trace version";
+      return false;
+    }
+    trace->cause = block[kCauseOffset];
+    trace->ticks_per_milli = getU16(block + kTicksPerMilliOffset);
+    trace->baud = getU16(block + kBaudOffset);
+    trace->lost_records = getU16(block + kLostRecordsOffset);
+    trace->records.clear();
+    const size_t end = kHeaderBytes + getU16(block + kRecordBytesOffset);
+    if (end != n || !trace->ticks_per_milli) {
+      *error = "bad LIN trace header";
+      return false;
+    }
+    for (size_t i = kHeaderBytes; i < end;) {
+      Record record;
+      record.kind = recordKind(block[i]);
+      record.count = recordCount(block[i]);
+      if (record.count > kMaxRecordBytes || i + kRecordHeaderBytes + record.count > end) {
+        *error = "truncated LIN trace record";
+        return false;
+      }
+      record.ticks = getU32(block + i + 1);
+      record.flags = block[i + 5];
+      for (uint8_t j = 0; j < record.count; j++) {
+        record.bytes[j] = block[i + kRecordHeaderBytes + j];
+      }
+      trace->records.push_back(record);
+      i += kRecordHeaderBytes + record.count;
+    }
+    return true;
+  }
+
+  void serialize(const Trace& trace, std::vector<uint8_t>* block) {
+    using namespace lin_trace_format;
+    block->assign(kHeaderBytes, 0);
+    (*block)[0] = kMagic0;
+    (*block)[1] = kMagic1;
+    (*block)[2] = kVersion;
+    (*block)[kCauseOffset] = trace.cause;
+    putU16(&(*block)[kTicksPerMilliOffset], trace.ticks_per_milli);
+    putU16(&(*block)[kBaudOffset], trace.baud);
+    putU16(&(*block)[kLostRecordsOffset], trace.lost_records);
+    for (size_t i = 0; i < trace.records.size(); i++) {
+      const Record& r = trace.records[i];
+      block->push_back(kindAndCount(r.kind, r.count));
+      for (int shift = 0; shift < 32; shift += 8) {
+        block->push_back((uint8_t)(r.ticks >> shift));
+      }
+      block->push_back(r.flags);
+      block->insert(block->end(), r.bytes, r.bytes + r.count);
+    }
+    putU16(&(*block)[kRecordBytesOffset], block->size() - kHeaderBytes);
+  }
+
+  double seconds(const Trace& trace, uint32_t ticks) {
+    return ticks / (1000.0 * trace.ticks_per_milli);
+  }
+
+  void writeCsv(const Trace& trace, FILE* out) {
+    fprintf(out, "time_s,ticks,kind,id,data,checksum,flags,valid,notes\n");
+    for (size_t i = 0; i < trace.records.size(); i++) {
+      const Record& r = trace.records[i];
+      fprintf(out, "%.6f,%u,", seconds(trace, r.ticks), r.ticks);
+      switch (r.kind) {
+        case lin_trace_format::kinds::FRAME: {
+          const int data_bytes = r.count > 1 ? r.count - 2 : 0;
+          fprintf(out, "frame,%02X,", r.bytes[0] & 0x3f);
+          writeHex(out, r.bytes + 1, data_bytes);
+          fprintf(out, ",");
+          if (r.count > 1) {
+            fprintf(out, "%02X", r.bytes[r.count - 1]);
+          }
+          fprintf(out, ",%02X,%d,", r.flags, (r.flags & kValid) ? 1 : 0);
+          if (r.flags & kEnhancedChecksumOk) {
+            fprintf(out, "enhanced");
+          } else if (r.flags & kClassicChecksumOk) {
+            fprintf(out, "classic");
+          } else if (r.count > 1) {
+            fprintf(out, "bad checksum");
+          }
+          break;
+        }
+        case lin_trace_format::kinds::ERROR:
+          fprintf(out, "error,");
+          if (r.count) {
+            fprintf(out, "%02X", r.bytes[0]);
+          }
+          fprintf(out, ",,,%02X,0,", r.flags);
+          writeNames(out, r.flags, kErrorNames, 7);
+          break;
+        default:
+          fprintf(out, "trigger,,,,%02X,,", r.flags);
+          writeNames(out, r.flags, kTriggerNames, 4);
+          break;
+      }
+      fprintf(out, "\n");
+    }
+  }
+
+  void writeCandump(const Trace& trace, FILE* out, const char* interface) {
+    for (size_t i = 0; i < trace.records.size(); i++) {
+      const Record& r = trace.records[i];
+      if (r.kind == lin_trace_format::kinds::FRAME) {
+        fprintf(out, "(%.6f) %s %03X#", seconds(trace, r.ticks), interface, r.bytes[0] & 0x3f);
+        writeHex(out, r.bytes + 1, r.count > 1 ? r.count - 2 : 0);
+        fprintf(out, "\n");
+      } else if (r.kind == lin_trace_format::kinds::ERROR) {
+        fprintf(out, "(%.6f) %s 20000008#%02X%02X\n", seconds(trace, r.ticks), interface,
+            r.flags, r.count ? r.bytes[0] : 0xff);
+      }
+    }
+  }
+}  // namespace lin_trace_file
@@ -0,0 +1,66 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIN_TRACE_FILE_H
+#define LIN_TRACE_FILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "lin_trace_format.h"
+
+// Host side reader of the LIN trace blocks of lib/lin_processor/lin_trace.h
+// and writers of the usual trace formats.
+namespace lin_trace_file {
+  struct Record {
+    // lin_trace_format::kinds.
+    uint8_t kind;
+    // Hardware clock ticks.
+    uint32_t ticks;
+    uint8_t flags;
+    uint8_t count;
+    uint8_t bytes[lin_trace_format::kMaxRecordBytes];
+  };
+
+  struct Trace {
+    // lin_trace_format::triggers bit, 0 if not triggered.
+    uint8_t cause;
+    uint16_t ticks_per_milli;
+    uint16_t baud;
+    uint16_t lost_records;
+    std::vector<Record> records;
+  };
+
+  // Parses a whole block. Returns false, with the reason in error, if it is
+  // truncated or malformed.
+  bool parse(const uint8_t* block, size_t n, Trace* trace, std::string* error);
+
+  // The block of a trace, e.g. of a synthesized one.
+  void serialize(const Trace& trace, std::vector<uint8_t>* block);
+
+  // Seconds since the start of the firmware.
+  double seconds(const Trace& trace, uint32_t ticks);
+
+  // One line per record: time_s, ticks, kind, id, data, checksum, flags,
+  // valid and notes (checksum version, error or trigger names).
+  void writeCsv(const Trace& trace, FILE* out);
+
+  // candump -L style lines, "(seconds) lin0 012#A1B2". The id is the 6 bit
+  // frame id, the data excludes the checksum. Decoder errors are written as
+  // CAN error frames (id 20000008, protocol violation) with the error flags
+  // and the frame id, or ff, as data. Trigger records are left out.
+  void writeCandump(const Trace& trace, FILE* out, const char* interface);
+}  // namespace lin_trace_file
+
+#endif
@@ -0,0 +1,230 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Arms and dumps the LIN trace recorder of the controller (built with
+// LIN_TRACE=1) and converts the dumped blocks to CSV and candump logs.
+//
+// Usage: lin_trace_tool --device PATH --arm TRIGGERS [--id N] [--jump N]
+//                       [--post PERCENT]
+//        lin_trace_tool --device PATH --dump FILE
+//        lin_trace_tool --in FILE [--csv FILE] [--candump FILE]
+//
+// TRIGGERS is a comma separated list of error, id and jump. --id is the 6
+// bit frame id of the id trigger, --jump the position change of the jump
+// trigger, --post the share of the ring recorded after the trigger (50 by
+// default). --dump stops the recorder and writes its block to FILE. "-"
+// writes the CSV or the candump log to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "desk_client.h"
+#include "lin_trace_file.h"
+
+namespace {
+  struct Options {
+    Options() : device(NULL), triggers(-1), id(0), jump(100), post(50), dump(NULL), in(NULL),
+        csv(NULL), candump(NULL) {}
+    const char* device;
+    // -1 if not arming.
+    int triggers;
+    int id;
+    int jump;
+    int post;
+    const char* dump;
+    const char* in;
+    const char* csv;
+    const char* candump;
+  };
+
+  bool parseTriggers(const char* s, int* triggers) {
+    *triggers = 0;
+    std::string list(s);
+    size_t start = 0;
+    while (start <= list.size()) {
+      size_t end = list.find(',', start);
+      if (end == std::string::npos) {
+        end = list.size();
+      }
+      const std::string name = list.substr(start, end - start);
+      if (name == "error") {
+        *triggers |= lin_trace_format::triggers::ERROR;
+      } else if (name == "id") {
+        *triggers |= lin_trace_format::triggers::ID;
+      } else if (name == "jump") {
+        *triggers |= lin_trace_format::triggers::POSITION_JUMP;
+      } else {
+        return false;
+      }
+      start = end + 1;
+    }
+    return true;
+  }
+
+  bool parseArgs(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+      const char* arg = argv[i];
+      const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+      if (!value) {
+        return false;
+      }
+      if (!strcmp(arg, "--device")) {
+        options->device = value;
+      } else if (!strcmp(arg, "--arm")) {
+        if (!parseTriggers(value, &options->triggers)) {
+          return false;
+        }
+      } else if (!strcmp(arg, "--id")) {
+        options->id = strtol(value, NULL, 0) & 0x3f;
+      } else if (!strcmp(arg, "--jump")) {
+        options->jump = strtol(value, NULL, 0);
+      } else if (!strcmp(arg, "--post")) {
+        options->post = strtol(value, NULL, 0);
+      } else if (!strcmp(arg, "--dump")) {
+        options->dump = value;
+      } else if (!strcmp(arg, "--in")) {
+        options->in = value;
+      } else if (!strcmp(arg, "--csv")) {
+        options->csv = value;
+      } else if (!strcmp(arg, "--candump")) {
+        options->candump = value;
+      } else {
+        return false;
+      }
+      i++;
+    }
+    if (options->post < 0 || options->post > 100 || options->jump < 0 ||
+        options->jump > 0xffff) {
+      return false;
+    }
+    if (options->device) {
+      return (options->triggers >= 0) != (options->dump != NULL) && !options->in;
+    }
+    return options->in && (options->csv || options->candump);
+  }
+
+  bool readFile(const char* path, std::vector<uint8_t>* data) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+      perror(path);
+      return false;
+    }
+    uint8_t buffer[1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+      data->insert(data->end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+  }
+
+  FILE* openOutput(const char* path, const char* mode) {
+    if (!strcmp(path, "-")) {
+      return stdout;
+    }
+    FILE* f = fopen(path, mode);
+    if (!f) {
+      perror(path);
+    }
+    return f;
+  }
+
+  void closeOutput(FILE* f) {
+    if (f != stdout) {
+      fclose(f);
+    }
+  }
+
+  int runDevice(const Options& options) {
+    const int fd = DeskClient::openSerial(options.device);
+    if (fd < 0) {
+      perror(options.device);
+      return 1;
+    }
+    DeskClient client(fd);
+    int status = 0;
+    if (options.triggers >= 0) {
+      const int result = client.armTrace(options.triggers, options.id, options.jump,
+          options.post);
+      if (result != desk_protocol::results::OK) {
+        fprintf(stderr, "TRACE_ARM failed: %d\n", result);
+        status = 1;
+      }
+    } else {
+      std::vector<uint8_t> block;
+      FILE* f = NULL;
+      if (!client.dumpTrace(&block)) {
+        fprintf(stderr, "TRACE_DUMP failed after %u bytes. Is LIN_TRACE built in?\n",
+            (unsigned)block.size());
+        status = 1;
+      } else if ((f = openOutput(options.dump, "wb")) == NULL) {
+        status = 1;
+      } else {
+        fwrite(block.data(), 1, block.size(), f);
+        closeOutput(f);
+        fprintf(stderr, "%u bytes written to %s\n", (unsigned)block.size(), options.dump);
+      }
+    }
+    // Back to text commands for a terminal.
+    client.textMode();
+    close(fd);
+    return status;
+  }
+
+  int runConvert(const Options& options) {
+    std::vector<uint8_t> block;
+    if (!readFile(options.in, &block)) {
+      return 1;
+    }
+    lin_trace_file::Trace trace;
+    std::string error;
+    if (!lin_trace_file::parse(block.data(), block.size(), &trace, &error)) {
+      fprintf(stderr, "%s: %s\n", options.in, error.c_str());
+      return 1;
+    }
+    if (options.csv) {
+      FILE* f = openOutput(options.csv, "w");
+      if (!f) {
+        return 1;
+      }
+      lin_trace_file::writeCsv(trace, f);
+      closeOutput(f);
+    }
+    if (options.candump) {
+      FILE* f = openOutput(options.candump, "w");
+      if (!f) {
+        return 1;
+      }
+      lin_trace_file::writeCandump(trace, f, "lin0");
+      closeOutput(f);
+    }
+    fprintf(stderr, "%u records, %u lost to overwrites, trigger 0x%02x\n",
+        (unsigned)trace.records.size(), trace.lost_records, trace.cause);
+    return 0;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseArgs(argc, argv, &options)) {
+    fprintf(stderr, "Usage: %s --device PATH --arm error,id,jump [--id N] [--jump N]"
+        " [--post PERCENT]\n"
+        "       %s --device PATH --dump FILE\n"
+        "       %s --in FILE [--csv FILE] [--candump FILE]\n", argv[0], argv[0], argv[0]);
+    return 2;
+  }
+  return options.device ? runDevice(options) : runConvert(options);
+}
@@ -0,0 +1,133 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lin_wave.h"
+
+#include <math.h>
+
+namespace lin_wire {
+  static uint8_t bit(uint8_t value, uint8_t index) {
+    return (value >> index) & 1;
+  }
+
+  uint8_t protectedId(uint8_t id) {
+    id &= 0x3f;
+    const uint8_t p0 = bit(id, 0) ^ bit(id, 1) ^ bit(id, 2) ^ bit(id, 4);
+    const uint8_t p1 = !(bit(id, 1) ^ bit(id, 3) ^ bit(id, 4) ^ bit(id, 5));
+    return (p1 << 7) | (p0 << 6) | id;
+  }
+
+  uint8_t checksum(uint8_t pid, const uint8_t* data, uint8_t n, bool enhanced) {
+    unsigned sum = enhanced ? pid : 0;
+    for (uint8_t i = 0; i < n; i++) {
+      sum += data[i];
+      if (sum > 0xff) {
+        sum -= 0xff;
+      }
+    }
+    return (uint8_t)~sum;
+  }
+
+  uint8_t expectedBytes(const LinFrameSpec& spec, uint8_t* out) {
+    const uint8_t pid = protectedId(spec.id);
+    out[0] = pid;
+    for (uint8_t i = 0; i < spec.num_data_bytes; i++) {
+      out[1 + i] = spec.data[i];
+    }
+    out[1 + spec.num_data_bytes] = checksum(pid, spec.data, spec.num_data_bytes,
+        spec.enhanced_checksum);
+    return spec.num_data_bytes + 2;
+  }
+}  // namespace lin_wire
+
+LinWaveBuilder::LinWaveBuilder(avr_sim::Waveform* wave, uint32_t baud,
+    double baud_error_percent)
+  : wave_(wave),
+    cycles_per_bit_(F_CPU / (baud * (1.0 + baud_error_percent / 100.0))),
+    time_(0),
+    level_(true),
+    bits_(0),
+    jitter_cycles_(0),
+    jitter_random_(0),
+    last_edge_(0) {
+}
+
+void LinWaveBuilder::setEdgeJitter(double max_bits, uint32_t seed) {
+  jitter_cycles_ = max_bits * cycles_per_bit_;
+  jitter_random_ = seed;
+}
+
+void LinWaveBuilder::level(bool high, double bits) {
+  if (high != level_) {
+    double edge = time_;
+    if (jitter_cycles_ > 0) {
+      jitter_random_ = jitter_random_ * 1103515245 + 12345;
+      const double r = ((jitter_random_ >> 8) & 0xffffff) / (double)0x1000000;
+      edge += (2 * r - 1) * jitter_cycles_;
+    }
+    // Edges must stay in order.
+    uint64_t cycle = (uint64_t)llround(edge < 1 ? 1 : edge);
+    if (cycle <= last_edge_) {
+      cycle = last_edge_ + 1;
+    }
+    wave_->addEdge(cycle, high);
+    last_edge_ = cycle;
+    level_ = high;
+  }
+  time_ += bits * cycles_per_bit_;
+  bits_ += (uint64_t)ceil(bits);
+}
+
+void LinWaveBuilder::idle(double bits) {
+  level(true, bits);
+}
+
+void LinWaveBuilder::byte(uint8_t value) {
+  level(false, 1);
+  for (uint8_t i = 0; i < 8; i++) {
+    level(value & (1 << i), 1);
+  }
+  level(true, 1);
+}
+
+void LinWaveBuilder::frame(const LinFrameSpec& spec) {
+  uint8_t bytes[10];
+  const uint8_t n = lin_wire::expectedBytes(spec, bytes);
+
+  // Header.
+  level(false, 13);
+  level(true, 1);
+  byte(0x55);
+  byte(bytes[0]);
+
+  // Response.
+  idle(spec.response_space_bits);
+  for (uint8_t i = 1; i < n; i++) {
+    if (i > 1) {
+      idle(spec.inter_byte_bits);
+    }
+    byte(bytes[i]);
+  }
+}
+
+void LinWaveBuilder::rawFrame(const uint8_t* bytes, uint8_t n) {
+  level(false, 13);
+  level(true, 1);
+  byte(0x55);
+  for (uint8_t i = 0; i < n; i++) {
+    byte(bytes[i]);
+  }
+}
+
+uint64_t LinWaveBuilder::endCycle() const {
+  return (uint64_t)llround(time_);
+}
@@ -0,0 +1,91 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIN_WAVE_H
+#define LIN_WAVE_H
+
+#include <stdint.h>
+
+#include "avr_sim.h"
+
+// A LIN frame as sent on the wire, before bit encoding.
+struct LinFrameSpec {
+  LinFrameSpec() : id(0), num_data_bytes(0), enhanced_checksum(false),
+      inter_byte_bits(0), response_space_bits(0) {}
+
+  // 6 bit frame id. The parity bits are added by the encoder.
+  uint8_t id;
+  uint8_t num_data_bytes;
+  uint8_t data[8];
+  bool enhanced_checksum;
+  // Recessive bits between the bytes of the response.
+  uint8_t inter_byte_bits;
+  // Recessive bits between the header and the response.
+  uint8_t response_space_bits;
+};
+
+// Reference implementations, independent of the firmware code.
+namespace lin_wire {
+  // Protected id, [P1,P0] parity bits over the 6 bit id.
+  uint8_t protectedId(uint8_t id);
+  uint8_t checksum(uint8_t pid, const uint8_t* data, uint8_t n, bool enhanced);
+  // The bytes the decoder should report for this frame: pid, data, checksum.
+  uint8_t expectedBytes(const LinFrameSpec& spec, uint8_t* out);
+}
+
+// Appends LIN bus levels to a waveform at a given baud rate. A non zero
+// baud_error_percent makes the master clock deviate from the nominal rate.
+class LinWaveBuilder {
+ public:
+  LinWaveBuilder(avr_sim::Waveform* wave, uint32_t baud, double baud_error_percent);
+
+  // Move each following edge by a random amount of up to +/- max_bits bit
+  // times, as seen with slow slopes and ground shifts on a real bus.
+  void setEdgeJitter(double max_bits, uint32_t seed);
+
+  // Recessive (high) bus time.
+  void idle(double bits);
+
+  // Break (13 dominant bits), break delimiter, sync byte, protected id, data
+  // and checksum.
+  void frame(const LinFrameSpec& spec);
+
+  // A frame of recorded bytes (protected id, data and checksum), sent as is
+  // without spaces. Takes rawFrameBits(n).
+  void rawFrame(const uint8_t* bytes, uint8_t n);
+  static double rawFrameBits(uint8_t n) { return 13 + 1 + 10 * (1 + n); }
+
+  // A single UART byte: start bit, 8 data bits lsb first and a stop bit.
+  void byte(uint8_t value);
+
+  // Cycle at the end of the waveform generated so far.
+  uint64_t endCycle() const;
+
+  // Number of bit times generated so far.
+  uint64_t bits() const { return bits_; }
+
+  double cyclesPerBit() const { return cycles_per_bit_; }
+
+ private:
+  void level(bool high, double bits);
+
+  avr_sim::Waveform* const wave_;
+  const double cycles_per_bit_;
+  double time_;
+  bool level_;
+  uint64_t bits_;
+  double jitter_cycles_;
+  uint32_t jitter_random_;
+  uint64_t last_edge_;
+};
+
+#endif
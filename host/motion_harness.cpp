@@ -0,0 +1,452 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host test harness of the motion state machine. Feeds it synthetic event
+// streams (position frames from a simulated table with motor inertia, new
+// targets, jog buttons, stop requests and the timeouts it asks for) in 1 ms
+// loop steps, and checks relay toggle counts, state transitions and their
+// latency. Exits non zero on failure.
+//
+// Usage: motion_harness [--verbose]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "coast_estimator.h"
+#include "hardware_clock.h"
+#include "motion.h"
+#include "position_tracker.h"
+#include "settings_store.h"
+
+namespace {
+  // Simulated table. Full speed up and down, acceleration with the motor on
+  // and braking after the cut. Coasts ~45 units up and ~25 down.
+  const double kUpSpeed = 350;
+  const double kDownSpeed = 420;
+  const double kAccel = 1500;
+  const double kBrakeUp = 1360;
+  const double kBrakeDown = 3530;
+  // Position frame period of the LIN schedule.
+  const uint32_t kFramePeriodMillis = 25;
+  const uint8_t kThreshold = 20;
+
+  bool verbose = false;
+  int failures = 0;
+
+  void check(bool ok, const char* scenario, const char* what) {
+    if (!ok) {
+      fprintf(stderr, "FAIL %s: %s\n", scenario, what);
+      failures++;
+    }
+  }
+
+  struct Toggle {
+    uint32_t millis;
+    uint8_t direction;
+  };
+
+  struct Transition {
+    uint32_t millis;
+    uint8_t from;
+    uint8_t to;
+  };
+
+  // Simulation state.
+  uint32_t now = 0;
+  double position = 1000;
+  double speed = 0;
+  uint8_t motor = motion::kStop;
+  bool frames_enabled = true;
+  double noise = 0;
+  uint32_t random_state = 1;
+  uint32_t events = 0;
+  uint32_t loops = 0;
+  std::vector<Toggle> toggles;
+  std::vector<Transition> transitions;
+  uint8_t last_state = motion::states::IDLE;
+  int32_t current_target = -1;
+  // Time of the last cut relative to the ideal one, which lands the table on
+  // the target with the actual braking. Negative if early.
+  double cut_error_millis = 0;
+
+  const char* stateName(uint8_t state) {
+    switch (state) {
+      case motion::states::IDLE: return "IDLE";
+      case motion::states::MOVING_UP: return "MOVING_UP";
+      case motion::states::MOVING_DOWN: return "MOVING_DOWN";
+      case motion::states::SETTLING: return "SETTLING";
+      case motion::states::FAULT: return "FAULT";
+    }
+    return "?";
+  }
+
+  double coastOf(double speed) {
+    return speed > 0 ? speed * speed / (2 * kBrakeUp) : speed * speed / (2 * kBrakeDown);
+  }
+
+  void onMotor(uint8_t direction) {
+    if (direction == motion::kStop && current_target >= 0 && speed != 0) {
+      const double remaining = speed > 0 ? current_target - position : position - current_target;
+      cut_error_millis = (remaining - coastOf(speed)) / fabs(speed) * 1000;
+    }
+    Toggle toggle = {now, direction};
+    toggles.push_back(toggle);
+    motor = direction;
+  }
+
+  void observe() {
+    const uint8_t state = motion::state();
+    if (state != last_state) {
+      Transition transition = {now, last_state, state};
+      transitions.push_back(transition);
+      if (verbose) {
+        printf("  %6u ms  %-11s -> %-11s position %.1f\n", now, stateName(last_state),
+            stateName(state), position);
+      }
+      last_state = state;
+    }
+  }
+
+  void stepTable() {
+    const double dt = 0.001;
+    if (motor == motion::kUp) {
+      speed = fmin(kUpSpeed, speed + kAccel * dt);
+    } else if (motor == motion::kDown) {
+      speed = fmax(-kDownSpeed, speed - kAccel * dt);
+    } else if (speed > 0) {
+      speed = fmax(0, speed - kBrakeUp * dt);
+    } else {
+      speed = fmin(0, speed + kBrakeDown * dt);
+    }
+    position += speed * dt;
+  }
+
+  double nextNoise() {
+    random_state = random_state * 1103515245 + 12345;
+    return noise * (((random_state >> 8) & 0xffff) / 32767.5 - 1);
+  }
+
+  // Runs the given number of 1 ms loop iterations.
+  void run(uint32_t millis) {
+    for (uint32_t i = 0; i < millis; i++) {
+      now++;
+      loops++;
+      stepTable();
+      if (frames_enabled && (now % kFramePeriodMillis) == 0) {
+        const uint16_t measured = (uint16_t)lround(position + nextNoise());
+        position_tracker::addSample(measured, (uint16_t)(now * hardware_clock::kTicksPerMilli));
+        motion::onPosition(measured, position_tracker::velocity(), now, now);
+        events++;
+        observe();
+      }
+      if (motion::hasDeadline() && (int32_t)(now - motion::deadline()) >= 0) {
+        motion::onTimeout(now);
+        events++;
+        observe();
+      }
+    }
+  }
+
+  // Runs until the state machine is idle (or faulted) and the table stopped.
+  void runUntilIdle(uint32_t max_millis) {
+    for (uint32_t i = 0; i < max_millis; i++) {
+      run(1);
+      const uint8_t state = motion::state();
+      if ((state == motion::states::IDLE || state == motion::states::FAULT) && speed == 0) {
+        return;
+      }
+    }
+  }
+
+  void target(uint16_t value) {
+    current_target = value;
+    motion::onTarget(value, now);
+    events++;
+    observe();
+  }
+
+  void jog(uint8_t direction) {
+    current_target = -1;
+    motion::onJog(direction, now);
+    events++;
+    observe();
+  }
+
+  void stop() {
+    current_target = -1;
+    motion::onStop(now);
+    events++;
+    observe();
+  }
+
+  // Starts a scenario from a stopped table.
+  void begin(const char* name) {
+    toggles.clear();
+    transitions.clear();
+    events = 0;
+    loops = 0;
+    if (verbose) {
+      printf("%s\n", name);
+    }
+  }
+
+  // Relay direction changed straight from up to down or the other way.
+  bool hasDirectReversal() {
+    uint8_t previous = motion::kStop;
+    for (size_t i = 0; i < toggles.size(); i++) {
+      if (previous != motion::kStop && toggles[i].direction != motion::kStop) {
+        return true;
+      }
+      previous = toggles[i].direction;
+    }
+    return false;
+  }
+
+  // Shortest motor off time between two moves.
+  uint32_t minOffMillis() {
+    uint32_t min_off = UINT32_MAX;
+    for (size_t i = 1; i < toggles.size(); i++) {
+      if (toggles[i - 1].direction == motion::kStop) {
+        const uint32_t off = toggles[i].millis - toggles[i - 1].millis;
+        if (off < min_off) {
+          min_off = off;
+        }
+      }
+    }
+    return min_off;
+  }
+
+  void report(const char* name, const char* details) {
+    printf("%-22s toggles %2u  transitions %2u  events %5u / %6u loops  %s\n", name,
+        (unsigned)toggles.size(), (unsigned)transitions.size(), events, loops, details);
+  }
+
+  // Repeated moves between two heights. The coast is learned, the first
+  // moves stop short and need a correction.
+  void testMoves() {
+    const char* name = "moves";
+    int max_error = 0;
+    double min_cut_error = 1e9;
+    double max_cut_error = -1e9;
+    for (int i = 0; i < 12; i++) {
+      begin(name);
+      const uint32_t start = now;
+      target(i % 2 ? 1200 : 3000);
+      check(!toggles.empty() && toggles[0].millis == start, name, "motor starts with the event");
+      runUntilIdle(60000);
+      check(motion::state() == motion::states::IDLE, name, "ends idle");
+      const int error = (int)lround(position) - current_target;
+      check(abs(error) <= kThreshold, name, "final error within the threshold");
+      check(!hasDirectReversal(), name, "no direct reversal");
+      check(minOffMillis() >= motion::kSettleMillis, name, "settles before a correction");
+      if (i >= 6) {
+        // Learned by now, one move without correction.
+        max_error = abs(error) > max_error ? abs(error) : max_error;
+        check(toggles.size() == 2, name, "learned moves toggle twice");
+        min_cut_error = fmin(min_cut_error, cut_error_millis);
+        max_cut_error = fmax(max_cut_error, cut_error_millis);
+      }
+    }
+    char details[120];
+    snprintf(details, sizeof(details),
+        "cut vs ideal %+.0f..%+.0f ms, error <= %d, coast up %u down %u", min_cut_error,
+        max_cut_error, max_error, coast_estimator::learnedCoast(motion::kUp),
+        coast_estimator::learnedCoast(motion::kDown));
+    report(name, details);
+  }
+
+  // A target behind the table while moving: cut at once, settle, reverse.
+  void testReverse() {
+    const char* name = "reverse target";
+    begin(name);
+    target(3000);
+    run(1000);
+    const uint32_t event_millis = now;
+    target(1500);
+    check(toggles.size() == 2 && toggles[1].millis == event_millis, name, "cut with the event");
+    runUntilIdle(60000);
+    check(toggles.size() == 4, name, "four toggles");
+    check(!hasDirectReversal(), name, "no direct reversal");
+    check(minOffMillis() >= motion::kSettleMillis, name, "settles before reversing");
+    check(abs((int)lround(position) - 1500) <= kThreshold, name, "reaches the new target");
+    char details[80];
+    snprintf(details, sizeof(details), "cut latency 0 ms, motor off %u ms", minOffMillis());
+    report(name, details);
+  }
+
+  void testJog() {
+    const char* name = "jog";
+    begin(name);
+    jog(motion::kUp);
+    run(2000);
+    jog(motion::kStop);
+    const uint32_t release_millis = now;
+    runUntilIdle(10000);
+    check(toggles.size() == 2, name, "two toggles");
+    check(toggles.size() == 2 && toggles[1].millis == release_millis, name, "cut on release");
+    check(motion::target() == (uint16_t)lround(position), name, "no target after a jog");
+    report(name, "start and cut latency 0 ms");
+  }
+
+  // The other jog button pressed while jogging: cut, settle, jog the other
+  // way while held.
+  void testJogReverse() {
+    const char* name = "jog reverse";
+    begin(name);
+    jog(motion::kUp);
+    run(2000);
+    jog(motion::kDown);
+    run(3000);
+    check(motion::state() == motion::states::MOVING_DOWN, name, "jogs down while held");
+    check(toggles.size() == 3 && toggles[2].direction == motion::kDown, name, "three toggles");
+    check(!hasDirectReversal(), name, "no direct reversal");
+    check(minOffMillis() >= motion::kSettleMillis, name, "settles before reversing");
+    jog(motion::kStop);
+    runUntilIdle(10000);
+    check(toggles.size() == 4, name, "cut on release");
+    char details[80];
+    snprintf(details, sizeof(details), "motor off %u ms", minOffMillis());
+    report(name, details);
+  }
+
+  // A jog pressed while the table settles after a move starts once settled.
+  void testJogWhileSettling() {
+    const char* name = "jog during settling";
+    begin(name);
+    const uint16_t start = (uint16_t)lround(position);
+    target(start + 1000);
+    for (int i = 0; i < 60000 && motion::state() != motion::states::SETTLING; i++) {
+      run(1);
+    }
+    check(motion::state() == motion::states::SETTLING, name, "settles");
+    jog(motion::kUp);
+    run(2000);
+    check(motion::state() == motion::states::MOVING_UP, name, "jogs up while held");
+    check(toggles.size() == 3 && toggles[2].direction == motion::kUp, name, "three toggles");
+    jog(motion::kStop);
+    const uint32_t release_millis = now;
+    runUntilIdle(10000);
+    check(toggles.size() == 4 && toggles[3].millis == release_millis, name, "cut on release");
+    check(motion::target() == (uint16_t)lround(position), name, "no target after a jog");
+    report(name, "");
+    // Back to where the scenario started, for the next ones.
+    target(start);
+    runUntilIdle(60000);
+  }
+
+  // A target sent while the table settles after a jog: the move to it
+  // starts once settled.
+  void testTargetWhileSettlingAfterJog() {
+    const char* name = "target after jog";
+    begin(name);
+    const uint16_t start = (uint16_t)lround(position);
+    jog(motion::kUp);
+    run(1500);
+    jog(motion::kStop);
+    run(1);
+    check(motion::state() == motion::states::SETTLING, name, "settles");
+    target(start);
+    runUntilIdle(60000);
+    check(motion::state() == motion::states::IDLE, name, "ends idle");
+    check(toggles.size() >= 4 && toggles[2].direction == motion::kDown, name,
+        "moves to the target");
+    check(abs((int)lround(position) - start) <= kThreshold, name, "reaches the target");
+    check(!hasDirectReversal(), name, "no direct reversal");
+    check(minOffMillis() >= motion::kSettleMillis, name, "settles before the move");
+    char details[80];
+    snprintf(details, sizeof(details), "motor off %u ms", minOffMillis());
+    report(name, details);
+  }
+
+  void testStop() {
+    const char* name = "stop";
+    begin(name);
+    target(1000);
+    run(1500);
+    const uint32_t stop_millis = now;
+    stop();
+    runUntilIdle(10000);
+    check(toggles.size() == 2 && toggles[1].millis == stop_millis, name, "cut with the event");
+    run(2000);
+    check(toggles.size() == 2, name, "no correction after stop");
+    report(name, "cut latency 0 ms");
+  }
+
+  // Position frames stop while moving.
+  void testStall() {
+    const char* name = "stall";
+    begin(name);
+    target(3000);
+    run(500);
+    frames_enabled = false;
+    const uint32_t lost_millis = now;
+    run(motion::kStallMillis + 500);
+    check(motion::state() == motion::states::FAULT, name, "faults");
+    check(motion::direction() == motion::kStop, name, "motor off");
+    const uint32_t fault_latency = transitions.back().millis - lost_millis;
+    check(fault_latency <= motion::kStallMillis, name, "within kStallMillis");
+    frames_enabled = true;
+    run(500);
+    target(1000);
+    run(500);
+    check(toggles.size() == 2, name, "targets ignored in FAULT");
+    stop();
+    check(motion::state() == motion::states::IDLE, name, "stop clears");
+    char details[80];
+    snprintf(details, sizeof(details), "fault %u ms after the frames stopped", fault_latency);
+    report(name, details);
+  }
+
+  // Noisy positions at rest must not move the table.
+  void testNoise() {
+    const char* name = "noise at rest";
+    target((uint16_t)lround(position));
+    runUntilIdle(10000);
+    begin(name);
+    noise = kThreshold / 2;
+    run(20000);
+    noise = 0;
+    check(toggles.empty(), name, "no toggles");
+    check(transitions.empty(), name, "no transitions");
+    report(name, "");
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  verbose = argc > 1 && !strcmp(argv[1], "--verbose");
+
+  // Erased EEPROM. As main, until learned the coast is the threshold.
+  settings_store::setup();
+  coast_estimator::setup(kThreshold);
+  motion::setup(onMotor, kThreshold);
+  run(100);
+
+  testMoves();
+  testReverse();
+  testJog();
+  testJogReverse();
+  testJogWhileSettling();
+  testTargetWhileSettlingAfterJog();
+  testStop();
+  testStall();
+  testNoise();
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("motion_harness: all checks passed\n");
+  return 0;
+}
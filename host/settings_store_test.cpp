@@ -0,0 +1,347 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host test of the settings_store journal on the simulated EEPROM. Checks
+// recovery after reboots and after power losses at random points of record
+// writes, write coalescing, cell wear, the EEPROM ISR time and the main
+// loop time of saves compared to EEPROM.put(). Exits non zero on failure.
+//
+// Usage: settings_store_test [--trials N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EEPROM.h"
+#include "settings_store.h"
+
+namespace {
+  const uint64_t kCyclesPerMilli = F_CPU / 1000;
+
+  int failures = 0;
+  uint32_t now_millis = 0;
+  // Longest simulated time (register accesses and EEPROM waits) of one
+  // save() or loop() call, in cycles.
+  uint64_t max_main_cycles = 0;
+  // Longest simulated EE_READY ISR, entry and exit included.
+  uint64_t max_isr_cycles = 0;
+  // Half a LIN bit at 19200 baud, the sampling margin of the LIN ISRs.
+  const uint64_t kHalfLinBitCycles = F_CPU / 19200 / 2;
+
+  void check(bool ok, const char* what) {
+    if (!ok) {
+      fprintf(stderr, "FAIL %s\n", what);
+      failures++;
+    }
+  }
+
+  // Deterministic across platforms, unlike rand().
+  uint32_t random_state = 1;
+  uint32_t nextRandom(uint32_t range) {
+    random_state = random_state * 1103515245 + 12345;
+    return ((random_state >> 8) & 0xffffff) % range;
+  }
+
+  void onIsr(avr_sim::Vector vector, uint64_t start_cycle, uint64_t end_cycle, uint64_t) {
+    if (vector == avr_sim::kEeReadyVector && end_cycle - start_cycle > max_isr_cycles) {
+      max_isr_cycles = end_cycle - start_cycle;
+    }
+  }
+
+  void loopOnce() {
+    const uint64_t start = avr_sim::cycle();
+    settings_store::loop(now_millis);
+    const uint64_t cycles = avr_sim::cycle() - start;
+    if (cycles > max_main_cycles) {
+      max_main_cycles = cycles;
+    }
+  }
+
+  // Runs the main loop once per millisecond, with the EEPROM interrupts in
+  // between.
+  void runMillis(uint32_t millis) {
+    for (uint32_t i = 0; i < millis; i++) {
+      now_millis++;
+      avr_sim::runUntil(avr_sim::cycle() + kCyclesPerMilli);
+      loopOnce();
+    }
+  }
+
+  void runUntilWritten() {
+    for (uint32_t i = 0; i < 10000 && settings_store::pending(); i++) {
+      runMillis(1);
+    }
+  }
+
+  void timedSave(const settings_store::Settings& settings) {
+    const uint64_t start = avr_sim::cycle();
+    settings_store::save(settings);
+    const uint64_t cycles = avr_sim::cycle() - start;
+    if (cycles > max_main_cycles) {
+      max_main_cycles = cycles;
+    }
+  }
+
+  // Power on. Returns the setup() time in cycles.
+  uint64_t boot(bool* found) {
+    avr_sim::reset();
+    avr_sim::enableInterrupts();
+    const uint64_t start = avr_sim::cycle();
+    *found = settings_store::setup();
+    return avr_sim::cycle() - start;
+  }
+
+  settings_store::Settings makeSettings(uint32_t n) {
+    settings_store::Settings settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.memory[0] = 1000 + n % 5000;
+    settings.memory[1] = 6000 - n % 5000;
+    settings.coast[0] = n % 100;
+    settings.coast[1] = n % 77;
+    settings.coast_speed[0] = 300;
+    settings.coast_speed[1] = 400;
+    settings.threshold = 50 + n % 200;
+    return settings;
+  }
+
+  bool equals(const settings_store::Settings& a, const settings_store::Settings& b) {
+    return !memcmp(&a, &b, sizeof(a));
+  }
+
+  void testEmpty() {
+    avr_sim::eepromErase();
+    bool found;
+    boot(&found);
+    check(!found, "empty: nothing found");
+    settings_store::Settings ones;
+    memset(&ones, 0xff, sizeof(ones));
+    check(equals(settings_store::settings(), ones), "empty: all ones");
+    check(!settings_store::pending(), "empty: nothing pending");
+  }
+
+  void testReboot() {
+    avr_sim::eepromErase();
+    bool found;
+    boot(&found);
+    const settings_store::Settings settings = makeSettings(7);
+    timedSave(settings);
+    check(settings_store::pending(), "reboot: pending after save");
+    runMillis(settings_store::kWriteDelayMillis - 10);
+    check(settings_store::stats().records_written == 0, "reboot: write deferred");
+    runUntilWritten();
+    check(settings_store::stats().records_written == 1, "reboot: one record");
+    const uint64_t boot_cycles = boot(&found);
+    check(found, "reboot: found");
+    check(equals(settings_store::settings(), settings), "reboot: same settings");
+    check(settings_store::stats().sequence == 1, "reboot: sequence");
+    printf("  boot with one record: %.0f us\n", boot_cycles * 1e6 / F_CPU);
+  }
+
+  // A long press that stores the same position again, and a burst of
+  // changes, are one record each.
+  void testCoalescing() {
+    avr_sim::eepromErase();
+    bool found;
+    boot(&found);
+    settings_store::Settings settings = makeSettings(1);
+    for (int i = 0; i < 50; i++) {
+      timedSave(settings);
+      runMillis(10);
+    }
+    for (int i = 0; i < 50; i++) {
+      settings.memory[0] = 2000 + i;
+      timedSave(settings);
+      runMillis(10);
+    }
+    runUntilWritten();
+    const settings_store::Stats& stats = settings_store::stats();
+    printf("  100 saves in 1 s: %u records, %u saves coalesced, %u bytes written, %u unchanged\n",
+        stats.records_written, stats.saves_coalesced, stats.bytes_written, stats.bytes_skipped);
+    check(stats.records_written <= 2, "coalescing: at most two records");
+    boot(&found);
+    check(equals(settings_store::settings(), settings), "coalescing: last settings stored");
+  }
+
+  // Many records over all slots. Every cell wears at the same rate.
+  void testWear() {
+    avr_sim::eepromErase();
+    bool found;
+    boot(&found);
+    const uint32_t kRecords = 20 * settings_store::kSlots;
+    for (uint32_t i = 0; i < kRecords; i++) {
+      timedSave(makeSettings(i));
+      runMillis(settings_store::kWriteDelayMillis);
+      runUntilWritten();
+    }
+    boot(&found);
+    check(found && equals(settings_store::settings(), makeSettings(kRecords - 1)),
+        "wear: last settings stored");
+    const uint16_t used = settings_store::kSlots * settings_store::kRecordSize;
+    uint32_t min_writes = UINT32_MAX;
+    uint32_t max_writes = 0;
+    uint64_t total = 0;
+    for (uint16_t address = 0; address < used; address++) {
+      const uint32_t writes = avr_sim::eepromWrites(address);
+      min_writes = writes < min_writes ? writes : min_writes;
+      max_writes = writes > max_writes ? writes : max_writes;
+      total += writes;
+    }
+    printf("  %u records: cell writes min %u, mean %.1f, max %u, estimate %u "
+        "(fixed addresses: %u)\n", kRecords, min_writes, (double)total / used, max_writes,
+        settings_store::cellWrites(), kRecords);
+    check(max_writes <= settings_store::cellWrites() + 1, "wear: estimate holds");
+    check(max_writes <= kRecords / settings_store::kSlots + 1, "wear: spread over all slots");
+  }
+
+  // Slot 0 holds the fixed address layout of older firmware, with values
+  // whose bytes would pass as the highest sequence. Boots before and after
+  // the first record, and after the journal wrapped around and claimed
+  // slot 0, see no bad record.
+  void testLegacyImage() {
+    avr_sim::eepromErase();
+    uint8_t* const eeprom = avr_sim::eeprom();
+    // Threshold, memory 1 and 2, coast up and down, coast speeds.
+    const uint8_t legacy[] = { 120, 0xd0, 0x07, 0xb8, 0x0b, 45, 0, 26, 0, 0x5e, 0x01, 0xa4,
+        0x01 };
+    memcpy(eeprom, legacy, sizeof(legacy));
+    bool found;
+    boot(&found);
+    check(!found, "legacy: no record");
+    check(settings_store::stats().bad_records == 0, "legacy: no bad record before a save");
+    timedSave(makeSettings(1));
+    runMillis(settings_store::kWriteDelayMillis);
+    runUntilWritten();
+    check(!memcmp(eeprom, legacy, sizeof(legacy)), "legacy: slot 0 kept by the first record");
+    boot(&found);
+    check(found && equals(settings_store::settings(), makeSettings(1)), "legacy: record found");
+    check(settings_store::stats().bad_records == 0, "legacy: no bad record after a save");
+
+    for (uint32_t i = 2; i <= settings_store::kSlots; i++) {
+      timedSave(makeSettings(i));
+      runMillis(settings_store::kWriteDelayMillis);
+      runUntilWritten();
+    }
+    check(memcmp(eeprom, legacy, sizeof(legacy)) != 0, "legacy: slot 0 claimed");
+    boot(&found);
+    check(found && equals(settings_store::settings(), makeSettings(settings_store::kSlots)),
+        "legacy: record in slot 0 found");
+    check(settings_store::stats().bad_records == 0, "legacy: no bad record after the wrap");
+    printf("  legacy image in slot 0: %u bad records at boot\n",
+        settings_store::stats().bad_records);
+  }
+
+  // Power lost at a random point of a record write. Boot must find either
+  // the old or the new settings, and saving must go on working.
+  void testPowerLoss(uint32_t trials) {
+    avr_sim::eepromErase();
+    bool found;
+    boot(&found);
+    timedSave(makeSettings(0));
+    runMillis(settings_store::kWriteDelayMillis);
+    runUntilWritten();
+    settings_store::Settings old_settings = makeSettings(0);
+
+    uint32_t recovered_old = 0;
+    uint32_t recovered_new = 0;
+    uint32_t bad_records = 0;
+    uint64_t max_boot_cycles = 0;
+    const uint64_t kRecordCycles =
+        (uint64_t)settings_store::kRecordSize * avr_sim::kEepromWriteCycles;
+    for (uint32_t i = 1; i <= trials; i++) {
+      const settings_store::Settings new_settings = makeSettings(i);
+      timedSave(new_settings);
+      const uint16_t records = settings_store::stats().records_written;
+      while (settings_store::stats().records_written == records) {
+        runMillis(1);
+      }
+      // The record write just started.
+      avr_sim::runUntil(avr_sim::cycle() + nextRandom(kRecordCycles + kCyclesPerMilli));
+      avr_sim::eepromPowerLoss();
+
+      const uint64_t boot_cycles = boot(&found);
+      max_boot_cycles = boot_cycles > max_boot_cycles ? boot_cycles : max_boot_cycles;
+      bad_records += settings_store::stats().bad_records;
+      if (!found) {
+        check(false, "power loss: a record found");
+        break;
+      }
+      if (equals(settings_store::settings(), new_settings)) {
+        recovered_new++;
+        old_settings = new_settings;
+      } else if (equals(settings_store::settings(), old_settings)) {
+        recovered_old++;
+      } else {
+        check(false, "power loss: old or new settings");
+        break;
+      }
+    }
+    printf("  %u power losses: %u old, %u new settings, %u torn records seen, "
+        "boot <= %.0f us\n", trials, recovered_old, recovered_new, bad_records,
+        max_boot_cycles * 1e6 / F_CPU);
+    check(recovered_old && recovered_new, "power loss: both outcomes hit");
+
+    // Still works.
+    timedSave(makeSettings(123456));
+    runMillis(settings_store::kWriteDelayMillis);
+    runUntilWritten();
+    boot(&found);
+    check(found && equals(settings_store::settings(), makeSettings(123456)),
+        "power loss: saves after recovery");
+  }
+
+  // Main loop time of saving a uint16 and a uint8, as the firmware did
+  // before, with EEPROM.put() at fixed addresses.
+  double legacyPutMillis() {
+    avr_sim::eepromErase();
+    avr_sim::reset();
+    const uint32_t kSaves = 20;
+    const uint64_t start = avr_sim::cycle();
+    for (uint32_t i = 0; i < kSaves; i++) {
+      EEPROM.put(1, (uint16_t)(2000 + i));
+      EEPROM.put(0, (uint8_t)(60 + i));
+    }
+    return (avr_sim::cycle() - start) * 1000.0 / F_CPU / kSaves;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  uint32_t trials = 500;
+  if (argc == 3 && !strcmp(argv[1], "--trials")) {
+    trials = strtoul(argv[2], NULL, 10);
+  } else if (argc != 1) {
+    fprintf(stderr, "Usage: %s [--trials N]\n", argv[0]);
+    return 2;
+  }
+
+  printf("settings_store: %u byte records, %u slots\n", settings_store::kRecordSize,
+      settings_store::kSlots);
+  avr_sim::setIsrObserver(onIsr);
+  testEmpty();
+  testReboot();
+  testCoalescing();
+  testWear();
+  testLegacyImage();
+  testPowerLoss(trials);
+
+  printf("  EEPROM wait in the main loop: save() and loop() <= %.1f us, "
+      "EEPROM.put() %.2f ms per save\n",
+      max_main_cycles * 1e6 / F_CPU, legacyPutMillis());
+  printf("  EE_READY ISR <= %u cycles\n", (unsigned)max_isr_cycles);
+  check(max_isr_cycles * 4 <= kHalfLinBitCycles, "EE_READY ISR within a quarter LIN half bit");
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("settings_store_test: all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HOST_SHIM_EEPROM_H
+#define HOST_SHIM_EEPROM_H
+
+// Host stand-in for the Arduino EEPROM library, over the simulated EEPROM
+// registers. Like avr-libc, each access first waits for the write in
+// progress.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arduino.h"
+
+class EEPROMClass {
+ public:
+  static const int kSize = 1024;
+
+  uint8_t read(int address) {
+    while (EECR & (1 << EEPE)) {
+    }
+    EEAR = address;
+    EECR |= (1 << EERE);
+    return EEDR;
+  }
+
+  void write(int address, uint8_t value) {
+    while (EECR & (1 << EEPE)) {
+    }
+    EEAR = address;
+    EEDR = value;
+    EECR |= (1 << EEMPE);
+    EECR |= (1 << EEPE);
+  }
+
+  template <typename T>
+  T& get(int address, T& value) {
+    uint8_t* p = reinterpret_cast<uint8_t*>(&value);
+    for (size_t i = 0; i < sizeof(T); i++) {
+      p[i] = read(address + i);
+    }
+    return value;
+  }
+
+  template <typename T>
+  const T& put(int address, const T& value) {
+    // Like the real one, only the changed bytes are written.
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    for (size_t i = 0; i < sizeof(T); i++) {
+      if (read(address + i) != p[i]) {
+        write(address + i, p[i]);
+      }
+    }
+    return value;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
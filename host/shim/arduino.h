@@ -0,0 +1,205 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HOST_SHIM_ARDUINO_H
+#define HOST_SHIM_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core and avr-libc that the
+// lin_processor library uses. The I/O registers are routed to the simulator
+// in avr_sim.h. Only what the library actually touches is provided.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avr_sim.h"
+
+#ifndef F_CPU
+#error "Define F_CPU (e.g. -DF_CPU=16000000L) in the host build flags."
+#endif
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// ----- avr/pgmspace.h -----
+
+#define PROGMEM
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+// Pointers are wider than 16 bits on the host. Read the object with its own
+// type so pgm_read_word() of a pointer field keeps working.
+#define pgm_read_word(addr) (*(addr))
+#define vsnprintf_P vsnprintf
+
+// ----- avr/interrupt.h -----
+
+#define cli() avr_sim::disableInterrupts()
+#define sei() avr_sim::enableInterrupts()
+// Defines an unmangled function that the simulator calls as the vector.
+#define ISR(vector) extern "C" void vector(void)
+
+// ----- avr/io.h, ATmega328P subset -----
+
+#define PINB (avr_sim::regs[avr_sim::kPINB])
+#define DDRB (avr_sim::regs[avr_sim::kDDRB])
+#define PORTB (avr_sim::regs[avr_sim::kPORTB])
+#define PINC (avr_sim::regs[avr_sim::kPINC])
+#define DDRC (avr_sim::regs[avr_sim::kDDRC])
+#define PORTC (avr_sim::regs[avr_sim::kPORTC])
+#define PIND (avr_sim::regs[avr_sim::kPIND])
+#define DDRD (avr_sim::regs[avr_sim::kDDRD])
+#define PORTD (avr_sim::regs[avr_sim::kPORTD])
+
+#define TCCR1A (avr_sim::regs[avr_sim::kTCCR1A])
+#define TCCR1B (avr_sim::regs[avr_sim::kTCCR1B])
+#define TIMSK1 (avr_sim::regs[avr_sim::kTIMSK1])
+#define TIFR1 (avr_sim::regs[avr_sim::kTIFR1])
+#define TCNT1 (avr_sim::regs16[avr_sim::kTCNT1])
+#define OCR1A (avr_sim::regs16[avr_sim::kOCR1A])
+#define OCR1B (avr_sim::regs16[avr_sim::kOCR1B])
+#define ICR1 (avr_sim::regs16[avr_sim::kICR1])
+
+#define TCCR2A (avr_sim::regs[avr_sim::kTCCR2A])
+#define TCCR2B (avr_sim::regs[avr_sim::kTCCR2B])
+#define TCNT2 (avr_sim::regs[avr_sim::kTCNT2])
+#define OCR2A (avr_sim::regs[avr_sim::kOCR2A])
+#define OCR2B (avr_sim::regs[avr_sim::kOCR2B])
+#define TIMSK2 (avr_sim::regs[avr_sim::kTIMSK2])
+#define TIFR2 (avr_sim::regs[avr_sim::kTIFR2])
+
+#define UBRR0H (avr_sim::regs[avr_sim::kUBRR0H])
+#define UBRR0L (avr_sim::regs[avr_sim::kUBRR0L])
+#define UCSR0A (avr_sim::regs[avr_sim::kUCSR0A])
+#define UCSR0B (avr_sim::regs[avr_sim::kUCSR0B])
+#define UCSR0C (avr_sim::regs[avr_sim::kUCSR0C])
+#define UDR0 (avr_sim::regs[avr_sim::kUDR0])
+
+#define EICRA (avr_sim::regs[avr_sim::kEICRA])
+#define EIMSK (avr_sim::regs[avr_sim::kEIMSK])
+#define EIFR (avr_sim::regs[avr_sim::kEIFR])
+
+#define EECR (avr_sim::regs[avr_sim::kEECR])
+#define EEDR (avr_sim::regs[avr_sim::kEEDR])
+#define EEAR (avr_sim::regs16[avr_sim::kEEAR])
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define DDD3 3
+
+#define ISC01 1
+#define ISC00 0
+#define INT0 0
+#define INTF0 0
+
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11 1
+#define WGM10 0
+#define ICNC1 7
+#define ICES1 6
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+#define ICIE1 5
+#define OCIE1B 2
+#define OCIE1A 1
+#define TOIE1 0
+#define ICF1 5
+#define OCF1B 2
+#define OCF1A 1
+#define TOV1 0
+
+#define COM2A1 7
+#define COM2A0 6
+#define COM2B1 5
+#define COM2B0 4
+#define WGM21 1
+#define WGM20 0
+#define FOC2A 7
+#define FOC2B 6
+#define WGM22 3
+#define CS22 2
+#define CS21 1
+#define CS20 0
+#define OCIE2B 2
+#define OCIE2A 1
+#define TOIE2 0
+#define OCF2B 2
+#define OCF2A 1
+#define TOV2 0
+
+#define RXC0 7
+#define RXCIE0 7
+#define UDRE0 5
+#define DOR0 3
+#define U2X0 1
+#define RXEN0 4
+#define TXEN0 3
+#define UDORD0 2
+#define UCPHA0 1
+
+#define EERIE 3
+#define EEMPE 2
+#define EEPE 1
+#define EERE 0
+
+// ----- Arduino core -----
+
+// Serial writes to stdout. Input is not supported.
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+  operator bool() const { return true; }
+  int available() { return 0; }
+  int read() { return -1; }
+
+  void print(const char* s) { fputs(s, stdout); }
+  void print(const __FlashStringHelper* s) { print(reinterpret_cast<const char*>(s)); }
+  void print(char c) { fputc(c, stdout); }
+  void print(long v) { printf("%ld", v); }
+  void print(unsigned long v) { printf("%lu", v); }
+  void print(int v) { print((long)v); }
+  void print(unsigned int v) { print((unsigned long)v); }
+  void print(uint8_t v) { print((unsigned long)v); }
+
+  void println() { fputc('\n', stdout); }
+  template <typename T>
+  void println(T v) { print(v); println(); }
+};
+
+extern HardwareSerial Serial;
+
+#endif
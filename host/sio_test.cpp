@@ -0,0 +1,175 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Host test of the sio serial input on the simulated UART. Sends packets
+// and command lines while the main code is blocked printing a long reply
+// with text_io, then checks that all of it is read back, that an RX ring
+// overflow is counted, and the RX ISR time. Exits non zero on failure.
+//
+// Usage: sio_test
+
+#include <stdio.h>
+#include <string.h>
+
+#include "desk_protocol.h"
+#include "sio.h"
+#include "text_io.h"
+
+namespace {
+  int failures = 0;
+  // Longest simulated USART_RX ISR, entry and exit included.
+  uint64_t max_isr_cycles = 0;
+  // Half a LIN bit at 19200 baud, the sampling margin of the LIN ISRs.
+  const uint64_t kHalfLinBitCycles = F_CPU / 19200 / 2;
+  // Longer than the sio output buffer, so text_io waits on the UART.
+  const int kReplyChars = 600;
+
+  void check(bool ok, const char* what) {
+    if (!ok) {
+      fprintf(stderr, "FAIL %s\n", what);
+      failures++;
+    }
+  }
+
+  void onIsr(avr_sim::Vector vector, uint64_t start_cycle, uint64_t end_cycle, uint64_t) {
+    if (vector == avr_sim::kUsartRxVector && end_cycle - start_cycle > max_isr_cycles) {
+      max_isr_cycles = end_cycle - start_cycle;
+    }
+  }
+
+  void boot() {
+    avr_sim::reset();
+    avr_sim::setPreemption(true);
+    sio::setup();
+    sei();
+  }
+
+  // A status table like reply. Blocks until the last bytes are in the sio
+  // output buffer.
+  void printLongReply() {
+    for (int i = 0; i < kReplyChars / 20; i++) {
+      text_io::print(F("reply line "));
+      text_io::printUint(1000000 + i);
+      text_io::println();
+    }
+  }
+
+  // Reads all received bytes.
+  int readAll(uint8_t* out, int max_bytes) {
+    int n = 0;
+    while (sio::available() && n < max_bytes) {
+      out[n++] = sio::read();
+    }
+    return n;
+  }
+
+  // A MOVE_TO request arriving in the middle of a long reply.
+  void testPacketDuringReply() {
+    boot();
+    const uint8_t body[] = { 0xc4, 0x09 };
+    uint8_t wire[desk_protocol::kMaxWirePacket];
+    const uint8_t n = desk_protocol::encodePacket(desk_protocol::messages::MOVE_TO, body,
+        sizeof(body), wire);
+    const uint64_t start = avr_sim::cycle();
+    // Let the first part of the reply go out before the packet arrives.
+    text_io::print(F("status: "));
+    avr_sim::uartReceive(wire, n);
+    printLongReply();
+    const uint64_t blocked = avr_sim::cycle() - start;
+    check(avr_sim::uartRxIdleCycle() <= avr_sim::cycle(), "packet received while printing");
+
+    uint8_t received[64];
+    const int length = readAll(received, sizeof(received));
+    desk_protocol::PacketReader reader;
+    int packets = 0;
+    for (int i = 0; i < length; i++) {
+      if (reader.handleByte(received[i])) {
+        packets++;
+        check(reader.type() == desk_protocol::messages::MOVE_TO, "packet type");
+        check(reader.body_length() == sizeof(body) &&
+            desk_protocol::getU16(reader.body()) == 0x09c4, "packet body");
+      }
+    }
+    check(packets == 1, "one packet decoded");
+    check(reader.bad_packets() == 0, "no bad packets");
+    check(sio::rxOverruns() == 0, "no RX overruns");
+    printf("  packet during a %.1f ms reply: %d bytes, %d packet(s), %u bad, %u overruns\n",
+        blocked * 1e3 / F_CPU, length, packets, reader.bad_packets(), sio::rxOverruns());
+  }
+
+  // A typed command line during a reply, then more input than the ring
+  // holds.
+  void testTextDuringReply() {
+    boot();
+    const char kLine[] = "move 2500\r";
+    avr_sim::uartReceive((const uint8_t*)kLine, strlen(kLine));
+    printLongReply();
+    uint8_t received[sio::kRxQueueSize];
+    const int length = readAll(received, sizeof(received));
+    check(length == (int)strlen(kLine) && !memcmp(received, kLine, length),
+        "command line received intact");
+    check(sio::rxOverruns() == 0, "no RX overruns with a short line");
+
+    uint8_t flood[2 * sio::kRxQueueSize];
+    memset(flood, 'x', sizeof(flood));
+    avr_sim::uartReceive(flood, sizeof(flood));
+    printLongReply();
+    const int kept = readAll(received, sizeof(received));
+    // The ring keeps one slot free.
+    check(kept == sio::kRxQueueSize - 1, "full ring keeps its bytes");
+    check(sio::rxOverruns() == (int)sizeof(flood) - kept, "bytes past the ring counted");
+    printf("  %u bytes during a reply: %d kept, %u overruns\n", (unsigned)sizeof(flood), kept,
+        sio::rxOverruns());
+  }
+
+  // The UART alone, read once the reply is printed, as without the RX
+  // interrupt. Shows what the ring is for.
+  void testPolledDuringReply() {
+    boot();
+    UCSR0B = H(TXEN0) | H(RXEN0);
+    const char kLine[] = "move 2500\r";
+    avr_sim::uartReceive((const uint8_t*)kLine, strlen(kLine));
+    printLongReply();
+    int length = 0;
+    bool overrun = false;
+    while (UCSR0A & H(RXC0)) {
+      overrun |= (UCSR0A & H(DOR0)) != 0;
+      (void)(uint8_t)UDR0;
+      length++;
+    }
+    check(length == 2 && overrun, "polled UART keeps two bytes only");
+    printf("  polled, no RX interrupt: %d of %u bytes\n", length, (unsigned)strlen(kLine));
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return 2;
+  }
+
+  printf("sio: %u byte RX ring\n", sio::kRxQueueSize);
+  avr_sim::setIsrObserver(onIsr);
+  testPacketDuringReply();
+  testTextDuringReply();
+  testPolledDuringReply();
+
+  printf("  USART_RX ISR <= %u cycles\n", (unsigned)max_isr_cycles);
+  check(max_isr_cycles * 4 <= kHalfLinBitCycles, "USART_RX ISR within a quarter LIN half bit");
+
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("sio_test: all checks passed\n");
+  return 0;
+}
@@ -31,6 +31,11 @@ typedef int32_t int32;
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
+// Compiler memory barrier. Memory accesses are not moved across it. Used to
+// fill a buffer before the volatile index write that hands it over between
+// an ISR and main.
+#define MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
 // Private data. Do not use from other modules.
 namespace avr_util_private {
   extern const byte kBitMaskArray[];
@@ -15,6 +15,68 @@
 
 #include "avr_util.h"
 
+// LIN decoder backends, see LIN_DECODER below.
+#define LIN_DECODER_TIMER2 1
+#define LIN_DECODER_CAPTURE 2
+
+// Selects the LIN decoder backend at compile time. Can be overridden from the
+// build flags.
+//
+// LIN_DECODER_TIMER2 samples the RX pin (PD2) in the middle of each bit from
+// Timer2 compare interrupts.
+//
+// LIN_DECODER_CAPTURE timestamps the RX edges with the Timer1 input capture
+// and reconstructs the bytes from the edge deltas in readNextFrame(). One
+// interrupt per edge instead of one per bit. The resolution is one hardware
+// clock tick (4us). Requires the LIN RX signal on ICP1 (PB0, Arduino pin 8).
+#ifndef LIN_DECODER
+#define LIN_DECODER LIN_DECODER_TIMER2
+#endif
+
+// Log levels, see src/logger.h.
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Highest log level compiled in. Can be overridden from the build flags.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// 1 to time the LIN decoder ISRs, see isr_profiler.h. Adds about 20 cycles
+// to each ISR call. Can be overridden from the build flags.
+#ifndef LIN_ISR_PROFILER
+#define LIN_ISR_PROFILER 0
+#endif
+
+// 1 to collect the LIN bus statistics of lin_stats.h. The frames of the
+// ids not subscribed to are counted at their id, the decoder still drops
+// them there. Can be overridden from the build flags.
+#ifndef LIN_BUS_STATS
+#define LIN_BUS_STATS 1
+#endif
+
+// 1 to build the LIN trace recorder of lin_trace.h, which takes
+// kLinTraceBytes of RAM. The decoder then reads the frames of all ids. Can
+// be overridden from the build flags.
+#ifndef LIN_TRACE
+#define LIN_TRACE 0
+#endif
+
+// 1 to measure the entry latency of the Timer2 bit tick ISR by the critical
+// section that caused it, see isr_latency.h. LIN_DECODER_TIMER2 only. Can be
+// overridden from the build flags.
+#ifndef LIN_ISR_LATENCY
+#define LIN_ISR_LATENCY 0
+#endif
+
+// 1 to build the main loop time histogram of src/loop_profiler.h, 0 to
+// leave it out. Can be overridden from the build flags.
+#ifndef LOOP_PROFILER
+#define LOOP_PROFILER 1
+#endif
+
 // Custom application specific parameters.
 //
 // Like all the other custom_* files, this file should be adapted to the specific application.
@@ -22,13 +84,40 @@
 namespace custom_defs {
 
   // True for LIN checksum V2 (enahanced). False for LIN checksum version 1.
+  // Ignored for the diagnostic frames (always V1) and if
+  // kAutoDetectLinChecksum.
   const boolean kUseLinChecksumVersion2 = false;
 
+  // True to learn the checksum version of each frame id from the bus. See
+  // lin_checksum.h.
+  const boolean kAutoDetectLinChecksum = true;
+
   // LIN bus bits per second rate.
   // Supported baud range is 1000 to 20000. If out of range, using silently default
   // baud of 9600.
   const uint16 kLinSpeed = 19200;
 
+  // LIN_DECODER_TIMER2 only. True to detect the LIN break by timestamping the
+  // RX pin edges with INT0
+  // instead of sampling the idle bus on every Timer2 bit tick. Timer2
+  // interrupts are then enabled only while a frame is being read.
+  const boolean kUseEdgeBreakDetection = true;
+
+  // Min time between two logged table positions while the table moves.
+  const uint16 kLogPositionIntervalMillis = 250;
+
+  // Number of memory presets, 2 to 16. Each takes two bytes of RAM and of
+  // every settings record.
+  const uint8 kNumPresets = 8;
+
+  // Number of frame ids with an entry in the LIN bus statistics, 23 bytes
+  // of RAM each.
+  const uint8 kLinStatsIds = 8;
+
+  // Size of the LIN trace ring. Records take 6 bytes plus the frame bytes,
+  // ~14 for a position frame.
+  const uint16 kLinTraceBytes = 384;
+
 }  // namepsace custom_defs
 
 #endif
@@ -15,6 +15,7 @@
 
 #include <arduino.h>
 #include "avr_util.h"
+#include "isr_latency.h"
 
 // Provides a free running 16 bit counter with 250 ticks per millisecond and 
 // about 280 millis cycle time. Assuming 16Mhz clock.
@@ -34,6 +35,7 @@ namespace hardware_clock {
     // TODO: can we avoid disabling interrupts (motivation: improve LIN ISR jitter).
     cli();
     const uint16 result TCNT1;
+    isr_latency::endSection(isr_latency::sections::CLOCK_READ);
     sei();
     return result;
   }
@@ -14,6 +14,7 @@
 #define IO_PINS_H
 
 #include "avr_util.h"
+#include "isr_latency.h"
 
 namespace io_pins {
   // A class to abstract an output pin that is not necesarily an arduino 
@@ -43,6 +44,7 @@ namespace io_pins {
       // in the ISR invocation.
       cli();
       port_ |= bit_mask_;
+      isr_latency::endSection(isr_latency::sections::OUTPUT_PIN);
       sei();
     }
 
@@ -52,6 +54,7 @@ namespace io_pins {
       // in the ISR invocation.
       cli();
       port_ &= ~bit_mask_;
+      isr_latency::endSection(isr_latency::sections::OUTPUT_PIN);
       sei();
     }
 
@@ -0,0 +1,79 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "isr_latency.h"
+
+#if LIN_ISR_LATENCY
+
+namespace isr_latency {
+  namespace isr_latency_private {
+    volatile uint8 blamed_section;
+    uint32 counts[kNumSections][kNumBuckets];
+    uint8 max_counts[kNumSections];
+  }
+
+  using namespace isr_latency_private;
+
+  static uint8 cycles_per_count;
+
+  static const char kOtherName[] PROGMEM = "OTHER";
+  static const char kClockReadName[] PROGMEM = "CLOCK_READ";
+  static const char kOutputPinName[] PROGMEM = "OUTPUT_PIN";
+  static const char kErrorFlagsName[] PROGMEM = "ERROR_FLAGS";
+  static const char kStatsCopyName[] PROGMEM = "STATS_COPY";
+  static const char kRxEdgeIsrName[] PROGMEM = "RX_EDGE_ISR";
+  static const char kEepromIsrName[] PROGMEM = "EEPROM_ISR";
+  static const char kSerialRxIsrName[] PROGMEM = "SERIAL_RX_ISR";
+
+  // By section.
+  static const char* const kSectionNames[kNumSections] PROGMEM = {
+    kOtherName, kClockReadName, kOutputPinName, kErrorFlagsName, kStatsCopyName,
+    kRxEdgeIsrName, kEepromIsrName, kSerialRxIsrName,
+  };
+
+  void setup(uint8 cycles) {
+    cycles_per_count = cycles;
+    reset();
+  }
+
+  uint8 cyclesPerCount() {
+    return cycles_per_count;
+  }
+
+  const __FlashStringHelper* sectionName(uint8 section) {
+    return reinterpret_cast<const __FlashStringHelper*>(pgm_read_word(&kSectionNames[section]));
+  }
+
+  void get(uint8 section, uint32 buckets[kNumBuckets], uint8* max_count) {
+    cli();
+    for (uint8 i = 0; i < kNumBuckets; i++) {
+      buckets[i] = counts[section][i];
+    }
+    *max_count = max_counts[section];
+    endSection(sections::STATS_COPY);
+    sei();
+  }
+
+  void reset() {
+    for (uint8 section = 0; section < kNumSections; section++) {
+      cli();
+      for (uint8 i = 0; i < kNumBuckets; i++) {
+        counts[section][i] = 0;
+      }
+      max_counts[section] = 0;
+      endSection(sections::STATS_COPY);
+      sei();
+    }
+  }
+}  // namespace isr_latency
+
+#endif
@@ -0,0 +1,122 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ISR_LATENCY_H
+#define ISR_LATENCY_H
+
+#include <arduino.h>
+#include "avr_util.h"
+#include "custom_defs.h"
+
+// Entry latency of the Timer2 bit tick ISR, the delay of the RX samples of
+// LIN_DECODER_TIMER2. The ISR reads TCNT2 first thing: the counts since the
+// compare match, ISR entry and prologue included. The latencies are counted
+// in log2 buckets by the section that delayed the ISR: a critical section
+// or ISR that calls endSection() with the tick pending is blamed for the
+// next tick. Delays of untagged code (e.g. the Arduino Timer0 ISR) and the
+// plain entry cost go to OTHER.
+//
+// With LIN_ISR_LATENCY 0 (see custom_defs.h) the inline functions compile
+// to nothing and the rest is not built, no RAM is used. Call the extern
+// functions under #if LIN_ISR_LATENCY.
+namespace isr_latency {
+  // Like enum but 8 bits only.
+  namespace sections {
+    static const uint8 OTHER = 0;
+    // hardware_clock::ticksForNonIsr().
+    static const uint8 CLOCK_READ = 1;
+    // io_pins::OutputPin::high() and low().
+    static const uint8 OUTPUT_PIN = 2;
+    // lin_processor::getAndClearErrorFlags().
+    static const uint8 ERROR_FLAGS = 3;
+    // Copies of ISR counters by main, e.g. settings_store::stats().
+    static const uint8 STATS_COPY = 4;
+    // The INT0 RX edge ISR.
+    static const uint8 RX_EDGE_ISR = 5;
+    // The settings_store EEPROM ready ISR.
+    static const uint8 EEPROM_ISR = 6;
+    // The sio serial RX ISR.
+    static const uint8 SERIAL_RX_ISR = 7;
+  }
+  static const uint8 kNumSections = 8;
+
+  // Bucket 0 counts latencies of 0 and 1 Timer2 counts, bucket k of
+  // [2^k, 2^(k+1)) counts, the last one all above.
+  static const uint8 kNumBuckets = 8;
+
+  // Private data. Do not use from other modules.
+  namespace isr_latency_private {
+    extern volatile uint8 blamed_section;
+    extern uint32 counts[kNumSections][kNumBuckets];
+    extern uint8 max_counts[kNumSections];
+  }
+
+  // Call with interrupts disabled at the end of a tagged section: right
+  // before the sei() of a critical section or at the end of an ISR.
+  static inline void endSection(uint8 section) {
+#if LIN_ISR_LATENCY
+    // OCF2A and OCIE2A are the same bit.
+    if (TIFR2 & TIMSK2 & H(OCF2A)) {
+      isr_latency_private::blamed_section = section;
+    }
+#else
+    (void)section;
+#endif
+  }
+
+  // First thing in the Timer2 ISR. Pass the result to record().
+  static inline uint8 entryCount() {
+#if LIN_ISR_LATENCY
+    return TCNT2;
+#else
+    return 0;
+#endif
+  }
+
+  // Later in the same ISR.
+  static inline void record(uint8 entry_count) {
+#if LIN_ISR_LATENCY
+    using namespace isr_latency_private;
+    // The counter wraps to 0 one count after the match at OCR2A (top).
+    const uint8 latency = entry_count == OCR2A ? 0 : entry_count + 1;
+    const uint8 section = blamed_section;
+    blamed_section = sections::OTHER;
+    uint8 bucket = 0;
+    for (uint8 n = latency >> 1; n && bucket < kNumBuckets - 1; n >>= 1) {
+      bucket++;
+    }
+    counts[section][bucket]++;
+    if (latency > max_counts[section]) {
+      max_counts[section] = latency;
+    }
+#else
+    (void)entry_count;
+#endif
+  }
+
+  // Called by lin_processor::setup() with the Timer2 prescaler.
+  extern void setup(uint8 cycles_per_count);
+
+  extern uint8 cyclesPerCount();
+
+  // PROGMEM name of a section, e.g. "CLOCK_READ".
+  extern const __FlashStringHelper* sectionName(uint8 section);
+
+  // Copies the buckets and the max of a section, from main. Interrupts are
+  // disabled briefly.
+  extern void get(uint8 section, uint32 buckets[kNumBuckets], uint8* max_count);
+
+  // From main.
+  extern void reset();
+}  // namespace isr_latency
+
+#endif
@@ -0,0 +1,77 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "isr_profiler.h"
+
+#include "isr_latency.h"
+
+namespace isr_profiler {
+  namespace isr_profiler_private {
+    SlotStats slot_stats[kNumSlots];
+  }
+
+  using namespace isr_profiler_private;
+
+  static uint32 window_start_millis;
+
+  static const char kDetectBreakName[] PROGMEM = "DETECT_BREAK";
+  static const char kRxEdgeName[] PROGMEM = "RX_EDGE";
+  static const char kSpaceName[] PROGMEM = "SPACE";
+  static const char kStartBitName[] PROGMEM = "START_BIT";
+  static const char kDataBitName[] PROGMEM = "DATA_BIT";
+  static const char kStopBitName[] PROGMEM = "STOP_BIT";
+  static const char kCaptureName[] PROGMEM = "CAPTURE";
+
+  // By slot.
+  static const char* const kSlotNames[kNumSlots] PROGMEM = {
+    kDetectBreakName, kRxEdgeName, kSpaceName, kStartBitName, kDataBitName, kStopBitName,
+    kCaptureName,
+  };
+
+  const __FlashStringHelper* slotName(uint8 slot) {
+    return reinterpret_cast<const __FlashStringHelper*>(pgm_read_word(&kSlotNames[slot]));
+  }
+
+  void get(uint8 slot, SlotStats* stats) {
+    cli();
+    *stats = slot_stats[slot];
+    isr_latency::endSection(isr_latency::sections::STATS_COPY);
+    sei();
+  }
+
+  void reset(uint32 now_millis) {
+    for (uint8 i = 0; i < kNumSlots; i++) {
+      cli();
+      slot_stats[i] = SlotStats();
+      isr_latency::endSection(isr_latency::sections::STATS_COPY);
+      sei();
+    }
+    window_start_millis = now_millis;
+  }
+
+  uint32 windowMillis(uint32 now_millis) {
+    return now_millis - window_start_millis;
+  }
+
+  uint16 cpuPercentX100(const SlotStats& stats, uint32 now_millis) {
+    // 10000 / kTicksPerMilli.
+    static const uint8 kScale = 40;
+    const uint32 window_millis = windowMillis(now_millis);
+    if (window_millis < kScale) {
+      return 0;
+    }
+    if (stats.total_ticks < 0xffffffffUL / kScale) {
+      return (stats.total_ticks * kScale) / window_millis;
+    }
+    return stats.total_ticks / (window_millis / kScale);
+  }
+}  // namespace isr_profiler
@@ -0,0 +1,99 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ISR_PROFILER_H
+#define ISR_PROFILER_H
+
+#include <arduino.h>
+#include "avr_util.h"
+#include "custom_defs.h"
+#include "hardware_clock.h"
+
+// Run time of the LIN decoder ISRs by decoder state, measured on the target
+// with Timer1 at ISR entry and exit. The resolution is one hardware clock
+// tick (64 cycles), the totals and averages are unbiased over many calls but
+// a max may be one tick off. The ISR prologue and epilogue are not counted.
+//
+// With LIN_ISR_PROFILER 0 (see custom_defs.h) start() and stop() compile to
+// nothing.
+namespace isr_profiler {
+  // What an ISR call handled. Like enum but 8 bits only.
+  namespace slots {
+    // Bit ticks and RX edges while looking for a break.
+    static const uint8 DETECT_BREAK = 0;
+    // RX edges of the start bits, where the decoder used to busy wait for
+    // RX low.
+    static const uint8 RX_EDGE = 1;
+    // Bit ticks timing the space before a start bit.
+    static const uint8 SPACE = 2;
+    static const uint8 START_BIT = 3;
+    static const uint8 DATA_BIT = 4;
+    static const uint8 STOP_BIT = 5;
+    // LIN_DECODER_CAPTURE edge timestamps.
+    static const uint8 CAPTURE = 6;
+  }
+  static const uint8 kNumSlots = 7;
+
+  struct SlotStats {
+    uint32 calls;
+    uint32 total_ticks;
+    uint8 max_ticks;
+  };
+
+  // Private data. Do not use from other modules.
+  namespace isr_profiler_private {
+    extern SlotStats slot_stats[kNumSlots];
+  }
+
+  // Call at ISR entry. Pass the result to stop().
+  static inline uint16 start() {
+#if LIN_ISR_PROFILER
+    return hardware_clock::ticksForIsr();
+#else
+    return 0;
+#endif
+  }
+
+  // Call at ISR exit.
+  static inline void stop(uint8 slot, uint16 start_ticks) {
+#if LIN_ISR_PROFILER
+    const uint16 ticks = hardware_clock::ticksForIsr() - start_ticks;
+    SlotStats& stats = isr_profiler_private::slot_stats[slot];
+    stats.calls++;
+    stats.total_ticks += ticks;
+    if (ticks > stats.max_ticks) {
+      stats.max_ticks = ticks > 0xff ? 0xff : ticks;
+    }
+#else
+    (void)slot;
+    (void)start_ticks;
+#endif
+  }
+
+  // PROGMEM name of a slot, e.g. "DATA_BIT".
+  extern const __FlashStringHelper* slotName(uint8 slot);
+
+  // Copies the stats of a slot, from main. Interrupts are disabled briefly.
+  extern void get(uint8 slot, SlotStats* stats);
+
+  // Clears the stats and starts a new window, from main.
+  extern void reset(uint32 now_millis);
+
+  // Millis since the last reset().
+  extern uint32 windowMillis(uint32 now_millis);
+
+  // Share of the CPU time since the last reset() spent in the slot, in
+  // 1/100 percent.
+  extern uint16 cpuPercentX100(const SlotStats& stats, uint32 now_millis);
+}  // namespace isr_profiler
+
+#endif
@@ -0,0 +1,103 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lin_checksum.h"
+
+#include "custom_defs.h"
+
+namespace lin_checksum {
+  // Number of 6 bit frame ids.
+  static const uint8 kMaxIds = 64;
+
+  // Diagnostic master request and slave response ids. Always classic.
+  static const uint8 kMasterRequestId = 0x3c;
+  static const uint8 kSlaveResponseId = 0x3d;
+
+  // Two bits per id, four ids per byte. Learned models and consecutive
+  // checksum misses of the learned model.
+  static uint8 model_bits[kMaxIds / 4];
+  static uint8 miss_bits[kMaxIds / 4];
+
+  static inline uint8 get2(const uint8* table, uint8 id) {
+    return (table[id >> 2] >> ((id & 0x03) << 1)) & 0x03;
+  }
+
+  static inline void set2(uint8* table, uint8 id, uint8 value) {
+    const uint8 shift = (id & 0x03) << 1;
+    table[id >> 2] = (table[id >> 2] & ~(0x03 << shift)) | (value << shift);
+  }
+
+  static inline uint8 checksumFlag(uint8 model) {
+    return model == models::CLASSIC ? LinFrame::kClassicChecksumOk
+        : LinFrame::kEnhancedChecksumOk;
+  }
+
+  void reset() {
+    for (uint8 i = 0; i < ARRAY_SIZE(model_bits); i++) {
+      model_bits[i] = 0;
+      miss_bits[i] = 0;
+    }
+  }
+
+  uint8 model(uint8 id) {
+    id &= (kMaxIds - 1);
+    if (id == kMasterRequestId || id == kSlaveResponseId) {
+      return models::CLASSIC;
+    }
+    if (!custom_defs::kAutoDetectLinChecksum) {
+      return custom_defs::kUseLinChecksumVersion2 ? models::ENHANCED : models::CLASSIC;
+    }
+    return get2(model_bits, id);
+  }
+
+  void validate(LinFrame* frame) {
+    const uint8 id = frame->get_byte(0) & (kMaxIds - 1);
+    const uint8 known_model = model(id);
+
+    // Known model. Check only its checksum.
+    if (known_model != models::UNKNOWN) {
+      const uint8 checksum = checksumFlag(known_model);
+      frame->updateFlags(checksum);
+      if (!custom_defs::kAutoDetectLinChecksum || frame->num_bytes() == 1 ||
+          !(frame->flags() & LinFrame::kIdParityOk)) {
+        return;
+      }
+      if (frame->flags() & checksum) {
+        set2(miss_bits, id, 0);
+        return;
+      }
+      // Repeated misses, maybe a different node or protocol version now.
+      const uint8 misses = get2(miss_bits, id) + 1;
+      if (misses >= kMaxChecksumMisses) {
+        set2(model_bits, id, models::UNKNOWN);
+        set2(miss_bits, id, 0);
+      } else {
+        set2(miss_bits, id, misses);
+      }
+      return;
+    }
+
+    // Unknown model. Either checksum will do and a single match teaches us
+    // the model. Corrupted ids or frames without a response teach nothing.
+    const uint8 both = LinFrame::kClassicChecksumOk | LinFrame::kEnhancedChecksumOk;
+    frame->updateFlags(both);
+    if (!frame->isValid() || frame->num_bytes() == 1) {
+      return;
+    }
+    const uint8 matches = frame->flags() & both;
+    if (matches == LinFrame::kClassicChecksumOk) {
+      set2(model_bits, id, models::CLASSIC);
+    } else if (matches == LinFrame::kEnhancedChecksumOk) {
+      set2(model_bits, id, models::ENHANCED);
+    }
+  }
+}  // namespace lin_checksum
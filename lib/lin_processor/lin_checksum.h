@@ -0,0 +1,51 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIN_CHECKSUM_H
+#define LIN_CHECKSUM_H
+
+#include "avr_util.h"
+#include "lin_frame.h"
+
+// Per frame id LIN checksum model (classic V1 or enhanced V2). LIN 1.x and
+// 2.x frames can share a bus and the diagnostic frames (0x3c, 0x3d) are
+// always classic.
+//
+// With custom_defs::kAutoDetectLinChecksum the model of each id is learned
+// from its first frame that matches exactly one of the two checksums and is
+// then the only one checked. After kMaxChecksumMisses consecutive frames
+// that fail it the id is learned again. Otherwise the model is
+// custom_defs::kUseLinChecksumVersion2 for all non diagnostic ids.
+//
+// Called from the LIN decoder only (the ISR with LIN_DECODER_TIMER2).
+namespace lin_checksum {
+  // Values of model().
+  namespace models {
+    static const uint8 UNKNOWN = 0;
+    static const uint8 CLASSIC = 1;
+    static const uint8 ENHANCED = 2;
+  }
+
+  static const uint8 kMaxChecksumMisses = 3;
+
+  // Forget the learned models.
+  extern void reset();
+
+  // Model of the given 6 bit frame id.
+  extern uint8 model(uint8 id);
+
+  // Sets the flags of a complete frame, including kValid, checking only the
+  // checksum of the id's model. Learns the model if not known yet.
+  extern void validate(LinFrame* frame);
+}  // namespace lin_checksum
+
+#endif
@@ -14,7 +14,19 @@
 
 #include "custom_defs.h"
 
-// Compute the checksum of the frame. For now using LIN checksum V2 only.
+const uint8 LinFrame::kProtectedIds[64] PROGMEM = {
+  0x80, 0xc1, 0x42, 0x03, 0xc4, 0x85, 0x06, 0x47,
+  0x08, 0x49, 0xca, 0x8b, 0x4c, 0x0d, 0x8e, 0xcf,
+  0x50, 0x11, 0x92, 0xd3, 0x14, 0x55, 0xd6, 0x97,
+  0xd8, 0x99, 0x1a, 0x5b, 0x9c, 0xdd, 0x5e, 0x1f,
+  0x20, 0x61, 0xe2, 0xa3, 0x64, 0x25, 0xa6, 0xe7,
+  0xa8, 0xe9, 0x6a, 0x2b, 0xec, 0xad, 0x2e, 0x6f,
+  0xf0, 0xb1, 0x32, 0x73, 0xb4, 0xf5, 0x76, 0x37,
+  0x78, 0x39, 0xba, 0xfb, 0x3c, 0x7d, 0xfe, 0xbf,
+};
+
+// Compute the checksum of the frame, of the configured LIN version. Loops
+// over the bytes. The decoders use lin_checksum::validate() instead.
 uint8 LinFrame::computeChecksum() const {
   // LIN V2 checksum includes the ID byte, V1 does not.
   const uint8 startByteIndex = custom_defs::kUseLinChecksumVersion2 ? 0 : 1;
@@ -76,32 +88,43 @@ uint8 LinFrame::setLinIdChecksumBits(uint8 id) {
   return (p1_at_b7 & 0b10000000) | (p0_at_b6 & 0b01000000) | (id & 0b00111111);
 }
 
-boolean LinFrame::isValid() const {
+void LinFrame::updateFlags(uint8 checksums) {
   const uint8 n = num_bytes_;
-
-  // Check frame size.
-  // One ID byte with optional 1-8 data bytes and 1 checksum byte.
-  // TODO: should we enforce only 1, 2, 4, or 8 data bytes?  (total size 
-  // 1, 3, 4, 6, or 10)
-  //
-  // TODO: should we pass through frames with ID only (n == 1, no response from slave).
-  if (n != 1 && (n < 3 || n > 10)) {
-    return false;
+  uint8 flags = 0;
+  if (!n) {
+    flags_ = 0;
+    return;
   }
 
   // Check ID byte checksum bits.
   const uint8 id_byte = bytes_[0];
-  if (id_byte != setLinIdChecksumBits(id_byte)) {
-    return false;
+  if (id_byte == protectedId(id_byte)) {
+    flags = kIdParityOk;
+  }
+
+  // An ID only frame (no response from slave) is valid with a good id.
+  if (n == 1) {
+    flags_ = flags ? (flags | kValid) : 0;
+    return;
+  }
+
+  // Check also the overall checksum. The enhanced one adds the id to the
+  // data sum.
+  const uint8 checksum = bytes_[n - 1];
+  if ((checksums & kClassicChecksumOk) && checksum == (uint8)~sum_before_last_) {
+    flags |= kClassicChecksumOk;
+  }
+  if ((checksums & kEnhancedChecksumOk) &&
+      checksum == (uint8)~addWithCarry(sum_before_last_, id_byte)) {
+    flags |= kEnhancedChecksumOk;
   }
 
-  // If not an ID only frame, check also the overall checksum.
-  if (n > 1) {
-    if (bytes_[n - 1] != computeChecksum()) {
-      return false;
-    }  
+  // One ID byte, 1-8 data bytes and 1 checksum byte.
+  // TODO: should we enforce only 1, 2, 4, or 8 data bytes?  (total size
+  // 3, 4, 6, or 10)
+  if (n >= 3 && n <= kMaxBytes && (flags & kIdParityOk) && (flags & checksums)) {
+    flags |= kValid;
   }
-  // TODO: check protected id.
-  return true;
+  flags_ = flags;
 }
 
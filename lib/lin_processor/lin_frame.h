@@ -29,11 +29,41 @@ public:
   // Number of bytes in the longest frame. One ID byte, 8 data bytes, one checksum byte.
   static const uint8 kMaxBytes = 1 + 8 + 1;
 
+  // Bits of flags().
+  // Size, id parity and the checksum of the id's LIN version are ok.
+  static const uint8 kValid = (1 << 0);
+  static const uint8 kIdParityOk = (1 << 1);
+  // The last byte matches the classic (V1, data only) checksum.
+  static const uint8 kClassicChecksumOk = (1 << 2);
+  // The last byte matches the enhanced (V2, id and data) checksum.
+  static const uint8 kEnhancedChecksumOk = (1 << 3);
+
   // Compute the to checkum bits [P1,P0] of the lin id in bits [5:0] and return
   // [P1,P0][5:0] which is the wire representation of this id.
   static uint8 setLinIdChecksumBits(uint8 id);
-  
-  boolean isValid() const;
+
+  // Same as setLinIdChecksumBits() using a lookup table.
+  static inline uint8 protectedId(uint8 id) {
+    return pgm_read_byte(&kProtectedIds[id & 0x3f]);
+  }
+
+  // Sets the flags() from the bytes appended so far, checking the checksums
+  // in the given kClassicChecksumOk | kEnhancedChecksumOk mask. kValid if
+  // the size and the id parity are ok and, unless this is an id only frame,
+  // any of those checksums. Called once by the decoder when the frame is
+  // complete, see lin_checksum.h. Constant time, the checksums are
+  // accumulated by append_byte().
+  void updateFlags(uint8 checksums);
+
+  // Validation result bits, as of the last updateFlags().
+  inline uint8 flags() const {
+    return flags_;
+  }
+
+  // As of the last updateFlags().
+  inline boolean isValid() const {
+    return flags_ & kValid;
+  }
   
   // Compute LIN frame checksum. Assuming buffer has at least one byte. A valid 
   // frame should contain one byte for id, 1-8 bytes for data, one byte for checksum.
@@ -41,6 +71,9 @@ public:
 
   inline void reset() {
     num_bytes_ = 0;
+    sum_ = 0;
+    sum_before_last_ = 0;
+    flags_ = 0;
   }
 
   inline uint8 num_bytes() const {
@@ -56,17 +89,53 @@ public:
     return bytes_[index];
   }
   
+  // hardware_clock ticks at the end of the frame, set by the decoder when
+  // the frame is complete. Wraps every ~262ms.
+  inline uint16 timestamp() const {
+    return timestamp_;
+  }
+
+  inline void set_timestamp(uint16 ticks) {
+    timestamp_ = ticks;
+  }
+
   // Caller should check that num_bytes < kMaxBytes;
   inline void append_byte(uint8 value) {
+    // Data checksum so far. The id is not included and the last byte, the
+    // checksum itself, is excluded later by using sum_before_last_.
+    if (num_bytes_) {
+      sum_before_last_ = sum_;
+      sum_ = addWithCarry(sum_, value);
+    }
     bytes_[num_bytes_++] = value;
   }
   
   // TODO: make this stuff private without sacrifying performance.
   
 private:
+  // LIN checksum addition, 8 bits with the carry added back.
+  static inline uint8 addWithCarry(uint8 a, uint8 b) {
+    const uint16 sum = (uint16)a + b;
+    return (uint8)sum + (uint8)(sum >> 8);
+  }
+
+  // Indexed by the 6 bit id.
+  static const uint8 kProtectedIds[64] PROGMEM;
+
   // Number of bytes in bytes_ buffer. At most kMaxBytes.
   uint8 num_bytes_;
 
+  // Sum with carry of bytes_[1..num_bytes_ - 1] and of
+  // bytes_[1..num_bytes_ - 2].
+  uint8 sum_;
+  uint8 sum_before_last_;
+
+  // See kValid and friends.
+  uint8 flags_;
+
+  // See timestamp().
+  uint16 timestamp_;
+
   // Recieved frame bytes. Includes id, data and checksum. Does not 
   // include the 0x55 sync byte.
   uint8 bytes_[kMaxBytes];
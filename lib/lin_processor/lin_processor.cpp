@@ -17,6 +17,11 @@
 #include "avr_util.h"
 #include "custom_defs.h"
 #include "hardware_clock.h"
+#include "isr_latency.h"
+#include "isr_profiler.h"
+#include "lin_checksum.h"
+#include "lin_stats.h"
+#include "lin_trace.h"
 
 // TODO: for debugging. Remove.
 #include "sio.h"
@@ -34,6 +39,10 @@ static const uint16 kDefaultBaud = 9600;
 //
 static const uint8 kMaxSpaceBits = 8;
 
+// A low period of at least this number of bits is taken as a break. The
+// LIN master sends at least 13.
+static const uint8 kMinBreakBits = 10;
+
 // Define an input pin with fast access. Using the macro does
 // not increase the pin access time compared to direct bit manipulation.
 // Pin is setup with active pullup.
@@ -79,8 +88,7 @@ namespace lin_processor {
       // If baud rate out of range use default speed.
       uint16 baud = custom_defs::kLinSpeed;
       if (baud < 1000 || baud > 20000) {
-        // sio::println(F("ERROR: kLinSpeed out of range"));
-        Serial.println(F("ERROR: kLinSpeed out of range"));
+        sio::println(F("ERROR: kLinSpeed out of range"));
         baud = kDefaultBaud;
       }
       baud_ = baud;
@@ -91,7 +99,10 @@ namespace lin_processor {
       counts_per_half_bit_ = (counts_per_bit_ / 2) + 2;
       clock_ticks_per_bit_ = (hardware_clock::kTicksPerMilli * 1000) / baud;
       clock_ticks_per_half_bit_ = clock_ticks_per_bit_ / 2;
-      clock_ticks_per_until_start_bit_ = clock_ticks_per_bit_ * kMaxSpaceBits;
+      clock_ticks_per_break_ = clock_ticks_per_bit_ * kMinBreakBits;
+      clock_ticks_per_bit_x256_ = (hardware_clock::kTicksPerMilli * 1000 * 256) / baud;
+      clock_ticks_per_byte_ = (clock_ticks_per_bit_x256_ * 10L) >> 8;
+      clock_ticks_per_max_space_ = (clock_ticks_per_bit_x256_ * (uint32)kMaxSpaceBits) >> 8;
     }
 
     inline uint16 baud() const {
@@ -114,8 +125,20 @@ namespace lin_processor {
     inline uint8 clock_ticks_per_half_bit() const {
       return clock_ticks_per_half_bit_;
     }
-    inline uint8 clock_ticks_per_until_start_bit() const {
-      return clock_ticks_per_until_start_bit_;
+    inline uint16 clock_ticks_per_break() const {
+      return clock_ticks_per_break_;
+    }
+    // Fixed point, 8 fraction bits. The integer clock_ticks_per_bit() is
+    // too coarse to time the bits of a whole byte from its start bit.
+    inline uint16 clock_ticks_per_bit_x256() const {
+      return clock_ticks_per_bit_x256_;
+    }
+    // Start, 8 data and stop bits.
+    inline uint16 clock_ticks_per_byte() const {
+      return clock_ticks_per_byte_;
+    }
+    inline uint16 clock_ticks_per_max_space() const {
+      return clock_ticks_per_max_space_;
     }
    private:
     uint16 baud_;
@@ -127,7 +150,10 @@ namespace lin_processor {
     uint8 counts_per_half_bit_;
     uint8 clock_ticks_per_bit_;
     uint8 clock_ticks_per_half_bit_;
-    uint8 clock_ticks_per_until_start_bit_;
+    uint16 clock_ticks_per_break_;
+    uint16 clock_ticks_per_bit_x256_;
+    uint16 clock_ticks_per_byte_;
+    uint16 clock_ticks_per_max_space_;
   };
 
   // The actual configurtion. Initialized in setup() based on baud rate.
@@ -139,7 +165,12 @@ namespace lin_processor {
   // This way we shave a few cycles from the ISR.
 
   // LIN interface.
+#if LIN_DECODER == LIN_DECODER_CAPTURE
+  // ICP1. Read by the Timer1 input capture, not by the code.
+  DEFINE_INPUT_PIN(rx_pin, B, 0);
+#else
   DEFINE_INPUT_PIN(rx_pin, D, 2);
+#endif
   // TODO: Not use, as of Apr 2014.
   DEFINE_OUTPUT_PIN(tx1_pin, C, 2, 1);
 
@@ -161,21 +192,26 @@ namespace lin_processor {
   }
 
   // ----- ISR RX Ring Buffers -----
+  //
+  // Single producer (the decoder), single consumer (main) queue. Each side
+  // writes only its own index, a single byte and thus atomic, so neither
+  // side needs to disable interrupts.
 
-  // Frame buffer queue size.
+  // Frame buffer queue size. Up to kMaxFrameBuffers - 1 frames are queued,
+  // the head buffer is the one being decoded.
   static const uint8 kMaxFrameBuffers = 8;
 
-  // RX Frame buffers queue. Read/Writen by ISR only.
+  // RX Frame buffers queue.
   static LinFrame rx_frame_buffers[kMaxFrameBuffers];
 
   // Index [0, kMaxFrameBuffers) of the current frame buffer being
-  // written (newest). Read/Written by ISR only.
-  static uint8  head_frame_buffer;
+  // written (newest). Written by the decoder only.
+  static volatile uint8 head_frame_buffer;
 
   // Index [0, kMaxFrameBuffers) of the next frame to be read (oldest).
   // If equals head_frame_buffer then there is no available frame.
-  // Read/Written by ISR only.
-  static uint8 tail_frame_buffer;
+  // Written by main only.
+  static volatile uint8 tail_frame_buffer;
 
   // Called once from main.
   static inline void setupBuffers() {
@@ -183,53 +219,186 @@ namespace lin_processor {
     tail_frame_buffer = 0;
   }
 
-  // Called from ISR or from main with interrupts disabled.
-  static inline void incrementTailFrameBuffer() {
-    if (++tail_frame_buffer >= kMaxFrameBuffers) {
-      tail_frame_buffer = 0;
+  static inline uint8 nextFrameBuffer(uint8 index) {
+    return (index + 1 >= kMaxFrameBuffers) ? 0 : index + 1;
+  }
+
+  // Forward declaration, see Error Flag below.
+  static inline void setErrorFlags(uint8 flags);
+
+  // Called by the decoder when the head frame is complete. end_ticks is the
+  // hardware clock time of the end of the frame.
+  static inline void commitHeadFrameBuffer(uint16 end_ticks) {
+    // Stamp the id parity and checksum verdicts. Constant time, the
+    // checksums were summed as the bytes arrived.
+    lin_checksum::validate(&rx_frame_buffers[head_frame_buffer]);
+    rx_frame_buffers[head_frame_buffer].set_timestamp(end_ticks);
+    const uint8 next = nextFrameBuffer(head_frame_buffer);
+    if (next == tail_frame_buffer) {
+      // Frame buffer overrun. The queued frames belong to main so we drop
+      // this one. Its buffer is reset when the next frame starts.
+      setErrorFlags(errors::BUFFER_OVERRUN);
+      return;
     }
+    // Frame bytes first, then the index that hands them over.
+    MEMORY_BARRIER();
+    head_frame_buffer = next;
   }
 
-  // Called from ISR. If stepping on tail buffer, caller needs to
-  // increment raise frame overrun error.
-  static inline void incrementHeadFrameBuffer() {
-    if (++head_frame_buffer >= kMaxFrameBuffers) {
-      head_frame_buffer = 0;
+  // ----- Frame Id Filter -----
+
+  // Number of 6 bit frame ids.
+  static const uint8 kMaxIds = 64;
+
+  // Bit per frame id, set for the ids whose frames are queued. Read by the
+  // decoder, written by main during setup.
+  static uint8 accepted_ids[kMaxIds / 8];
+
+  // Indexed by frame id. Main only.
+  static FrameHandler frame_handlers[kMaxIds];
+
+  // Until the first subscribe() all ids are accepted.
+  static boolean any_subscribed;
+
+  // Called once from main.
+  static inline void setupFilter() {
+    if (!any_subscribed) {
+      memset(accepted_ids, 0xff, sizeof(accepted_ids));
     }
   }
 
-  // ----- ISR To Main Data Transfer -----
+  // Called by the decoder with the protected id byte of a frame. All ids
+  // with LIN_TRACE.
+  static inline boolean isIdAccepted(uint8 protected_id) {
+    if (LIN_TRACE) {
+      return true;
+    }
+    const uint8 id = protected_id & (kMaxIds - 1);
+    return accepted_ids[id >> 3] & bitMask(id & 0x07);
+  }
 
-  // Increment by the ISR to indicates to the main program when the ISR returned.
-  // This is used to defered disabling interrupts until the ISR completes to
-  // reduce ISR jitter time.
-  static volatile uint8 isr_marker;
+  // Public. Called from main. See .h for description.
+  void subscribe(uint8 id, FrameHandler handler) {
+    id &= (kMaxIds - 1);
+    if (!any_subscribed) {
+      memset(accepted_ids, 0, sizeof(accepted_ids));
+      any_subscribed = true;
+    }
+    frame_handlers[id] = handler;
+    accepted_ids[id >> 3] |= bitMask(id & 0x07);
+  }
 
-  // Should be called from main only.
-  static inline void waitForIsrEnd() {
-    const uint8 value = isr_marker;
-    // Wait until the next ISR ends.
-    while (value == isr_marker) {
+#if LIN_DECODER == LIN_DECODER_CAPTURE
+  // Decodes the captured RX edges into frames. See Input Capture Decoder
+  // below.
+  static void decodeCapturedEdges();
+#endif
+
+  // Public. Called from main. See .h for description.
+  const LinFrame* peekFrame() {
+#if LIN_DECODER == LIN_DECODER_CAPTURE
+    decodeCapturedEdges();
+#endif
+    const uint8 tail = tail_frame_buffer;
+    if (tail == head_frame_buffer) {
+      return NULL;
     }
+    // Index first, then the frame bytes.
+    MEMORY_BARRIER();
+    return &rx_frame_buffers[tail];
+  }
+
+  // Public. Called from main. See .h for description.
+  void releaseFrame() {
+    // Done with the frame bytes before the buffer is handed back.
+    MEMORY_BARRIER();
+    tail_frame_buffer = nextFrameBuffer(tail_frame_buffer);
   }
 
   // Public. Called from main. See .h for description.
   boolean readNextFrame(LinFrame* buffer) {
-    boolean result = false;
-    waitForIsrEnd();
-    cli();
-    if (tail_frame_buffer != head_frame_buffer) {
-      //led::setHigh();
-      // This copies the request buffer struct.
-      *buffer = rx_frame_buffers[tail_frame_buffer];
-      incrementTailFrameBuffer();
-      result = true;
-      //led::setLow();
+    const LinFrame* const frame = peekFrame();
+    if (!frame) {
+      return false;
     }
-    sei();
-    return result;
+    // This copies the request buffer struct.
+    *buffer = *frame;
+    releaseFrame();
+    return true;
   }
 
+#if LIN_BUS_STATS || LIN_TRACE
+  // Forward declaration, see Error Flag below.
+  static void dispatchErrorEvents();
+#endif
+
+#if LIN_BUS_STATS
+  // Frames dropped after their id, for lin_stats. Single producer (the
+  // decoder), single consumer (dispatchFrames()) queue, like the frames.
+  struct HeaderEvent {
+    uint8 id;
+    uint16 end_ticks;
+  };
+  static const uint8 kMaxHeaderEvents = 8;
+  static HeaderEvent header_events[kMaxHeaderEvents];
+  static volatile uint8 header_events_head;
+  static volatile uint8 header_events_tail;
+
+  // Called by the decoder when it drops a frame after the id byte, which
+  // ended at end_ticks. Lost if the queue is full.
+  static inline void queueHeaderEvent(uint8 protected_id, uint16 end_ticks) {
+    const uint8 head = header_events_head;
+    const uint8 next = (head + 1) & (kMaxHeaderEvents - 1);
+    if (next == header_events_tail) {
+      return;
+    }
+    header_events[head].id = protected_id & (kMaxIds - 1);
+    header_events[head].end_ticks = end_ticks;
+    MEMORY_BARRIER();
+    header_events_head = next;
+  }
+
+  static void dispatchHeaderEvents() {
+    uint8 tail = header_events_tail;
+    while (tail != header_events_head) {
+      MEMORY_BARRIER();
+      lin_stats::onHeader(header_events[tail].id, header_events[tail].end_ticks);
+      tail = (tail + 1) & (kMaxHeaderEvents - 1);
+      MEMORY_BARRIER();
+      header_events_tail = tail;
+    }
+  }
+#endif
+
+  // Public. Called from main. See .h for description.
+  uint8 dispatchFrames() {
+#if LIN_BUS_STATS || LIN_TRACE
+    dispatchErrorEvents();
+#endif
+#if LIN_BUS_STATS
+    dispatchHeaderEvents();
+#endif
+    uint8 count = 0;
+    const LinFrame* frame;
+    while ((frame = peekFrame()) != NULL) {
+#if LIN_BUS_STATS
+      lin_stats::onFrame(*frame);
+#endif
+#if LIN_TRACE
+      lin_trace::onFrame(*frame);
+#endif
+      const FrameHandler handler = frame_handlers[frame->get_byte(0) & (kMaxIds - 1)];
+      if (handler) {
+        handler(*frame);
+        count++;
+      }
+      releaseFrame();
+    }
+    return count;
+  }
+
+#if LIN_DECODER == LIN_DECODER_TIMER2
+
   // ----- State Machine Declaration -----
 
   // Like enum but 8 bits only.
@@ -242,19 +411,45 @@ namespace lin_processor {
   class StateDetectBreak {
    public:
     static inline void enter() ;
+    // Bit tick handler. Used when not custom_defs::kUseEdgeBreakDetection.
     static inline void handleIsr();
+    // RX edge handler. Used when custom_defs::kUseEdgeBreakDetection.
+    static inline void handleEdgeIsr();
 
    private:
     static uint8 low_bits_counter_;
+
+    // Hardware clock ticks at the last high to low RX transition. Valid
+    // only if has_low_start_ is true.
+    static uint16 low_start_ticks_;
+    static boolean has_low_start_;
   };
 
   class StateReadData {
    public:
     // Should be called after the break stop bit was detected.
     static inline void enter();
+    // Bit tick handler.
     static inline void handleIsr();
+    // RX edge handler. Enabled only while waiting for a start bit.
+    static inline void handleEdgeIsr();
+    // The isr_profiler slot of the next bit tick.
+    static inline uint8 tickProfilerSlot();
 
    private:
+    // Arm the RX edge interrupt to catch the start bit of the next byte.
+    static inline void waitForStartBit();
+
+    // Called when no start bit arrived within kMaxSpaceBits.
+    static inline void handleEndOfFrame();
+
+    // True between the end of a byte (or of the break) and the start bit of
+    // the next byte. The bit ticks then only count the space bits.
+    static boolean waiting_for_start_bit_;
+
+    // Number of bit ticks while waiting_for_start_bit_.
+    static uint8 space_bits_;
+
     // Number of complete bytes read so far. Includes all bytes, even
     // sync, id and checksum.
     static uint8 bytes_read_;
@@ -272,16 +467,65 @@ namespace lin_processor {
     static uint8 byte_buffer_bit_mask_;
   };
 
+#endif  // LIN_DECODER_TIMER2
+
   // ----- Error Flag. -----
 
   // Written from ISR. Read/Write from main. Bit mask of pending errors.
   static volatile uint8 error_flags;
 
+#if LIN_BUS_STATS || LIN_TRACE
+  // Errors with the id of their frame, for lin_stats and lin_trace. Single
+  // producer (the decoder), single consumer (dispatchFrames()) queue, like
+  // the frames.
+  struct ErrorEvent {
+    uint8 id;
+    uint8 flags;
+  };
+  static const uint8 kMaxErrorEvents = 4;
+  static ErrorEvent error_events[kMaxErrorEvents];
+  static volatile uint8 error_events_head;
+  static volatile uint8 error_events_tail;
+
+  static inline void queueErrorEvent(uint8 flags) {
+    const uint8 head = error_events_head;
+    const uint8 next = (head + 1) & (kMaxErrorEvents - 1);
+    if (next == error_events_tail) {
+      return;
+    }
+    const LinFrame& frame = rx_frame_buffers[head_frame_buffer];
+    error_events[head].id = frame.num_bytes() ? frame.get_byte(0) & (kMaxIds - 1)
+        : lin_stats::kNoId;
+    error_events[head].flags = flags;
+    MEMORY_BARRIER();
+    error_events_head = next;
+  }
+
+  static void dispatchErrorEvents() {
+    uint8 tail = error_events_tail;
+    while (tail != error_events_head) {
+      MEMORY_BARRIER();
+#if LIN_BUS_STATS
+      lin_stats::onError(error_events[tail].id, error_events[tail].flags);
+#endif
+#if LIN_TRACE
+      lin_trace::onError(error_events[tail].id, error_events[tail].flags);
+#endif
+      tail = (tail + 1) & (kMaxErrorEvents - 1);
+      MEMORY_BARRIER();
+      error_events_tail = tail;
+    }
+  }
+#endif
+
   // Private. Called from ISR and from setup (beofe starting the ISR).
   static inline void setErrorFlags(uint8 flags) {
     error_pin::setHigh();
     // Non atomic when called from setup() but should be fine since ISR is not running yet.
     error_flags |= flags;
+#if LIN_BUS_STATS || LIN_TRACE
+    queueErrorEvent(flags);
+#endif
     error_pin::setLow();
   }
 
@@ -293,6 +537,7 @@ namespace lin_processor {
     cli();
     const uint8 result = error_flags;
     error_flags = 0;
+    isr_latency::endSection(isr_latency::sections::ERROR_FLAGS);
     sei();
     return result;
   }
@@ -312,6 +557,11 @@ namespace lin_processor {
     { errors::OTHER, "OTHR" },
   };
 
+  // Public. Called from main. See .h for description.
+  const char* errorBitName(uint8 bit_index) {
+    return (const char*)pgm_read_word(&kErrorBitNames[bit_index].name);
+  }
+
   // Given a byte with lin processor error bitset, print the list
   // of set errors.
   void printErrorFlags(uint8 lin_errors) {
@@ -321,12 +571,10 @@ namespace lin_processor {
       const uint8 mask = pgm_read_byte(&kErrorBitNames[i].mask);
       if (lin_errors & mask) {
         if (any_printed) {
-          // sio::printchar(' ');
-          Serial.print(' ');
+          sio::printchar(' ');
         }
         const char* const name = (const char*)pgm_read_word(&kErrorBitNames[i].name);
-        // sio::print(name);
-        Serial.print(name);
+        sio::print(name);
         any_printed = true;
       }
     }
@@ -334,6 +582,34 @@ namespace lin_processor {
 
   // ----- Initialization -----
 
+#if LIN_DECODER == LIN_DECODER_TIMER2
+
+  // Enable the Timer2 bit ticks interrupt, dropping any pending tick.
+  static inline void enableTickInterrupt() {
+    TIFR2 = H(OCF2A);
+    TIMSK2 = L(OCIE2B) | H(OCIE2A) | L(TOIE2);
+  }
+
+  static inline void disableTickInterrupt() {
+    TIMSK2 = L(OCIE2B) | L(OCIE2A) | L(TOIE2);
+  }
+
+  // Enable the RX (INT0) edge interrupt, dropping any pending edge.
+  static inline void enableEdgeInterrupt() {
+    EIFR = H(INTF0);
+    EIMSK |= H(INT0);
+  }
+
+  static inline void disableEdgeInterrupt() {
+    EIMSK &= ~H(INT0);
+  }
+
+  static void setupEdgeInterrupt() {
+    // INT0 on any logical change of PD2. Enabled only while detecting a break.
+    EICRA = (EICRA & ~(H(ISC01) | H(ISC00))) | L(ISC01) | H(ISC00);
+    disableEdgeInterrupt();
+  }
+
   static void setupTimer() {
     // OC2B cycle pulse (Arduino digital pin 3, PD3). For debugging.
     DDRD |= H(DDD3);
@@ -357,19 +633,38 @@ namespace lin_processor {
     TIFR2 = L(OCF2B) | H(OCF2A) | L(TOV2);
   }
 
-  // Call once from main at the begining of the program.
+#else  // LIN_DECODER_CAPTURE
+
+  static void setupCapture();
+
+#endif
+
+  // Call once from main at the begining of the program, after
+  // hardware_clock::setup().
   void setup() {
     // Should be done first since some of the steps below depends on it.
     config.setup();
 
     setupPins();
     setupBuffers();
-    StateDetectBreak::enter();
+    setupFilter();
+    lin_checksum::reset();
+#if LIN_DECODER == LIN_DECODER_TIMER2
     setupTimer();
+#if LIN_ISR_LATENCY
+    isr_latency::setup(config.prescaler_x64() ? 64 : 8);
+#endif
+    setupEdgeInterrupt();
+    StateDetectBreak::enter();
+#else
+    setupCapture();
+#endif
     error_flags = 0;
 
   }
 
+#if LIN_DECODER == LIN_DECODER_TIMER2
+
   // ----- ISR Utility Functions -----
 
   // Set timer value to zero.
@@ -388,55 +683,25 @@ namespace lin_processor {
     TCNT2 = config.counts_per_half_bit();
   }
 
-  // Perform a tight busy loop until RX is low or the given number
-  // of clock ticks passed (timeout). Retuns true if ok,
-  // false if timeout. Keeps timer reset during the wait.
-  // Called from ISR only.
-  static inline boolean waitForRxLow(uint16 max_clock_ticks) {
-    const uint16 base_clock = hardware_clock::ticksForIsr();
-    for(;;) {
-      // Keep the tick timer not ticking (no ISR).
-      resetTickTimer();
-
-      // If rx is low we are done.
-      if (!rx_pin::isHigh()) {
-        return true;
-      }
-
-      // Test for timeout.
-      // Should work also in case of 16 bit clock overflow.
-      const uint16 clock_diff = hardware_clock::ticksForIsr() - base_clock;
-      if (clock_diff >= max_clock_ticks) {
-        return false;
-      }
-    }
-  }
-
-  // Same as waitForRxLow but with reversed polarity.
-  // We clone to code for time optimization.
-  // Called from ISR only.
-  static inline boolean waitForRxHigh(uint16 max_clock_ticks) {
-    const uint16 base_clock = hardware_clock::ticksForIsr();
-    for(;;) {
-      resetTickTimer();
-      if (rx_pin::isHigh()) {
-        return true;
-      }
-      // Should work also in case of an clock overflow.
-      const uint16 clock_diff = hardware_clock::ticksForIsr() - base_clock;
-      if (clock_diff >= max_clock_ticks) {
-        return false;
-      }
-    }
-  }
-
   // ----- Detect-Break State Implementation -----
 
   uint8 StateDetectBreak::low_bits_counter_;
+  uint16 StateDetectBreak::low_start_ticks_;
+  boolean StateDetectBreak::has_low_start_;
 
   inline void StateDetectBreak::enter() {
     state = states::DETECT_BREAK;
     low_bits_counter_ = 0;
+    // If RX is already low we missed its falling edge and can't time this
+    // low period. Wait for the next one.
+    has_low_start_ = false;
+    if (custom_defs::kUseEdgeBreakDetection) {
+      disableTickInterrupt();
+      enableEdgeInterrupt();
+    } else {
+      disableEdgeInterrupt();
+      enableTickInterrupt();
+    }
   }
 
   // Return true if enough time to service rx request.
@@ -448,19 +713,50 @@ namespace lin_processor {
 
     // Here RX is low (active)
 
-    if (++low_bits_counter_ < 10) {
+    if (++low_bits_counter_ < kMinBreakBits) {
       return;
     }
 
-    // Detected a break. Wait for rx high and enter data reading.
+    // Detected a break. Let the RX edge interrupt catch its end. Its low
+    // period is known to be long enough.
     break_pin::setHigh();
-
-    // TODO: set actual max count
-    waitForRxHigh(255);
+    low_start_ticks_ = hardware_clock::ticksForIsr() - config.clock_ticks_per_break();
+    has_low_start_ = true;
+    disableTickInterrupt();
+    enableEdgeInterrupt();
     break_pin::setLow();
 
-    // Go process the data
+    // In case RX went high before the edge interrupt was enabled.
+    if (rx_pin::isHigh()) {
+      handleEdgeIsr();
+    }
+  }
+
+  inline void StateDetectBreak::handleEdgeIsr() {
+    // Timestamp first to minimize the ISR latency error.
+    const uint16 now_ticks = hardware_clock::ticksForIsr();
+
+    if (!rx_pin::isHigh()) {
+      low_start_ticks_ = now_ticks;
+      has_low_start_ = true;
+      return;
+    }
+
+    // Here on a low to high transition. A break if low long enough.
+    if (!has_low_start_) {
+      return;
+    }
+    has_low_start_ = false;
+    // Should work also in case of a clock overflow.
+    if ((uint16)(now_ticks - low_start_ticks_) < config.clock_ticks_per_break()) {
+      return;
+    }
+
+    // Detected a break. RX is now in the break delimiter. Go process the
+    // data.
+    break_pin::setHigh();
     StateReadData::enter();
+    break_pin::setLow();
   }
 
   // ----- Read-Data State Implementation -----
@@ -469,6 +765,8 @@ namespace lin_processor {
   uint8 StateReadData::bits_read_in_byte_;
   uint8 StateReadData::byte_buffer_;
   uint8 StateReadData::byte_buffer_bit_mask_;
+  boolean StateReadData::waiting_for_start_bit_;
+  uint8 StateReadData::space_bits_;
 
   // Called on the low to high transition at the end of the break.
   inline void StateReadData::enter() {
@@ -477,10 +775,66 @@ namespace lin_processor {
     bits_read_in_byte_ = 0;
     rx_frame_buffers[head_frame_buffer].reset();
 
-    // TODO: handle post break timeout errors.
-    // TODO: set a reasonable time limit.
-    waitForRxLow(255);
+    // Time the break delimiter in whole bits from now.
+    // TODO: seperate limit for the break delimiter.
+    resetTickTimer();
+    enableTickInterrupt();
+    waitForStartBit();
+  }
+
+  inline void StateReadData::waitForStartBit() {
+    waiting_for_start_bit_ = true;
+    space_bits_ = 0;
+    enableEdgeInterrupt();
+  }
+
+  inline void StateReadData::handleEdgeIsr() {
+    // Only the high to low transition of a start bit is of interest.
+    if (rx_pin::isHigh()) {
+      return;
+    }
+    // Have the next ticks in the middle of the start, data and stop bits.
     setTimerToHalfTick();
+    enableTickInterrupt();
+    disableEdgeInterrupt();
+    waiting_for_start_bit_ = false;
+
+    // Error if we already had the max number of bytes.
+    if (rx_frame_buffers[head_frame_buffer].num_bytes() >= LinFrame::kMaxBytes) {
+      setErrorFlags(errors::FRAME_TOO_LONG);
+      StateDetectBreak::enter();
+    }
+  }
+
+  inline void StateReadData::handleEndOfFrame() {
+    // No sync byte at all.
+    if (bytes_read_ == 0) {
+      setErrorFlags(errors::SYNC_BYTE);
+      StateDetectBreak::enter();
+      return;
+    }
+
+    // Verify min byte count. The sync byte is not in the frame buffer.
+    if (rx_frame_buffers[head_frame_buffer].num_bytes() < LinFrame::kMinBytes) {
+      setErrorFlags(errors::FRAME_TOO_SHORT);
+      StateDetectBreak::enter();
+      return;
+    }
+
+    // Frame looks ok so far. Move to next frame in the ring buffer. The
+    // end of the frame was kMaxSpaceBits ago.
+    commitHeadFrameBuffer(hardware_clock::ticksForIsr() - config.clock_ticks_per_max_space());
+    StateDetectBreak::enter();
+  }
+
+  inline uint8 StateReadData::tickProfilerSlot() {
+    if (waiting_for_start_bit_) {
+      return isr_profiler::slots::SPACE;
+    }
+    if (bits_read_in_byte_ == 0) {
+      return isr_profiler::slots::START_BIT;
+    }
+    return bits_read_in_byte_ <= 8 ? isr_profiler::slots::DATA_BIT : isr_profiler::slots::STOP_BIT;
   }
 
   inline void StateReadData::handleIsr() {
@@ -489,6 +843,14 @@ namespace lin_processor {
     const uint8 is_rx_high = rx_pin::isHigh();
     sample_pin::setLow();
 
+    // Waiting for the start bit of next byte. Ticks only time the space.
+    if (waiting_for_start_bit_) {
+      if (++space_bits_ >= kMaxSpaceBits) {
+        handleEndOfFrame();
+      }
+      return;
+    }
+
     // Handle start bit.
     if (bits_read_in_byte_ == 0) {
       // Start bit error.
@@ -545,48 +907,18 @@ namespace lin_processor {
       // NOTE: the byte limit count is enforeced somewhere else so we can assume safely here that this
       // will not cause a buffer overlow.
       rx_frame_buffers[head_frame_buffer].append_byte(byte_buffer_);
-    }
-
-    // Wait for the high to low transition of start bit of next byte.
-    const boolean has_more_bytes =  waitForRxLow(config.clock_ticks_per_until_start_bit());
-
-    // Handle the case of no more bytes in this frame.
-    if (!has_more_bytes) {
-      // Verify min byte count.
-      if (bytes_read_ < LinFrame::kMinBytes) {
-        setErrorFlags(errors::FRAME_TOO_SHORT);
+      // Abandon frames nobody subscribed to right after their id.
+      if (bytes_read_ == 2 && !isIdAccepted(byte_buffer_)) {
+#if LIN_BUS_STATS
+        queueHeaderEvent(byte_buffer_, hardware_clock::ticksForIsr());
+#endif
         StateDetectBreak::enter();
         return;
       }
-
-      // Frame looks ok so far. Move to next frame in the ring buffer.
-      // NOTE: we will reset the byte_count of the new frame buffer next time we will enter data detect state.
-      // NOTE: verification of sync byte, id, checksum, etc is done latter by the main code, not the ISR.
-      incrementHeadFrameBuffer();
-      if (tail_frame_buffer == head_frame_buffer) {
-        // Frame buffer overrun. We drop the oldest frame and continue with this one.
-        setErrorFlags(errors::BUFFER_OVERRUN);
-        incrementTailFrameBuffer();
-      }
-
-      StateDetectBreak::enter();
-      return;
     }
 
-    // Here when there is at least one more byte in this frame. Error if we already had
-    // the max number of bytes.
-    if (rx_frame_buffers[head_frame_buffer].num_bytes() >= LinFrame::kMaxBytes) {
-      setErrorFlags(errors::FRAME_TOO_LONG);
-      StateDetectBreak::enter();
-      return;
-    }
-
-    // Everything is ready for the next byte. Have a tick in the middle of its
-    // start bit.
-    //
-    // TODO: move this to above the num_bytes check above for more accurate
-    // timing of mid bit tick?
-    setTimerToHalfTick();
+    // Wait for the high to low transition of start bit of next byte.
+    waitForStartBit();
   }
 
   // ----- ISR Handler -----
@@ -594,7 +926,11 @@ namespace lin_processor {
   // Interrupt on Timer 2 A-match.
   ISR(TIMER2_COMPA_vect)
   {
+    const uint8 latency_count = isr_latency::entryCount();
     isr_pin::setHigh();
+    const uint16 profiler_start = isr_profiler::start();
+    const uint8 profiler_slot = state == states::READ_DATA
+        ? StateReadData::tickProfilerSlot() : isr_profiler::slots::DETECT_BREAK;
     // TODO: make this state a boolean instead of enum? (efficency).
     switch (state) {
     case states::DETECT_BREAK:
@@ -607,12 +943,376 @@ namespace lin_processor {
       setErrorFlags(errors::OTHER);
       StateDetectBreak::enter();
     }
+    isr_profiler::stop(profiler_slot, profiler_start);
+    isr_latency::record(latency_count);
+    isr_pin::setLow();
+  }
+
+  // Interrupt on RX (INT0) change. Enabled while waiting for the end of a
+  // break or for a start bit, and while detecting a break in the
+  // custom_defs::kUseEdgeBreakDetection mode.
+  ISR(INT0_vect)
+  {
+    isr_pin::setHigh();
+    const uint16 profiler_start = isr_profiler::start();
+    const uint8 profiler_slot = state == states::READ_DATA
+        ? isr_profiler::slots::RX_EDGE : isr_profiler::slots::DETECT_BREAK;
+    switch (state) {
+    case states::DETECT_BREAK:
+      StateDetectBreak::handleEdgeIsr();
+      break;
+    case states::READ_DATA:
+      StateReadData::handleEdgeIsr();
+      break;
+    default:
+      setErrorFlags(errors::OTHER);
+      StateDetectBreak::enter();
+    }
+    isr_profiler::stop(profiler_slot, profiler_start);
+    isr_latency::endSection(isr_latency::sections::RX_EDGE_ISR);
+    isr_pin::setLow();
+  }
+
+#else  // LIN_DECODER_CAPTURE
+
+  // ----- Input Capture Edge Queue -----
+  //
+  // The Timer1 input capture ISR only timestamps the RX edges. The bytes are
+  // reconstructed from the time between the edges by the main code, in
+  // readNextFrame().
+
+  // Must be a power of 2. 32 edges are at least 1.6ms of LIN traffic at
+  // 19200 baud. readNextFrame() should be called at least that often.
+  static const uint8 kMaxEdges = 32;
+
+  // Written by the ISR at edge_head, read by main at edge_tail. Empty when
+  // equal.
+  static volatile uint16 edge_ticks[kMaxEdges];
+  // RX level after each edge.
+  static volatile boolean edge_levels[kMaxEdges];
+  static volatile uint8 edge_head;
+  static volatile uint8 edge_tail;
+
+  // Set by the ISR when the queue was full and an edge was dropped.
+  static volatile boolean edge_overrun;
+
+  // ----- Input Capture Decoder -----
+
+  // Like enum but 8 bits only.
+  namespace states {
+    // Waiting for a falling edge that may start a break.
+    static const uint8 IDLE = 1;
+    // RX low. A break if it lasts long enough.
+    static const uint8 BREAK = 2;
+    // Waiting for the start bit of the next byte of a frame.
+    static const uint8 SPACE = 3;
+    // In a byte, between its start bit and the end of its stop bit.
+    static const uint8 BYTE = 4;
+  }
+
+  // Called from main only.
+  class CaptureDecoder {
+   public:
+    static void reset();
+    // Handle an RX edge, with the RX level after it.
+    static void handleEdge(uint16 ticks, boolean is_high);
+    // Handle the time passing with no more edges up to now_ticks.
+    static void handleTime(uint16 now_ticks);
+
+   private:
+    static void beginByte(uint16 ticks);
+    // Assign the current RX level to the bits of the current byte up to,
+    // excluding, end_bit.
+    static void collectBits(uint8 end_bit);
+    static void endByte();
+    static void endFrame();
+    // Index of the bit boundary nearest to the given ticks, counting from
+    // the beginning of the start bit. Capped at 10, the end of the stop bit.
+    static uint8 bitBoundary(uint16 ticks);
+
+    static uint8 state_;
+
+    // Beginning of the BREAK low period.
+    static uint16 low_start_ticks_;
+
+    // Beginning of the SPACE period (end of break or of a stop bit).
+    static uint16 space_start_ticks_;
+
+    // Beginning of the start bit of the current byte.
+    static uint16 byte_start_ticks_;
+
+    // Number of bits of the current byte with a known level.
+    static uint8 bits_done_;
+
+    // RX level since the last edge of the current byte.
+    static boolean is_high_;
+
+    static boolean start_bit_high_;
+    static boolean stop_bit_high_;
+    static uint8 byte_buffer_;
+
+    // Number of complete bytes read so far. Includes all bytes, even
+    // sync, id and checksum.
+    static uint8 bytes_read_;
+  };
+
+  uint8 CaptureDecoder::state_;
+  uint16 CaptureDecoder::low_start_ticks_;
+  uint16 CaptureDecoder::space_start_ticks_;
+  uint16 CaptureDecoder::byte_start_ticks_;
+  uint8 CaptureDecoder::bits_done_;
+  boolean CaptureDecoder::is_high_;
+  boolean CaptureDecoder::start_bit_high_;
+  boolean CaptureDecoder::stop_bit_high_;
+  uint8 CaptureDecoder::byte_buffer_;
+  uint8 CaptureDecoder::bytes_read_;
+
+  void CaptureDecoder::reset() {
+    state_ = states::IDLE;
+  }
+
+  uint8 CaptureDecoder::bitBoundary(uint16 ticks) {
+    const uint16 delta = ticks - byte_start_ticks_;
+    if (delta >= config.clock_ticks_per_byte()) {
+      return 10;
+    }
+    const uint16 ticks_per_bit_x256 = config.clock_ticks_per_bit_x256();
+    return ((((uint32)delta) << 8) + (ticks_per_bit_x256 >> 1)) / ticks_per_bit_x256;
+  }
+
+  void CaptureDecoder::collectBits(uint8 end_bit) {
+    for (uint8 i = bits_done_; i < end_bit; i++) {
+      if (i == 0) {
+        start_bit_high_ = is_high_;
+      } else if (i <= 8) {
+        if (is_high_) {
+          byte_buffer_ |= H(i - 1);
+        }
+      } else {
+        stop_bit_high_ = is_high_;
+      }
+    }
+    if (end_bit > bits_done_) {
+      bits_done_ = end_bit;
+    }
+  }
+
+  void CaptureDecoder::beginByte(uint16 ticks) {
+    // Error if we already had the max number of bytes.
+    if (rx_frame_buffers[head_frame_buffer].num_bytes() >= LinFrame::kMaxBytes) {
+      setErrorFlags(errors::FRAME_TOO_LONG);
+      // This falling edge may be the next break.
+      state_ = states::BREAK;
+      low_start_ticks_ = ticks;
+      return;
+    }
+    state_ = states::BYTE;
+    byte_start_ticks_ = ticks;
+    bits_done_ = 0;
+    is_high_ = false;
+    byte_buffer_ = 0;
+  }
+
+  void CaptureDecoder::endByte() {
+    // Error if start or stop bit is not as expected.
+    if (start_bit_high_ || !stop_bit_high_) {
+      if (!start_bit_high_ && byte_buffer_ == 0) {
+        // Low all along. This is the next break, which also ends the
+        // current frame.
+        if (bytes_read_ > 0) {
+          endFrame();
+        }
+        state_ = states::BREAK;
+        low_start_ticks_ = byte_start_ticks_;
+        return;
+      }
+      // If in sync byte, report as a sync error.
+      setErrorFlags(bytes_read_ == 0 ? errors::SYNC_BYTE
+          : (start_bit_high_ ? errors::START_BIT : errors::STOP_BIT));
+      state_ = states::IDLE;
+      return;
+    }
+
+    bytes_read_++;
+    if (bytes_read_ == 1) {
+      // Should be exactly 0x55. We don't append this byte to the buffer.
+      if (byte_buffer_ != 0x55) {
+        setErrorFlags(errors::SYNC_BYTE);
+        state_ = states::IDLE;
+        return;
+      }
+    } else {
+      // The byte limit is checked in beginByte().
+      rx_frame_buffers[head_frame_buffer].append_byte(byte_buffer_);
+      // Abandon frames nobody subscribed to right after their id.
+      if (bytes_read_ == 2 && !isIdAccepted(byte_buffer_)) {
+#if LIN_BUS_STATS
+        queueHeaderEvent(byte_buffer_, byte_start_ticks_ + config.clock_ticks_per_byte());
+#endif
+        state_ = states::IDLE;
+        return;
+      }
+    }
+
+    state_ = states::SPACE;
+    space_start_ticks_ = byte_start_ticks_ + config.clock_ticks_per_byte();
+  }
+
+  void CaptureDecoder::endFrame() {
+    state_ = states::IDLE;
+    // No sync byte at all.
+    if (bytes_read_ == 0) {
+      setErrorFlags(errors::SYNC_BYTE);
+      return;
+    }
+    // Verify min byte count. The sync byte is not in the frame buffer.
+    if (rx_frame_buffers[head_frame_buffer].num_bytes() < LinFrame::kMinBytes) {
+      setErrorFlags(errors::FRAME_TOO_SHORT);
+      return;
+    }
+    // End of the stop bit of the last byte, from the captured edges.
+    commitHeadFrameBuffer(space_start_ticks_);
+  }
+
+  void CaptureDecoder::handleEdge(uint16 ticks, boolean is_high) {
+    switch (state_) {
+    case states::IDLE:
+      if (!is_high) {
+        state_ = states::BREAK;
+        low_start_ticks_ = ticks;
+      }
+      return;
+
+    case states::BREAK:
+      if (!is_high) {
+        // Missed the rising edge. Time the low period from here.
+        low_start_ticks_ = ticks;
+        return;
+      }
+      // Should work also in case of a clock overflow.
+      if ((uint16)(ticks - low_start_ticks_) < config.clock_ticks_per_break()) {
+        state_ = states::IDLE;
+        return;
+      }
+      // Detected a break. RX is now in the break delimiter.
+      state_ = states::SPACE;
+      space_start_ticks_ = ticks;
+      bytes_read_ = 0;
+      rx_frame_buffers[head_frame_buffer].reset();
+      return;
+
+    case states::SPACE:
+      if (!is_high) {
+        beginByte(ticks);
+      }
+      return;
+
+    case states::BYTE: {
+      const uint8 boundary = bitBoundary(ticks);
+      collectBits(boundary);
+      if (boundary < 10) {
+        is_high_ = is_high;
+        return;
+      }
+      // An edge after the stop bit. Handle it in the state that follows
+      // the byte.
+      endByte();
+      handleEdge(ticks, is_high);
+      return;
+    }
+
+    default:
+      setErrorFlags(errors::OTHER);
+      state_ = states::IDLE;
+    }
+  }
+
+  void CaptureDecoder::handleTime(uint16 now_ticks) {
+    if (state_ == states::BYTE) {
+      // Past the middle of the stop bit, with half a bit of margin for
+      // capture ISRs still pending. No more edges in this byte.
+      if ((uint16)(now_ticks - byte_start_ticks_) >=
+          config.clock_ticks_per_byte() + config.clock_ticks_per_half_bit()) {
+        collectBits(10);
+        endByte();
+      }
+    }
+    if (state_ == states::SPACE) {
+      if ((uint16)(now_ticks - space_start_ticks_) >= config.clock_ticks_per_max_space()) {
+        endFrame();
+      }
+    }
+  }
+
+  static void decodeCapturedEdges() {
+    // Sample the time first. Edges captured after it stay queued for the
+    // next call so the timeouts never pass over a queued edge.
+    const uint16 now_ticks = hardware_clock::ticksForNonIsr();
+
+    if (edge_overrun) {
+      // The edges in the queue do not follow the last decoded one anymore.
+      edge_overrun = false;
+      edge_tail = edge_head;
+      setErrorFlags(errors::BUFFER_OVERRUN);
+      CaptureDecoder::reset();
+    }
 
-    // Increment the isr flag to indicate to the main that the ISR just
-    // exited and interrupts can be temporarily disabled without causes ISR
-    // jitter.
-    isr_marker++;
+    uint8 tail = edge_tail;
+    while (tail != edge_head) {
+      const uint16 ticks = edge_ticks[tail];
+      if ((int16)(ticks - now_ticks) > 0) {
+        break;
+      }
+      // Timeouts that expired before this edge come first.
+      CaptureDecoder::handleTime(ticks);
+      CaptureDecoder::handleEdge(ticks, edge_levels[tail]);
+      tail = (tail + 1) & (kMaxEdges - 1);
+      edge_tail = tail;
+    }
+
+    CaptureDecoder::handleTime(now_ticks);
+  }
 
+  static void setupCapture() {
+    edge_head = 0;
+    edge_tail = 0;
+    edge_overrun = false;
+    CaptureDecoder::reset();
+
+    // Timer1 runs from hardware_clock. Add the noise canceler (4 cycles
+    // delay) and capture the falling edge of a break first.
+    TCCR1B = (TCCR1B | H(ICNC1)) & ~H(ICES1);
+    // Changing ICES1 may set ICF1.
+    TIFR1 = H(ICF1);
+    TIMSK1 |= H(ICIE1);
+  }
+
+  // ----- ISR Handler -----
+
+  // Interrupt on Timer1 input capture, an RX edge on ICP1.
+  ISR(TIMER1_CAPT_vect)
+  {
+    isr_pin::setHigh();
+    const uint16 profiler_start = isr_profiler::start();
+    const uint16 ticks = ICR1;
+    // ICES1 tells which edge was just captured. Capture the opposite one
+    // next. Changing ICES1 may set ICF1.
+    const uint8 tccr1b = TCCR1B;
+    TCCR1B = tccr1b ^ H(ICES1);
+    TIFR1 = H(ICF1);
+
+    const uint8 head = edge_head;
+    const uint8 next_head = (head + 1) & (kMaxEdges - 1);
+    if (next_head == edge_tail) {
+      edge_overrun = true;
+    } else {
+      edge_ticks[head] = ticks;
+      edge_levels[head] = (tccr1b & H(ICES1)) != 0;
+      edge_head = next_head;
+    }
+    isr_profiler::stop(isr_profiler::slots::CAPTURE, profiler_start);
     isr_pin::setLow();
   }
+
+#endif  // LIN_DECODER_CAPTURE
 }  // namespace lin_processor
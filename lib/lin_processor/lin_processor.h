@@ -16,12 +16,20 @@
 #include "avr_util.h"
 #include "lin_frame.h"
 
-// Uses 
+// Uses, with the default LIN_DECODER_TIMER2 backend (see custom_defs.h)
 // * Timer2 - used to generate the bit ticks.
 // * OC2B (PD3) - timer output ticks. For debugging. If needed, can be changed
 //   to not using this pin.
 // * PD2 - LIN RX input.
+// * INT0 (PD2) - RX edges. Catches the end of the break and the start bits
+//   without busy waiting in the ISR, and the break itself in the
+//   custom_defs::kUseEdgeBreakDetection mode.
 // * PC0, PC1, PC2, PC3 - debugging outputs. See .cpp file for details.
+//
+// Uses, with the LIN_DECODER_CAPTURE backend
+// * Timer1 input capture interrupt. Timer1 itself is set up by hardware_clock.
+// * ICP1 (PB0) - LIN RX input.
+// * PC0, PC1, PC2, PC3 - debugging outputs.
 namespace lin_processor {
   // Call once in program setup. 
   extern void setup();
@@ -30,8 +38,36 @@ namespace lin_processor {
   // given buffer. Otherwise, return false and leave *buffer unmodified. 
   // The sync, id and checksum bytes of the frame as well as the total byte
   // count are not verified. 
+  // With LIN_DECODER_CAPTURE this also decodes the pending RX edges and
+  // should be called at least every 1.6ms.
   extern boolean readNextFrame(LinFrame* buffer);
 
+  // Zero copy alternative to readNextFrame(). Returns the oldest rx frame,
+  // in place, or null if none. The frame stays valid and queued until
+  // releaseFrame() is called. Does not disable interrupts.
+  extern const LinFrame* peekFrame();
+
+  // Drop the frame returned by the last non null peekFrame().
+  extern void releaseFrame();
+
+  // Handler of the received frames of a frame id.
+  typedef void (*FrameHandler)(const LinFrame& frame);
+
+  // Subscribe to the frames of the given 6 bit frame id (the parity bits
+  // are ignored). Call from setup.
+  //
+  // Initially the frames of all ids are queued. Once any id is subscribed
+  // only the frames of subscribed ids are, and the decoder abandons the
+  // others right after their id byte. With LIN_BUS_STATS (see
+  // custom_defs.h) the frames of all ids are read and counted, and
+  // dispatchFrames() drops the others.
+  extern void subscribe(uint8 id, FrameHandler handler);
+
+  // Pass the queued frames to the handlers of their ids and drop them.
+  // Returns the number of frames handled. Call from main. Also feeds
+  // lin_stats with LIN_BUS_STATS.
+  extern uint8 dispatchFrames();
+
   // Errors byte masks for the individual error bits.
   namespace errors {
     static const uint8 FRAME_TOO_SHORT = (1 << 0);
@@ -48,6 +84,9 @@ namespace lin_processor {
   
   // Print to sio a list of error flags.
   extern void printErrorFlags(uint8 lin_errors);
+
+  // Four letter name of the errors bit of the given index, e.g. "SYNC".
+  extern const char* errorBitName(uint8 bit_index);
 }
 
 #endif  
@@ -0,0 +1,183 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lin_stats.h"
+
+#include "system_clock.h"
+
+#if LIN_BUS_STATS
+
+namespace lin_stats {
+  static const uint16 kWindowMillis = 1000;
+  // Break and break delimiter, in bits. The sync byte and the frame bytes
+  // are 10 bits each.
+  static const uint8 kHeaderBits = 13 + 1;
+
+  static IdStats ids[kMaxIds];
+  static uint8 id_count;
+  static BusStats bus;
+
+  static uint32 window_start_millis;
+  static uint32 window_bits;
+  static boolean has_load;
+
+  static inline void increment(uint16* counter) {
+    if (*counter != 0xffff) {
+      (*counter)++;
+    }
+  }
+
+  static IdStats* findId(uint8 id) {
+    for (uint8 i = 0; i < id_count; i++) {
+      if (ids[i].id == id) {
+        return &ids[i];
+      }
+    }
+    return NULL;
+  }
+
+  // A new entry, or the one with the fewest frames if the table is full.
+  static IdStats* addId(uint8 id) {
+    uint32 inherited_frames = 0;
+    IdStats* entry;
+    if (id_count < kMaxIds) {
+      entry = &ids[id_count++];
+    } else {
+      entry = &ids[0];
+      for (uint8 i = 1; i < kMaxIds; i++) {
+        if (ids[i].frames < entry->frames) {
+          entry = &ids[i];
+        }
+      }
+      inherited_frames = entry->frames;
+      bus.evicted_frames += inherited_frames;
+    }
+    *entry = IdStats();
+    entry->id = id;
+    entry->frames = inherited_frames;
+    entry->min_interval_ticks = 0xffff;
+    return entry;
+  }
+
+  void setup(uint32 now_millis) {
+    id_count = 0;
+    bus = BusStats();
+    window_start_millis = now_millis;
+    window_bits = 0;
+    has_load = false;
+  }
+
+  void loop(uint32 now_millis) {
+    const uint32 elapsed = now_millis - window_start_millis;
+    if (elapsed < kWindowMillis) {
+      return;
+    }
+    const uint32 bits_per_second = window_bits * 1000 / elapsed;
+    const uint32 load = bits_per_second * 10000 / custom_defs::kLinSpeed;
+    bus.last_window_load_x100 = load > 10000 ? 10000 : load;
+    bus.load_x100 = has_load
+        ? (3 * (uint32)bus.load_x100 + bus.last_window_load_x100) / 4
+        : bus.last_window_load_x100;
+    has_load = true;
+    window_start_millis = now_millis;
+    window_bits = 0;
+  }
+
+  // Counts a frame of id with the given end time and bits on the bus.
+  static IdStats* countFrame(uint8 id, uint16 end_ticks16, uint16 bits) {
+    // Queued frames are at most a few ms old.
+    const uint32 end_ticks = system_clock::extendTicks(end_ticks16);
+
+    bus.frames++;
+    window_bits += bits;
+
+    IdStats* entry = findId(id);
+    const boolean is_new = !entry;
+    if (is_new) {
+      entry = addId(id);
+    }
+    entry->frames++;
+    if (!is_new) {
+      const uint32 interval = end_ticks - entry->last_end_ticks;
+      const uint16 interval16 = interval > 0xffff ? 0xffff : interval;
+      if (interval16 < entry->min_interval_ticks) {
+        entry->min_interval_ticks = interval16;
+      }
+      if (interval16 > entry->max_interval_ticks) {
+        entry->max_interval_ticks = interval16;
+      }
+      if (entry->interval_sum_ticks >= 0x80000000UL || entry->intervals == 0xffff) {
+        entry->interval_sum_ticks >>= 1;
+        entry->intervals >>= 1;
+      }
+      entry->interval_sum_ticks += interval;
+      entry->intervals++;
+    }
+    entry->last_end_ticks = end_ticks;
+    return entry;
+  }
+
+  void onFrame(const LinFrame& frame) {
+    IdStats* const entry = countFrame(frame.get_byte(0) & 0x3f, frame.timestamp(),
+        kHeaderBits + 10 * (1 + frame.num_bytes()));
+    if (!frame.isValid()) {
+      increment(&entry->bad_frames);
+    }
+  }
+
+  void onHeader(uint8 id, uint16 end_ticks) {
+    bus.header_frames++;
+    // Sync and id.
+    countFrame(id, end_ticks, kHeaderBits + 2 * 10);
+  }
+
+  void onError(uint8 id, uint8 error_flags) {
+    for (uint8 i = 0; i < kNumErrorTypes; i++) {
+      if (error_flags & H(i)) {
+        increment(&bus.errors[i]);
+      }
+    }
+    IdStats* const entry = id == kNoId ? NULL : findId(id);
+    if (entry) {
+      increment(&entry->errors);
+    } else {
+      increment(&bus.errors_without_id);
+    }
+  }
+
+  const BusStats& busStats() {
+    return bus;
+  }
+
+  uint8 idCount() {
+    return id_count;
+  }
+
+  const IdStats& idStats(uint8 index) {
+    return ids[index];
+  }
+
+  void sortIds() {
+    // Insertion sort, the table is small and mostly sorted already.
+    for (uint8 i = 1; i < id_count; i++) {
+      const IdStats entry = ids[i];
+      uint8 j = i;
+      while (j > 0 && ids[j - 1].frames < entry.frames) {
+        ids[j] = ids[j - 1];
+        j--;
+      }
+      ids[j] = entry;
+    }
+  }
+}  // namespace lin_stats
+
+#endif
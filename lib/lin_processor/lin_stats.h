@@ -0,0 +1,95 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIN_STATS_H
+#define LIN_STATS_H
+
+#include "avr_util.h"
+#include "custom_defs.h"
+#include "lin_frame.h"
+
+// LIN bus statistics, fed by lin_processor::dispatchFrames() with every
+// decoded frame, every decoder error and the header of every frame the
+// decoder dropped after the id (ids not subscribed to). Main only.
+//
+// Per frame id: frame count, min/avg/max time between frames (from the
+// frame end timestamps taken in the ISR, the id byte end for dropped
+// frames), decoder errors and frames that failed the parity or checksum
+// check. The bus load counts only the header of dropped frames. Only the
+// custom_defs::kLinStatsIds most frequent ids have an entry: a new id takes
+// over the entry with the fewest frames and inherits its count (space
+// saving top k), so a count is an upper bound for an id that took over an
+// entry.
+//
+// With LIN_BUS_STATS 0 (see custom_defs.h) nothing is collected.
+namespace lin_stats {
+  static const uint8 kMaxIds = custom_defs::kLinStatsIds;
+  // Number of lin_processor::errors bits.
+  static const uint8 kNumErrorTypes = 7;
+  // Error id of the errors before a frame id was read.
+  static const uint8 kNoId = 0xff;
+
+  struct IdStats {
+    // 6 bit frame id.
+    uint8 id;
+    uint32 frames;
+    // Hardware clock ticks, saturated at 0xffff (262ms).
+    uint16 min_interval_ticks;
+    uint16 max_interval_ticks;
+    // For the average. Both halved as the sum gets large.
+    uint32 interval_sum_ticks;
+    uint16 intervals;
+    uint16 errors;
+    uint16 bad_frames;
+    // system_clock::timeTicks() time of the last frame end.
+    uint32 last_end_ticks;
+  };
+
+  struct BusStats {
+    uint32 frames;
+    // Of frames, the ones dropped by the decoder after the id.
+    uint32 header_frames;
+    // Frames of the ids evicted from the table.
+    uint32 evicted_frames;
+    // By error bit index.
+    uint16 errors[kNumErrorTypes];
+    // Errors before the frame id was read or of an id without an entry.
+    uint16 errors_without_id;
+    // Rolling bus load in 1/100 percent, from the frame bits.
+    uint16 load_x100;
+    uint16 last_window_load_x100;
+  };
+
+  // Call once from setup, after hardware_clock::setup().
+  extern void setup(uint32 now_millis);
+
+  // Call periodically from the main loop.
+  extern void loop(uint32 now_millis);
+
+  // From lin_processor.
+  extern void onFrame(const LinFrame& frame);
+  // id is the 6 bit frame id or kNoId.
+  extern void onError(uint8 id, uint8 error_flags);
+  // A frame dropped after its 6 bit id, which ended at the hardware clock
+  // time end_ticks.
+  extern void onHeader(uint8 id, uint16 end_ticks);
+
+  extern const BusStats& busStats();
+
+  // Number of used id entries, most frames first after sortIds().
+  extern uint8 idCount();
+  extern const IdStats& idStats(uint8 index);
+  // Orders the id entries by frame count, for printing.
+  extern void sortIds();
+}  // namespace lin_stats
+
+#endif
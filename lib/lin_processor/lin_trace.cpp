@@ -0,0 +1,206 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lin_trace.h"
+
+#include "system_clock.h"
+
+#if LIN_TRACE
+
+namespace lin_trace {
+  static const uint16 kRingBytes = custom_defs::kLinTraceBytes;
+
+  static uint8 ring[kRingBytes];
+  // Start of the oldest record and end of the newest one.
+  static uint16 tail;
+  static uint16 head;
+  static uint16 used_bytes;
+  static uint16 lost_records;
+  // Bytes left to record after the trigger.
+  static uint16 post_trigger_bytes;
+
+  static uint8 current_state = states::OFF;
+  static uint8 trigger_cause;
+  static Config current_config;
+
+  static inline uint16 wrap(uint16 index) {
+    return index >= kRingBytes ? index - kRingBytes : index;
+  }
+
+  static void put(uint8 value) {
+    ring[head] = value;
+    head = wrap(head + 1);
+  }
+
+  // Appends a record, dropping the oldest ones to make room. Counts it
+  // against the post trigger bytes and stops when they run out.
+  static void addRecord(uint8 kind, uint32 ticks, uint8 flags, const uint8* bytes,
+      uint8 count) {
+    if (current_state != states::ARMED && current_state != states::TRIGGERED) {
+      return;
+    }
+    const uint8 size = lin_trace_format::kRecordHeaderBytes + count;
+    if (current_state == states::TRIGGERED) {
+      if (size > post_trigger_bytes) {
+        current_state = states::STOPPED;
+        return;
+      }
+      post_trigger_bytes -= size;
+    }
+    while (used_bytes + size > kRingBytes) {
+      const uint8 dropped = lin_trace_format::kRecordHeaderBytes +
+          lin_trace_format::recordCount(ring[tail]);
+      tail = wrap(tail + dropped);
+      used_bytes -= dropped;
+      if (lost_records != 0xffff) {
+        lost_records++;
+      }
+    }
+    put(lin_trace_format::kindAndCount(kind, count));
+    put(ticks);
+    put(ticks >> 8);
+    put(ticks >> 16);
+    put(ticks >> 24);
+    put(flags);
+    for (uint8 i = 0; i < count; i++) {
+      put(bytes[i]);
+    }
+    used_bytes += size;
+  }
+
+  static void triggerAt(uint8 cause, uint32 ticks) {
+    addRecord(lin_trace_format::kinds::TRIGGER, ticks, cause, NULL, 0);
+    trigger_cause = cause;
+    post_trigger_bytes = (uint32)kRingBytes * current_config.post_trigger_percent / 100;
+    current_state = post_trigger_bytes ? states::TRIGGERED : states::STOPPED;
+  }
+
+  void arm(const Config& config) {
+    current_config = config;
+    if (current_config.post_trigger_percent > 100) {
+      current_config.post_trigger_percent = 100;
+    }
+    tail = 0;
+    head = 0;
+    used_bytes = 0;
+    lost_records = 0;
+    trigger_cause = 0;
+    current_state = states::ARMED;
+  }
+
+  void stop() {
+    if (current_state == states::ARMED) {
+      triggerAt(triggers::MANUAL, system_clock::timeTicks());
+    }
+    if (current_state == states::TRIGGERED) {
+      current_state = states::STOPPED;
+    }
+  }
+
+  boolean trigger(uint8 cause) {
+    if (current_state != states::ARMED || !(current_config.triggers & cause)) {
+      return false;
+    }
+    triggerAt(cause, system_clock::timeTicks());
+    return true;
+  }
+
+  void onFrame(const LinFrame& frame) {
+    if (current_state != states::ARMED && current_state != states::TRIGGERED) {
+      return;
+    }
+    uint8 bytes[LinFrame::kMaxBytes];
+    const uint8 n = frame.num_bytes();
+    for (uint8 i = 0; i < n; i++) {
+      bytes[i] = frame.get_byte(i);
+    }
+    const uint32 ticks = system_clock::extendTicks(frame.timestamp());
+    addRecord(lin_trace_format::kinds::FRAME, ticks, frame.flags(), bytes, n);
+    if (current_state == states::ARMED && (current_config.triggers & triggers::ID) &&
+        n && (bytes[0] & 0x3f) == current_config.id) {
+      triggerAt(triggers::ID, ticks);
+    }
+  }
+
+  void onError(uint8 id, uint8 error_flags) {
+    if (current_state != states::ARMED && current_state != states::TRIGGERED) {
+      return;
+    }
+    // When the error was seen, not when it was dispatched. Close enough.
+    const uint32 ticks = system_clock::timeTicks();
+    addRecord(lin_trace_format::kinds::ERROR, ticks, error_flags, &id, id <= 0x3f ? 1 : 0);
+    if (current_state == states::ARMED && (current_config.triggers & triggers::ERROR)) {
+      triggerAt(triggers::ERROR, ticks);
+    }
+  }
+
+  uint8 state() {
+    return current_state;
+  }
+
+  const Config& config() {
+    return current_config;
+  }
+
+  uint8 cause() {
+    return trigger_cause;
+  }
+
+  uint16 recordBytes() {
+    return used_bytes;
+  }
+
+  uint16 lostRecords() {
+    return lost_records;
+  }
+
+  uint16 blockSize() {
+    return lin_trace_format::kHeaderBytes + used_bytes;
+  }
+
+  // Header byte at the given offset.
+  static uint8 headerByte(uint8 offset) {
+    using namespace lin_trace_format;
+    uint16 value;
+    switch (offset & ~1) {
+      case 0:
+        return offset ? kMagic1 : kMagic0;
+      case 2:
+        return offset == 2 ? kVersion : trigger_cause;
+      case kTicksPerMilliOffset:
+        value = hardware_clock::kTicksPerMilli;
+        break;
+      case kBaudOffset:
+        value = custom_defs::kLinSpeed;
+        break;
+      case kRecordBytesOffset:
+        value = used_bytes;
+        break;
+      default:
+        value = lost_records;
+        break;
+    }
+    return offset & 1 ? value >> 8 : value;
+  }
+
+  void readBlock(uint16 offset, uint8* out, uint8 n) {
+    for (uint8 i = 0; i < n; i++, offset++) {
+      if (offset < lin_trace_format::kHeaderBytes) {
+        out[i] = headerByte(offset);
+      } else {
+        out[i] = ring[wrap(tail + (offset - lin_trace_format::kHeaderBytes))];
+      }
+    }
+  }
+}  // namespace lin_trace
+
+#endif
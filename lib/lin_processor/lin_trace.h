@@ -0,0 +1,82 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIN_TRACE_H
+#define LIN_TRACE_H
+
+#include "avr_util.h"
+#include "custom_defs.h"
+#include "lin_frame.h"
+#include "lin_trace_format.h"
+
+// LIN trace recorder. Records the frames and decoder errors passed by
+// lin_processor::dispatchFrames() with 32 bit timestamps into a RAM ring of
+// custom_defs::kLinTraceBytes, overwriting the oldest records, until a
+// trigger. It then records the configured share of the ring and stops, so
+// the ring holds the traffic around the trigger. The block format is in
+// lin_trace_format.h. Main only.
+//
+// With LIN_TRACE 0 (see custom_defs.h) nothing is recorded.
+namespace lin_trace {
+  // Trigger causes, bits of Config::triggers. POSITION_JUMP is detected
+  // by the caller, MANUAL is stop().
+  namespace triggers = lin_trace_format::triggers;
+
+  // Like enum but 8 bits only.
+  namespace states {
+    static const uint8 OFF = 0;
+    // Recording, waiting for a trigger.
+    static const uint8 ARMED = 1;
+    // Recording the records after the trigger.
+    static const uint8 TRIGGERED = 2;
+    // Done, the ring is kept until the next arm().
+    static const uint8 STOPPED = 3;
+  }
+
+  struct Config {
+    uint8 triggers;
+    // 6 bit frame id of the ID trigger.
+    uint8 id;
+    uint16 position_jump;
+    // Share of the ring recorded after the trigger, 0 to 100.
+    uint8 post_trigger_percent;
+  };
+
+  // Clears the ring and starts recording.
+  extern void arm(const Config& config);
+
+  // Triggers now and stops without recording more.
+  extern void stop();
+
+  // Triggers if armed and the cause is enabled. Returns true if it did.
+  extern boolean trigger(uint8 cause);
+
+  // From lin_processor.
+  extern void onFrame(const LinFrame& frame);
+  // id is the 6 bit frame id, or above 0x3f if the error came before it.
+  extern void onError(uint8 id, uint8 error_flags);
+
+  extern uint8 state();
+  extern const Config& config();
+  // The trigger bit that triggered, 0 before.
+  extern uint8 cause();
+  extern uint16 recordBytes();
+  extern uint16 lostRecords();
+
+  // Size of the block, header included.
+  extern uint16 blockSize();
+  // Copies n bytes of the block, from the given offset, to out. Consistent
+  // only while STOPPED.
+  extern void readBlock(uint16 offset, uint8* out, uint8 n);
+}  // namespace lin_trace
+
+#endif
@@ -0,0 +1,90 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIN_TRACE_FORMAT_H
+#define LIN_TRACE_FORMAT_H
+
+#include <stdint.h>
+
+// Layout of the LIN trace block of lin_trace.h, as dumped by the controller
+// with the TRACE_DUMP request (see desk_protocol.h). Multi byte values are
+// little endian.
+//
+// Block: header, then the records, oldest first.
+//
+// Header, kHeaderBytes:
+//   'L', 'T', version u8, trigger cause u8 (a triggers bit, 0 if not
+//   triggered), ticks per milli u16, LIN baud rate u16, record bytes
+//   u16, records lost to overwrites u16.
+//
+// Record: kind and byte count u8 (kind in the high nibble), ticks u32,
+// flags u8, bytes. Ticks are hardware clock ticks (4us) since the start of
+// the firmware, wrapping every ~4.8 hours.
+//   FRAME: flags are the LinFrame flags, bytes are the id byte with its
+//     parity bits, the data and the checksum.
+//   ERROR: flags are the lin_processor::errors bits, bytes are the 6 bit id
+//     of the frame or none if the error came before the id.
+//   TRIGGER: flags are the trigger cause, no bytes.
+//
+// Shared by the firmware and the host tools, no Arduino dependencies.
+namespace lin_trace_format {
+  static const uint8_t kMagic0 = 'L';
+  static const uint8_t kMagic1 = 'T';
+  static const uint8_t kVersion = 1;
+  static const uint8_t kHeaderBytes = 12;
+
+  // Header field offsets.
+  static const uint8_t kCauseOffset = 3;
+  static const uint8_t kTicksPerMilliOffset = 4;
+  static const uint8_t kBaudOffset = 6;
+  static const uint8_t kRecordBytesOffset = 8;
+  static const uint8_t kLostRecordsOffset = 10;
+
+  // Trigger causes. Also the bits of lin_trace::Config::triggers.
+  namespace triggers {
+    // Any decoder error.
+    static const uint8_t ERROR = 1 << 0;
+    // A frame of the configured id.
+    static const uint8_t ID = 1 << 1;
+    // The position changed by the configured jump or more between two
+    // position frames.
+    static const uint8_t POSITION_JUMP = 1 << 2;
+    // Stopped by a dump or a command. Always enabled.
+    static const uint8_t MANUAL = 1 << 3;
+  }
+
+  // Record kinds.
+  namespace kinds {
+    static const uint8_t FRAME = 0;
+    static const uint8_t ERROR = 1;
+    static const uint8_t TRIGGER = 2;
+  }
+
+  // Kind and count byte, ticks and flags.
+  static const uint8_t kRecordHeaderBytes = 6;
+  // One id, 8 data bytes and the checksum.
+  static const uint8_t kMaxRecordBytes = 10;
+
+  inline uint8_t kindAndCount(uint8_t kind, uint8_t count) {
+    return (kind << 4) | count;
+  }
+
+  inline uint8_t recordKind(uint8_t kind_and_count) {
+    return kind_and_count >> 4;
+  }
+
+  inline uint8_t recordCount(uint8_t kind_and_count) {
+    return kind_and_count & 0x0f;
+  }
+}  // namespace lin_trace_format
+
+#endif
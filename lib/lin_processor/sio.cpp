@@ -14,6 +14,8 @@
 
 #include <stdarg.h>
 
+#include "isr_latency.h"
+
 namespace sio {
   // TODO: do we need to set the i/o pins (PD0, PD1)? Do we rely on setting by 
   // the bootloader?
@@ -27,6 +29,13 @@ namespace sio {
   static uint8 start;
   // Number of bytes in queue.
   static uint8 count;
+  // Received bytes. Single producer (the RX ISR), single consumer (main)
+  // queue, like the LIN frames.
+  static uint8 rx_buffer[kRxQueueSize];
+  static volatile uint8 rx_head;
+  static volatile uint8 rx_tail;
+  // See rxOverruns(). Updated by the ISR.
+  static volatile uint8 rx_overruns;
 
   // Caller need to verify that count < kQueueSize before calling this.
   static void unsafe_enqueue(byte b) {
@@ -52,6 +61,9 @@ namespace sio {
   void setup() {
     start = 0;
     count = 0;
+    rx_head = 0;
+    rx_tail = 0;
+    rx_overruns = 0;
     
 #if F_CPU != 16000000
 #error "The existing code assumes 16Mhz CPU clk."
@@ -62,8 +74,8 @@ namespace sio {
     UBRR0H = 0;
     UBRR0L = 16;
     UCSR0A = H(U2X0);
-    // Enable  the transmitter. Reciever is disabled.
-    UCSR0B = H(TXEN0);
+    // Enable the transmitter and the reciever with its RX interrupt.
+    UCSR0B = H(TXEN0) | H(RXEN0) | H(RXCIE0);
     UCSR0C = H(UDORD0) | H(UCPHA0);  //(3 << UCSZ00);  
   }
 
@@ -82,10 +94,51 @@ namespace sio {
     }
   }
 
+  boolean available() {
+    return rx_tail != rx_head;
+  }
+
+  uint8 read() {
+    const uint8 tail = rx_tail;
+    // Index first, then the byte.
+    MEMORY_BARRIER();
+    const uint8 b = rx_buffer[tail];
+    MEMORY_BARRIER();
+    rx_tail = (tail + 1) & (kRxQueueSize - 1);
+    return b;
+  }
+
+  uint8 rxOverruns() {
+    return rx_overruns;
+  }
+
   uint8 capacity() {
     return kQueueSize - count;
   }
 
+  // ----- ISR Handler -----
+
+  // A byte received. Stores it, or counts it lost if the ring is full.
+  ISR(USART_RX_vect)
+  {
+    // Status must be read before the data.
+    const boolean overrun = UCSR0A & H(DOR0);
+    const uint8 b = UDR0;
+    const uint8 head = rx_head;
+    const uint8 next = (head + 1) & (kRxQueueSize - 1);
+    if (next == rx_tail || overrun) {
+      if (rx_overruns < 0xff) {
+        rx_overruns++;
+      }
+    }
+    if (next != rx_tail) {
+      rx_buffer[head] = b;
+      MEMORY_BARRIER();
+      rx_head = next;
+    }
+    isr_latency::endSection(isr_latency::sections::SERIAL_RX_ISR);
+  }
+
   void waitUntilFlushed() {
     // Busy loop until all flushed to UART. 
     while (count) {
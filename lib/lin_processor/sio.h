@@ -16,12 +16,15 @@
 #include <arduino.h>
 #include "avr_util.h"
 
-// A serial output that uses hardware UART0 and no interrupts (for lower
-// interrupt jitter). Requires periodic calls to update() to send buffered
-// bytes to the uart. 
+// A serial port that uses hardware UART0. Output uses no interrupts (for
+// lower interrupt jitter) and requires periodic calls to loop() to send
+// buffered bytes to the uart. Input is buffered by a short RX interrupt
+// (USART_RX_vect, so Arduino's Serial cannot be linked in) in a
+// kRxQueueSize ring, which covers main loop passes that block for a while,
+// e.g. printing a long reply.
 //
 // TX Output - TXD (PD1) - pin 31
-// TX Input  - TXD (PD0) - pin 30 (currently not used).
+// RX Input  - RXD (PD0) - pin 30.
 namespace sio {
   
   // Call from main setup() and loop() respectivly.
@@ -40,6 +43,17 @@ namespace sio {
   extern void println();
   extern void printf(const __FlashStringHelper *format, ...);
   extern void printhex2(uint8 b); 
+
+  // Received bytes buffered until read(). Power of 2.
+  static const uint8 kRxQueueSize = 64;
+
+  // True if a received byte is ready to read().
+  extern boolean available();
+  // Call only when available() is true.
+  extern uint8 read();
+  // Number of received bytes lost because the RX ring was full, or the
+  // RX interrupt was held off too long. Saturates at 255.
+  extern uint8 rxOverruns();
  
   // Wait in a busy loop until all bytes were flushed to the UART. 
   // Avoid using this when possible. Useful when needing to print
@@ -22,9 +22,13 @@ namespace system_clock {
 
   static uint16 accounted_ticks = 0;
   static uint32 time_millis = 0;
+  static uint16 last_ticks = 0;
+  static uint32 time_ticks = 0;
 
   void loop() {
     const uint16 current_ticks = hardware_clock::ticksForNonIsr();
+    time_ticks += (uint16)(current_ticks - last_ticks);
+    last_ticks = current_ticks;
 
     // This 16 bit unsigned arithmetic works well also in case of a timer overflow.
     // Assuming at least two loops per timer cycle.
@@ -50,6 +54,23 @@ namespace system_clock {
     return time_millis;
   }
 
+  uint32 timeTicks() {
+    return time_ticks;
+  }
+
+  uint32 extendTicks(uint16 ticks) {
+    return time_ticks + (int16)(ticks - last_ticks);
+  }
+
+  uint32 extendMillis(uint16 ticks) {
+    // time_millis is the time of accounted_ticks.
+    const int16 delta = ticks - accounted_ticks;
+    if (delta >= 0) {
+      return time_millis + (uint16)delta / kTicksPerMilli;
+    }
+    return time_millis - ((uint16)-delta + kTicksPerMilli - 1) / kTicksPerMilli;
+  }
+
 }  // namespace system_clock
 
 
@@ -27,6 +27,17 @@ namespace system_clock {
   // Return time of last update() in millis since program start. Returns zero if update() was
   // never called. 
   extern uint32 timeMillis();
+
+  // Hardware clock ticks since program start as of the last loop(). Wraps
+  // every ~4.8 hours.
+  extern uint32 timeTicks();
+
+  // The timeTicks() time of a hardware clock value read less than ~130ms
+  // before or after the last loop(), e.g. a LinFrame timestamp.
+  extern uint32 extendTicks(uint16 ticks);
+
+  // Same for the timeMillis() time, rounded down.
+  extern uint32 extendMillis(uint16 ticks);
  
 }  // namespace system_clock
 
@@ -0,0 +1,179 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "text_io.h"
+
+#include "sio.h"
+
+namespace text_io {
+  // Writes the digits of value backwards, ending before end. Returns the
+  // first digit.
+  static char* formatDigitsBackwards(uint32 value, char* end) {
+    do {
+      *--end = (char)('0' + value % 10);
+      value /= 10;
+    } while (value);
+    return end;
+  }
+
+  // Moves the chars [from, end) to out and null terminates.
+  static uint8 moveTo(const char* from, const char* end, char* out) {
+    const uint8 n = end - from;
+    for (uint8 i = 0; i < n; i++) {
+      out[i] = from[i];
+    }
+    out[n] = '\0';
+    return n;
+  }
+
+  uint8 formatUint(uint32 value, char* out) {
+    char buffer[kMaxUintChars];
+    char* const end = buffer + sizeof(buffer);
+    return moveTo(formatDigitsBackwards(value, end), end, out);
+  }
+
+  uint8 formatInt(int32 value, char* out) {
+    if (value >= 0) {
+      return formatUint(value, out);
+    }
+    *out = '-';
+    // Negated as unsigned, also right for the most negative value.
+    return 1 + formatUint(-(uint32)value, out + 1);
+  }
+
+  uint8 formatHex(uint32 value, uint8 min_digits, char* out) {
+    char buffer[kMaxHexChars];
+    char* const end = buffer + sizeof(buffer) - 1;
+    char* p = end;
+    do {
+      const uint8 digit = value & 0xf;
+      *--p = (char)(digit < 10 ? '0' + digit : ('a' - 10) + digit);
+      value >>= 4;
+    } while (value);
+    while (end - p < min_digits && p > buffer) {
+      *--p = '0';
+    }
+    return moveTo(p, end, out);
+  }
+
+  uint8 formatFixed(int32 value, uint8 decimals, char* out) {
+    uint8 n = 0;
+    uint32 magnitude = value;
+    if (value < 0) {
+      out[n++] = '-';
+      magnitude = -(uint32)value;
+    }
+    char buffer[kMaxFixedChars];
+    char* const end = buffer + sizeof(buffer);
+    char* p = formatDigitsBackwards(magnitude, end);
+    // Leading zeros up to one integer digit, e.g. 5 with 2 decimals is 0.05.
+    while (end - p <= decimals) {
+      *--p = '0';
+    }
+    const uint8 num_integer = (end - p) - decimals;
+    for (uint8 i = 0; i < num_integer; i++) {
+      out[n++] = *p++;
+    }
+    if (decimals) {
+      out[n++] = '.';
+    }
+    return n + moveTo(p, end, out + n);
+  }
+
+  boolean parseUint16(const char* s, uint8 n, uint16* value) {
+    if (!n) {
+      return false;
+    }
+    uint32 result = 0;
+    for (uint8 i = 0; i < n; i++) {
+      const char c = s[i];
+      if (c < '0' || c > '9') {
+        return false;
+      }
+      result = result * 10 + (c - '0');
+      if (result > 0xffff) {
+        result = 0xffff;
+      }
+    }
+    *value = (uint16)result;
+    return true;
+  }
+
+  void printchar(char c) {
+    while (!sio::capacity()) {
+      sio::loop();
+    }
+    sio::printchar(c);
+  }
+
+  void print(const __FlashStringHelper* str) {
+    const char* PROGMEM p = (const char PROGMEM *)str;
+    for (;;) {
+      const char c = pgm_read_byte(p++);
+      if (!c) {
+        return;
+      }
+      printchar(c);
+    }
+  }
+
+  void print(const char* str) {
+    while (*str) {
+      printchar(*str++);
+    }
+  }
+
+  void println(const __FlashStringHelper* str) {
+    print(str);
+    println();
+  }
+
+  void println(const char* str) {
+    print(str);
+    println();
+  }
+
+  void println() {
+    printchar('\r');
+    printchar('\n');
+  }
+
+  void printUint(uint32 value) {
+    char buffer[kMaxUintChars];
+    formatUint(value, buffer);
+    print(buffer);
+  }
+
+  void printInt(int32 value) {
+    char buffer[kMaxIntChars];
+    formatInt(value, buffer);
+    print(buffer);
+  }
+
+  void printHex(uint32 value, uint8 min_digits) {
+    char buffer[kMaxHexChars];
+    formatHex(value, min_digits, buffer);
+    print(buffer);
+  }
+
+  void printFixed(int32 value, uint8 decimals) {
+    char buffer[kMaxFixedChars];
+    formatFixed(value, decimals, buffer);
+    print(buffer);
+  }
+
+  void write(const uint8* data, uint8 n) {
+    for (uint8 i = 0; i < n; i++) {
+      printchar(data[i]);
+    }
+  }
+}  // namespace text_io
@@ -0,0 +1,58 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TEXT_IO_H
+#define TEXT_IO_H
+
+#include <arduino.h>
+#include "avr_util.h"
+
+// Number formatting and parsing without heap allocation, and text output on
+// top of sio. Unlike sio::print*(), the print functions here wait for room
+// in the sio output buffer instead of dropping bytes, so they may block for
+// long texts.
+namespace text_io {
+  // Buffer sizes of the format functions, null terminator included.
+  static const uint8 kMaxUintChars = 11;
+  static const uint8 kMaxIntChars = 12;
+  static const uint8 kMaxHexChars = 9;
+  static const uint8 kMaxFixedChars = 13;
+
+  // The format functions write a null terminated string into out and
+  // return its length.
+  extern uint8 formatUint(uint32 value, char* out);
+  extern uint8 formatInt(int32 value, char* out);
+  // Lower case, zero padded to at least min_digits (at most 8).
+  extern uint8 formatHex(uint32 value, uint8 min_digits, char* out);
+  // value / 10^decimals with the given number of decimals (at most 9), e.g.
+  // (-1234, 2) -> "-12.34".
+  extern uint8 formatFixed(int32 value, uint8 decimals, char* out);
+
+  // Parses the n chars at s as a decimal number. Returns false if empty or
+  // not all digits. Values above 0xffff saturate.
+  extern boolean parseUint16(const char* s, uint8 n, uint16* value);
+
+  extern void printchar(char c);
+  extern void print(const __FlashStringHelper* str);
+  extern void print(const char* str);
+  extern void println(const __FlashStringHelper* str);
+  extern void println(const char* str);
+  extern void println();
+  extern void printUint(uint32 value);
+  extern void printInt(int32 value);
+  extern void printHex(uint32 value, uint8 min_digits);
+  extern void printFixed(int32 value, uint8 decimals);
+  // Raw bytes, e.g. binary packets.
+  extern void write(const uint8* data, uint8 n);
+}  // namespace text_io
+
+#endif
@@ -0,0 +1,39 @@
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# PlatformIO post build check: fails the build if the firmware links the heap
+# allocator, e.g. through Arduino String or new. The firmware formats with
+# text_io instead, 2KB of SRAM leave no room for a fragmented heap.
+
+import os
+import subprocess
+
+Import("env")
+
+HEAP_SYMBOLS = ("malloc", "free", "realloc", "calloc")
+
+
+def check_no_malloc(source, target, env):
+    elf = str(target[0])
+    nm = env.subst("$CC").replace("gcc", "nm")
+    output = subprocess.check_output([nm, "--defined-only", elf], env=env["ENV"])
+    symbols = set(line.split()[-1] for line in output.decode().splitlines() if line.strip())
+    linked = [s for s in HEAP_SYMBOLS if s in symbols]
+    if linked:
+        print("ERROR: heap functions linked into %s: %s" % (elf, ", ".join(linked)))
+        # Force a relink, and so this check, on the next build.
+        os.remove(elf)
+        return 1
+    return 0
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_no_malloc)
@@ -0,0 +1,123 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "buttons.h"
+
+namespace buttons {
+  static const uint8 kMask = kPortBMask | kPortDMask;
+  // Power of two.
+  static const uint8 kQueueSize = 8;
+
+  static uint16 last_sample_ticks;
+
+  // Debounced state and the vertical counter: bit i of count0 and count1 is
+  // the sample count of button bit i, reset while the sample equals the
+  // debounced state.
+  static uint8 state;
+  static uint8 count0;
+  static uint8 count1;
+
+  // Pressed buttons that had their LONG_PRESS.
+  static uint8 long_pressed;
+  // Press time of each button bit.
+  static uint32 press_millis[8];
+
+  static Event queue[kQueueSize];
+  static uint8 queue_head;
+  static uint8 queue_tail;
+  static uint16 dropped_events;
+
+  static void push(uint8 type, uint8 bit_index, uint32 now_millis) {
+    if ((uint8)(queue_head - queue_tail) >= kQueueSize) {
+      dropped_events++;
+      return;
+    }
+    Event& event = queue[queue_head & (kQueueSize - 1)];
+    event.type = type;
+    event.button = bitMask(bit_index);
+    event.millis = now_millis;
+    event.held_millis = 0;
+    if (type == events::RELEASE) {
+      const uint32 held = now_millis - press_millis[bit_index];
+      event.held_millis = held > 0xffff ? 0xffff : held;
+    }
+    queue_head++;
+  }
+
+  void setup() {
+    DDRB &= ~kPortBMask;
+    PORTB &= ~kPortBMask;
+    DDRD &= ~kPortDMask;
+    PORTD &= ~kPortDMask;
+    last_sample_ticks = hardware_clock::ticksForNonIsr();
+  }
+
+  void loop(uint16 now_ticks, uint32 now_millis) {
+    if ((uint16)(now_ticks - last_sample_ticks) < kSampleTicks) {
+      return;
+    }
+    last_sample_ticks = now_ticks;
+
+    const uint8 sample = ((PINB & kPortBMask) | (PIND & kPortDMask));
+    // Counts the samples that differ from the state, resets the others.
+    const uint8 delta = sample ^ state;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+    // Toggle where the counter rolled over from 3 to 0 after 4 samples.
+    const uint8 toggled = delta & ~(count0 | count1) & kMask;
+
+    if (toggled) {
+      state ^= toggled;
+      for (uint8 i = 0; i < 8; i++) {
+        const uint8 bit = bitMask(i);
+        if (!(toggled & bit)) {
+          continue;
+        }
+        if (state & bit) {
+          press_millis[i] = now_millis;
+          long_pressed &= ~bit;
+          push(events::PRESS, i, now_millis);
+        } else {
+          push(events::RELEASE, i, now_millis);
+        }
+      }
+    }
+
+    const uint8 waiting = state & ~long_pressed;
+    if (waiting) {
+      for (uint8 i = 0; i < 8; i++) {
+        const uint8 bit = bitMask(i);
+        if ((waiting & bit) && now_millis - press_millis[i] >= kLongPressMillis) {
+          long_pressed |= bit;
+          push(events::LONG_PRESS, i, now_millis);
+        }
+      }
+    }
+  }
+
+  boolean nextEvent(Event* event) {
+    if (queue_head == queue_tail) {
+      return false;
+    }
+    *event = queue[queue_tail & (kQueueSize - 1)];
+    queue_tail++;
+    return true;
+  }
+
+  uint8 pressed() {
+    return state;
+  }
+
+  uint16 droppedEvents() {
+    return dropped_events;
+  }
+}  // namespace buttons
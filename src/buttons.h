@@ -0,0 +1,79 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include "avr_util.h"
+#include "hardware_clock.h"
+
+// Port level button input. Every kSampleTicks of the hardware clock, loop()
+// reads PINB and PIND once and debounces all buttons in parallel with a two
+// bit vertical counter: a button changes state after four equal samples
+// (15 to 20 ms). The changes are queued as timestamped events.
+//
+// Sampled from the main loop, not from a timer ISR, so that the LIN ISRs
+// get no extra latency. A loop slower than kSampleTicks only slows the
+// sampling down.
+//
+// The buttons are active high, without pull-ups.
+namespace buttons {
+  // Button bits: the bit of the pin in PINB or in PIND. The buttons of the
+  // two ports must not use the same bit.
+  static const uint8 kUp = H(PD3);
+  static const uint8 kMemory1 = H(PD5);
+  static const uint8 kMemory2 = H(PD6);
+  // Arduino pin 8.
+  static const uint8 kDown = H(PB0);
+
+  static const uint8 kPortBMask = kDown;
+  static const uint8 kPortDMask = kUp | kMemory1 | kMemory2;
+  static_assert(!(kPortBMask & kPortDMask), "Button bits of PINB and PIND overlap");
+
+  static const uint16 kSampleTicks = 5 * hardware_clock::kTicksPerMilli;
+  static const uint16 kLongPressMillis = 1000;
+
+  // Like enum but 8 bits only.
+  namespace events {
+    static const uint8 PRESS = 1;
+    // Once per press, when held for kLongPressMillis.
+    static const uint8 LONG_PRESS = 2;
+    static const uint8 RELEASE = 3;
+  }
+
+  struct Event {
+    uint8 type;
+    // One button bit.
+    uint8 button;
+    // Time of the sample that completed the debounce.
+    uint32 millis;
+    // RELEASE: how long the button was held, saturated.
+    uint16 held_millis;
+  };
+
+  // Sets the pins as inputs.
+  extern void setup();
+
+  // Call from the main loop.
+  extern void loop(uint16 now_ticks, uint32 now_millis);
+
+  // Returns false if no event is queued.
+  extern boolean nextEvent(Event* event);
+
+  // Debounced pressed buttons.
+  extern uint8 pressed();
+
+  // Events dropped because the queue was full.
+  extern uint16 droppedEvents();
+}  // namespace buttons
+
+#endif
@@ -0,0 +1,94 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "coast_estimator.h"
+
+#include "settings_store.h"
+
+namespace coast_estimator {
+  // Indexed by direction - 1.
+  static uint16 coast[2];
+  static uint16 coast_speed[2];
+
+  static inline boolean isDirection(uint8 direction) {
+    return direction == 1 || direction == 2;
+  }
+
+  // Running estimate with a 1/4 weight for the new sample. Returns true if
+  // the estimate changed.
+  static boolean update(uint16* estimate, uint16 sample) {
+    const int32 delta = ((int32)sample - (int32)*estimate) / 4;
+    *estimate += delta;
+    return delta != 0;
+  }
+
+  void setup(uint16 default_coast) {
+    const settings_store::Settings& settings = settings_store::settings();
+    for (uint8 i = 0; i < 2; i++) {
+      coast[i] = settings.coast[i];
+      coast_speed[i] = settings.coast_speed[i];
+      if (coast[i] > kMaxCoast) {
+        // 0xffff if never stored.
+        coast[i] = default_coast < kMaxCoast ? default_coast : kMaxCoast;
+        coast_speed[i] = 0;
+      } else if (coast_speed[i] == 0xffff) {
+        // Stored before the speed was.
+        coast_speed[i] = 0;
+      }
+    }
+  }
+
+  uint16 coastDistance(uint8 direction, int16 speed) {
+    if (!isDirection(direction)) {
+      return 0;
+    }
+    const uint16 estimate = coast[direction - 1];
+    const uint16 reference = coast_speed[direction - 1];
+    if (!reference) {
+      return estimate;
+    }
+    if (speed <= 0) {
+      return 0;
+    }
+    const uint32 scaled = (uint32)estimate * (uint16)speed / reference * (uint16)speed / reference;
+    return scaled < kMaxCoast ? scaled : kMaxCoast;
+  }
+
+  uint16 learnedCoast(uint8 direction) {
+    return isDirection(direction) ? coast[direction - 1] : 0;
+  }
+
+  uint16 learnedSpeed(uint8 direction) {
+    return isDirection(direction) ? coast_speed[direction - 1] : 0;
+  }
+
+  void learn(uint8 direction, uint16 actual_coast, int16 cut_speed) {
+    if (!isDirection(direction) || cut_speed < kMinLearnSpeed) {
+      return;
+    }
+    if (actual_coast > kMaxCoast) {
+      actual_coast = kMaxCoast;
+    }
+    const uint8 i = direction - 1;
+    if (!coast_speed[i]) {
+      // First sample, the default coast was not measured at any speed.
+      coast[i] = actual_coast;
+      coast_speed[i] = cut_speed;
+    } else if (!(update(&coast[i], actual_coast) | update(&coast_speed[i], cut_speed))) {
+      return;
+    }
+    settings_store::Settings settings = settings_store::settings();
+    settings.coast[i] = coast[i];
+    settings.coast_speed[i] = coast_speed[i];
+    settings_store::save(settings);
+  }
+}  // namespace coast_estimator
@@ -0,0 +1,53 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COAST_ESTIMATOR_H
+#define COAST_ESTIMATOR_H
+
+#include "avr_util.h"
+
+// The table keeps moving for a while after the motor is cut (coast), by a
+// different distance up and down. Keeps a per direction running estimate of
+// that distance and of the speed at the cut, learned from the completed
+// moves and kept in the settings_store. The table brakes at a roughly
+// constant rate, so the coast of a slower move scales with the square of
+// its speed.
+namespace coast_estimator {
+  // Learned coast distances are clamped to this.
+  static const uint16 kMaxCoast = 600;
+
+  // Moves cut slower than this (units/s) are not learned from.
+  static const int16 kMinLearnSpeed = 20;
+
+  // Fixed EEPROM address of the four uint16 values of older firmware:
+  // coast up, coast down, speed at the cut up, speed at the cut down.
+  static const int kLegacyEepromAddress = 5;
+
+  // Loads the estimates from the settings_store. Directions without one
+  // start at default_coast, for any speed.
+  extern void setup(uint16 default_coast);
+
+  // Predicted coast distance when cutting at the given speed (units/s in the
+  // move direction). direction is motion::kUp or motion::kDown.
+  extern uint16 coastDistance(uint8 direction, int16 speed);
+
+  // The learned estimate of a direction and the speed it applies to, 0 if
+  // not learned yet.
+  extern uint16 learnedCoast(uint8 direction);
+  extern uint16 learnedSpeed(uint8 direction);
+
+  // Updates the estimate of a direction with a measured coast distance and
+  // the speed at the cut.
+  extern void learn(uint8 direction, uint16 actual_coast, int16 cut_speed);
+}  // namespace coast_estimator
+
+#endif
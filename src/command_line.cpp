@@ -0,0 +1,158 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "command_line.h"
+
+#include "text_io.h"
+
+namespace command_line {
+  // Current line, upper case. Not null terminated.
+  static char line[kMaxLineLength];
+  static uint8 line_length;
+  // True if the current line exceeded kMaxLineLength. The rest of it is
+  // dropped and it parses as INVALID.
+  static boolean line_overflow;
+  static uint32 last_byte_millis;
+
+  // Parses line[start..line_length) as a decimal number. Returns false if
+  // empty or not all digits.
+  static boolean parseNumber(uint8 start, uint16* value) {
+    return start < line_length &&
+        text_io::parseUint16(line + start, line_length - start, value);
+  }
+
+  // Index of the first c in line[start..line_length), line_length if none.
+  static uint8 findChar(uint8 start, char c) {
+    while (start < line_length && line[start] != c) {
+      start++;
+    }
+    return start;
+  }
+
+  // Parses line[start..end) as a preset number. Too large numbers become
+  // 0, which is no preset either.
+  static boolean parsePreset(uint8 start, uint8 end, uint8* preset) {
+    uint16 number;
+    if (start >= end || !text_io::parseUint16(line + start, end - start, &number)) {
+      return false;
+    }
+    *preset = number > 0xff ? 0 : number;
+    return true;
+  }
+
+  // M<k>, M<k>=<n> and M<d><n>. Positions have at least three digits, so
+  // M followed by four or more digits is the one digit preset form.
+  static void parsePresetCommand(Command* command) {
+    const uint8 equals = findChar(1, '=');
+    if (equals < line_length) {
+      if (parsePreset(1, equals, &command->preset) && parseNumber(equals + 1, &command->value)) {
+        command->id = commands::SET_PRESET;
+      }
+    } else if (line_length >= 5) {
+      if (parsePreset(1, 2, &command->preset) && parseNumber(2, &command->value)) {
+        command->id = commands::SET_PRESET;
+      }
+    } else if (parsePreset(1, line_length, &command->preset)) {
+      command->id = commands::MOVE_TO_PRESET;
+    }
+  }
+
+  static boolean lineEquals(const char* text) {
+    uint8 i = 0;
+    for (; i < line_length; i++) {
+      if (line[i] != text[i]) {
+        return false;
+      }
+    }
+    return text[i] == '\0';
+  }
+
+  static void parseLine(Command* command) {
+    command->id = commands::INVALID;
+    command->preset = 0;
+    command->value = 0;
+    if (line_overflow) {
+      return;
+    }
+    if (lineEquals("HELP")) {
+      command->id = commands::HELP;
+    } else if (lineEquals("VALUES")) {
+      command->id = commands::VALUES;
+    } else if (lineEquals("STOP")) {
+      command->id = commands::STOP;
+    } else if (lineEquals("TASKS")) {
+      command->id = commands::TASKS;
+    } else if (lineEquals("LOOP")) {
+      command->id = commands::LOOP_TIMES;
+    } else if (lineEquals("ISR")) {
+      command->id = commands::ISR_TIMES;
+    } else if (lineEquals("LATENCY")) {
+      command->id = commands::ISR_LATENCY;
+    } else if (lineEquals("BUS")) {
+      command->id = commands::BUS_STATS;
+    } else if (lineEquals("TRACE")) {
+      command->id = commands::TRACE;
+    } else if (line[0] == 'S') {
+      if (parsePreset(1, line_length, &command->preset)) {
+        command->id = commands::STORE_PRESET;
+      }
+    } else if (line[0] == 'M') {
+      parsePresetCommand(command);
+    } else if (line[0] == 'T') {
+      if (parseNumber(1, &command->value)) {
+        command->id = commands::SET_THRESHOLD;
+      }
+    } else if (parseNumber(0, &command->value)) {
+      command->id = commands::MOVE_TO;
+    }
+  }
+
+  // Parses and clears the current line. Returns false if it was empty.
+  static boolean endLine(Command* command) {
+    if (!line_length && !line_overflow) {
+      return false;
+    }
+    parseLine(command);
+    line_length = 0;
+    line_overflow = false;
+    return true;
+  }
+
+  boolean handleByte(char c, uint32 now_millis, Command* command) {
+    last_byte_millis = now_millis;
+    if (c == '\r' || c == '\n') {
+      return endLine(command);
+    }
+    if (c == ' ' || c == '\t') {
+      return false;
+    }
+    if (line_length >= kMaxLineLength) {
+      line_overflow = true;
+      return false;
+    }
+    if (c >= 'a' && c <= 'z') {
+      c -= 'a' - 'A';
+    }
+    line[line_length++] = c;
+    return false;
+  }
+
+  boolean handleIdle(uint32 now_millis, Command* command) {
+    if (!line_length && !line_overflow) {
+      return false;
+    }
+    if ((now_millis - last_byte_millis) < kIdleMillis) {
+      return false;
+    }
+    return endLine(command);
+  }
+}  // namespace command_line
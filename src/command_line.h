@@ -0,0 +1,77 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include "avr_util.h"
+
+// Non blocking serial command parser. Bytes are fed one at a time as they
+// arrive and a command is returned when a line is complete. Lines end with
+// CR or LF, or after kIdleMillis without input for terminals that send no
+// line ending. Case insensitive. No heap allocation.
+//
+//   HELP, VALUES, STOP, TASKS, LOOP, ISR, LATENCY, BUS, TRACE
+//   T<n>      set the threshold
+//   M<k>      move to memory preset k
+//   M<k>=<n>  set memory preset k to position n
+//   M<d><n>   the same for a one digit preset d, n of three digits or
+//             more (M15000 sets preset 1 to 5000)
+//   S<k>      store the current position in memory preset k
+//   <n>       move to position n
+//
+// Preset numbers are not range checked here.
+namespace command_line {
+  // Like enum but 8 bits only.
+  namespace commands {
+    static const uint8 HELP = 1;
+    static const uint8 VALUES = 2;
+    static const uint8 STOP = 3;
+    static const uint8 SET_THRESHOLD = 4;
+    static const uint8 MOVE_TO_PRESET = 5;
+    static const uint8 SET_PRESET = 6;
+    static const uint8 STORE_PRESET = 7;
+    static const uint8 MOVE_TO = 8;
+    static const uint8 TASKS = 9;
+    static const uint8 LOOP_TIMES = 10;
+    static const uint8 ISR_TIMES = 11;
+    static const uint8 ISR_LATENCY = 12;
+    static const uint8 BUS_STATS = 13;
+    static const uint8 TRACE = 14;
+    // Unknown command, bad number or a too long line.
+    static const uint8 INVALID = 15;
+  }
+
+  struct Command {
+    uint8 id;
+    // The preset number of the *_PRESET commands.
+    uint8 preset;
+    // The number argument, if any. Saturates at 0xffff.
+    uint16 value;
+  };
+
+  // Longest accepted line, excluding the line ending.
+  static const uint8 kMaxLineLength = 15;
+
+  // A line without line ending is complete after this time without input.
+  static const uint16 kIdleMillis = 50;
+
+  // Handle one received byte. Returns true and sets *command when it
+  // completes a non empty line.
+  extern boolean handleByte(char c, uint32 now_millis, Command* command);
+
+  // Call when no byte was received. Returns true and sets *command when a
+  // pending line without line ending timed out.
+  extern boolean handleIdle(uint32 now_millis, Command* command);
+}  // namespace command_line
+
+#endif
@@ -0,0 +1,116 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "desk_protocol.h"
+
+namespace desk_protocol {
+  uint8_t crc8(const uint8_t* data, uint8_t n) {
+    uint8_t crc = 0;
+    while (n--) {
+      crc ^= *data++;
+      for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+      }
+    }
+    return crc;
+  }
+
+  uint8_t cobsEncode(const uint8_t* in, uint8_t n, uint8_t* out) {
+    // Each zero is replaced by the distance to the next one. The first
+    // byte is the distance to the first zero. Packets are short, a single
+    // block is enough.
+    uint8_t code_index = 0;
+    uint8_t out_index = 1;
+    uint8_t code = 1;
+    for (uint8_t i = 0; i < n; i++) {
+      if (in[i] == 0) {
+        out[code_index] = code;
+        code_index = out_index++;
+        code = 1;
+      } else {
+        out[out_index++] = in[i];
+        code++;
+      }
+    }
+    out[code_index] = code;
+    return out_index;
+  }
+
+  uint8_t cobsDecode(const uint8_t* in, uint8_t n, uint8_t* out) {
+    uint8_t in_index = 0;
+    uint8_t out_index = 0;
+    while (in_index < n) {
+      const uint8_t code = in[in_index++];
+      if (code == 0 || in_index + code - 1 > n) {
+        return 0;
+      }
+      for (uint8_t i = 1; i < code; i++) {
+        out[out_index++] = in[in_index++];
+      }
+      // The zero implied by the code, except after the last block.
+      if (code < 0xff && in_index < n) {
+        out[out_index++] = 0;
+      }
+    }
+    return out_index;
+  }
+
+  uint8_t encodePacket(uint8_t type, const uint8_t* body, uint8_t body_length,
+      uint8_t* out) {
+    if (body_length > kMaxBody) {
+      return 0;
+    }
+    uint8_t packet[kMaxPacket];
+    packet[0] = type;
+    for (uint8_t i = 0; i < body_length; i++) {
+      packet[1 + i] = body[i];
+    }
+    packet[1 + body_length] = crc8(packet, 1 + body_length);
+    out[0] = 0;
+    const uint8_t n = cobsEncode(packet, body_length + 2, out + 1);
+    out[1 + n] = 0;
+    return n + 2;
+  }
+
+  PacketReader::PacketReader()
+    : length_(0),
+      packet_length_(0),
+      overflow_(false),
+      bad_packets_(0) {
+  }
+
+  bool PacketReader::handleByte(uint8_t b) {
+    if (b != 0) {
+      if (length_ < sizeof(packet_)) {
+        packet_[length_++] = b;
+      } else {
+        overflow_ = true;
+      }
+      return false;
+    }
+
+    // Delimiter. Empty runs are the leading delimiter of a packet.
+    const uint8_t length = length_;
+    const bool overflow = overflow_;
+    length_ = 0;
+    overflow_ = false;
+    if (!length && !overflow) {
+      return false;
+    }
+    packet_length_ = overflow ? 0 : cobsDecode(packet_, length, packet_);
+    if (packet_length_ < 2 || crc8(packet_, packet_length_ - 1) != packet_[packet_length_ - 1]) {
+      bad_packets_++;
+      return false;
+    }
+    return true;
+  }
+}  // namespace desk_protocol
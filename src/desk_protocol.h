@@ -0,0 +1,148 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DESK_PROTOCOL_H
+#define DESK_PROTOCOL_H
+
+#include <stdint.h>
+
+// Binary serial protocol between the desk controller and a host.
+//
+// A packet is [type][body...][crc8], COBS encoded and sent between two 0x00
+// delimiters. The CRC is CRC-8/CCITT (polynomial 0x07, initial 0) over type
+// and body. Multi byte values are little endian. Bytes outside of packets
+// (e.g. text lines) fail the CRC and are dropped by the receiver.
+//
+// The controller starts in text mode (see command_line.h) and switches to
+// binary mode when it receives a 0x00 byte. The TEXT_MODE request switches
+// back.
+//
+// Shared by the firmware and the host client, no Arduino dependencies.
+namespace desk_protocol {
+  // Packet types. Requests from the host have the high bit set.
+  namespace messages {
+    // Controller to host.
+    // position u16, speed i16 (units per second, positive is up).
+    static const uint8_t POSITION = 0x01;
+    // position u16, target u16, memory 1 u16, memory 2 u16, threshold u8,
+    // direction u8 (0 stopped, 1 up, 2 down), speed i16. Also sent when the
+    // table starts or stops moving.
+    static const uint8_t STATUS = 0x02;
+    // LIN error flags u8, see lin_processor.h. Sent when errors occur.
+    static const uint8_t LIN_ERRORS = 0x03;
+    // LinFrame flags u8, frame bytes (id, data, checksum).
+    static const uint8_t LIN_FRAME = 0x04;
+    // request type u8, result u8 (see results).
+    static const uint8_t ACK = 0x05;
+    // slot u8, position u16. Reply to GET_MEMORY.
+    static const uint8_t MEMORY = 0x06;
+    // offset u16, bytes of the LIN trace block (see lin_trace_format.h).
+    // Reply to TRACE_DUMP, in offset order.
+    static const uint8_t TRACE_DATA = 0x07;
+
+    // Host to controller. Answered with ACK, or with STATUS for GET_STATUS.
+    static const uint8_t GET_STATUS = 0x81;
+    // position u16.
+    static const uint8_t MOVE_TO = 0x82;
+    static const uint8_t STOP = 0x83;
+    // slot u8 (1 to the number of presets, 8 by default), position u16.
+    static const uint8_t SET_MEMORY = 0x84;
+    // slot u8. Stores the current position.
+    static const uint8_t STORE_MEMORY = 0x85;
+    // slot u8.
+    static const uint8_t MOVE_TO_MEMORY = 0x86;
+    // threshold u8.
+    static const uint8_t SET_THRESHOLD = 0x87;
+    // enable u8. Streams the received LIN frames as LIN_FRAME.
+    static const uint8_t SET_LIN_DUMP = 0x88;
+    static const uint8_t TEXT_MODE = 0x89;
+    // slot u8. Answered with MEMORY, or ACK if the slot is not valid.
+    static const uint8_t GET_MEMORY = 0x8a;
+    // triggers u8, id u8, position jump u16, post trigger percent u8. Clears
+    // and restarts the LIN trace recorder, see lin_trace.h.
+    static const uint8_t TRACE_ARM = 0x8b;
+    // Stops the LIN trace recorder and sends the whole block as TRACE_DATA
+    // packets, then the ACK.
+    static const uint8_t TRACE_DUMP = 0x8c;
+  }
+
+  // ACK results.
+  namespace results {
+    static const uint8_t OK = 0;
+    static const uint8_t OUT_OF_RANGE = 1;
+    static const uint8_t BAD_REQUEST = 2;
+  }
+
+  // Max decoded packet size: type, body and crc.
+  static const uint8_t kMaxPacket = 16;
+  static const uint8_t kMaxBody = kMaxPacket - 2;
+  // Max packet size on the wire: delimiters and COBS overhead included.
+  static const uint8_t kMaxWirePacket = kMaxPacket + 3;
+
+  extern uint8_t crc8(const uint8_t* data, uint8_t n);
+
+  // COBS encodes n < 254 bytes. out needs n + 1 bytes. Returns the encoded
+  // length.
+  extern uint8_t cobsEncode(const uint8_t* in, uint8_t n, uint8_t* out);
+
+  // COBS decodes n bytes, in place is ok. Returns the decoded length, or 0
+  // if malformed.
+  extern uint8_t cobsDecode(const uint8_t* in, uint8_t n, uint8_t* out);
+
+  // Builds a wire packet in out, which needs kMaxWirePacket bytes. Returns
+  // its length, or 0 if the body is longer than kMaxBody.
+  extern uint8_t encodePacket(uint8_t type, const uint8_t* body, uint8_t body_length,
+      uint8_t* out);
+
+  // Collects received bytes into packets.
+  class PacketReader {
+   public:
+    PacketReader();
+
+    // Handle one received byte. Returns true when it completes a packet
+    // with a good CRC. The packet is then available until the next call.
+    bool handleByte(uint8_t b);
+
+    uint8_t type() const {
+      return packet_[0];
+    }
+    const uint8_t* body() const {
+      return packet_ + 1;
+    }
+    uint8_t body_length() const {
+      return packet_length_ - 2;
+    }
+
+    // Non empty byte runs between delimiters that were not valid packets.
+    uint16_t bad_packets() const {
+      return bad_packets_;
+    }
+
+   private:
+    uint8_t packet_[kMaxPacket + 1];
+    uint8_t length_;
+    uint8_t packet_length_;
+    bool overflow_;
+    uint16_t bad_packets_;
+  };
+
+  inline uint16_t getU16(const uint8_t* p) {
+    return p[0] | ((uint16_t)p[1] << 8);
+  }
+
+  inline void putU16(uint8_t* p, uint16_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+  }
+}  // namespace desk_protocol
+
+#endif
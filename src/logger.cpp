@@ -0,0 +1,134 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "logger.h"
+
+#include "sio.h"
+#include "system_clock.h"
+#include "text_io.h"
+
+namespace logger {
+  // Min time between two lines of a class, per class.
+  static const uint16 kMinIntervalMillis[classes::kCount] PROGMEM = {
+    0,                                          // MOTION
+    custom_defs::kLogPositionIntervalMillis,    // POSITION
+    100,                                        // BUTTONS
+    0,                                          // SETTINGS
+    1000,                                       // LIN
+  };
+
+  static uint32 last_line_millis[classes::kCount];
+  // Zero when the class never logged, its first line is never limited.
+  static uint8 logged_classes;
+
+  static char line[kMaxLineLength + 2];
+  static uint8 line_length;
+  static boolean in_line;
+  static boolean muted;
+
+  static uint16 dropped_lines;
+  static uint16 rate_limited_lines;
+
+  static inline void countUp(uint16* counter) {
+    if (*counter < 0xffff) {
+      (*counter)++;
+    }
+  }
+
+  boolean beginLine(uint8 message_class) {
+    if (in_line || muted) {
+      return false;
+    }
+    const uint32 now = system_clock::timeMillis();
+    const uint8 class_bit = H(message_class);
+    const uint16 min_interval = pgm_read_word(&kMinIntervalMillis[message_class]);
+    if ((logged_classes & class_bit) &&
+        (now - last_line_millis[message_class]) < min_interval) {
+      countUp(&rate_limited_lines);
+      return false;
+    }
+    logged_classes |= class_bit;
+    last_line_millis[message_class] = now;
+    line_length = 0;
+    in_line = true;
+    return true;
+  }
+
+  static inline void append(char c) {
+    if (line_length < kMaxLineLength) {
+      line[line_length++] = c;
+    }
+  }
+
+  void print(const __FlashStringHelper* str) {
+    const char* PROGMEM p = (const char PROGMEM *)str;
+    for (;;) {
+      const char c = pgm_read_byte(p++);
+      if (!c) {
+        return;
+      }
+      append(c);
+    }
+  }
+
+  void print(const char* str) {
+    while (*str) {
+      append(*str++);
+    }
+  }
+
+  void printUint(uint32 value) {
+    char buffer[text_io::kMaxUintChars];
+    text_io::formatUint(value, buffer);
+    print(buffer);
+  }
+
+  void printInt(int32 value) {
+    char buffer[text_io::kMaxIntChars];
+    text_io::formatInt(value, buffer);
+    print(buffer);
+  }
+
+  void printHex(uint32 value, uint8 min_digits) {
+    char buffer[text_io::kMaxHexChars];
+    text_io::formatHex(value, min_digits, buffer);
+    print(buffer);
+  }
+
+  void end() {
+    if (!in_line) {
+      return;
+    }
+    in_line = false;
+    line[line_length++] = '\r';
+    line[line_length++] = '\n';
+    if (sio::capacity() < line_length) {
+      countUp(&dropped_lines);
+      return;
+    }
+    for (uint8 i = 0; i < line_length; i++) {
+      sio::printchar(line[i]);
+    }
+  }
+
+  void setMuted(boolean is_muted) {
+    muted = is_muted;
+  }
+
+  uint16 droppedLines() {
+    return dropped_lines;
+  }
+
+  uint16 rateLimitedLines() {
+    return rate_limited_lines;
+  }
+}  // namespace logger
@@ -0,0 +1,84 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <arduino.h>
+#include "avr_util.h"
+#include "custom_defs.h"
+
+// Application log over the interrupt free sio output queue. Each line is
+// built in a small buffer and queued as a whole, or dropped and counted if
+// the queue has no room for it, so logging never blocks the loop and never
+// leaves half lines. Lines of a message class are rate limited to one per
+// the class interval. Levels above LOG_LEVEL compile to nothing.
+//
+//   if (logger::begin(logger::levels::INFO, logger::classes::POSITION)) {
+//     logger::print(F("Position: "));
+//     logger::printUint(position);
+//     logger::end();
+//   }
+//
+// Replies to commands (HELP, VALUES) are not logs, print them with text_io.
+namespace logger {
+  // Like enum but 8 bits only.
+  namespace levels {
+    static const uint8 ERROR = LOG_LEVEL_ERROR;
+    static const uint8 WARN = LOG_LEVEL_WARN;
+    static const uint8 INFO = LOG_LEVEL_INFO;
+    static const uint8 DEBUG = LOG_LEVEL_DEBUG;
+  }
+
+  // Message classes, each with its own rate limit (see logger.cpp).
+  namespace classes {
+    static const uint8 MOTION = 0;
+    static const uint8 POSITION = 1;
+    static const uint8 BUTTONS = 2;
+    static const uint8 SETTINGS = 3;
+    static const uint8 LIN = 4;
+    static const uint8 kCount = 5;
+  }
+
+  // Longest line, without the line ending. Longer lines are truncated.
+  static const uint8 kMaxLineLength = 40;
+
+  // Starts a line. Returns false, and the line must not be continued, if
+  // the class is rate limited or a line was not ended.
+  extern boolean beginLine(uint8 message_class);
+
+  // Starts a line of the given level. Constant false for levels above
+  // LOG_LEVEL so the calling code is dropped by the compiler.
+  static inline boolean begin(uint8 level, uint8 message_class) {
+    return level <= LOG_LEVEL && beginLine(message_class);
+  }
+
+  extern void print(const __FlashStringHelper* str);
+  extern void print(const char* str);
+  extern void printUint(uint32 value);
+  extern void printInt(int32 value);
+  extern void printHex(uint32 value, uint8 min_digits);
+
+  // Queues the line, or drops it if the sio queue is too full.
+  extern void end();
+
+  // While muted no line is started, e.g. while the serial port carries
+  // binary packets.
+  extern void setMuted(boolean muted);
+
+  // Lines dropped because the sio queue was full.
+  extern uint16 droppedLines();
+  // Lines suppressed by the rate limits.
+  extern uint16 rateLimitedLines();
+}  // namespace logger
+
+#endif
@@ -0,0 +1,70 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "loop_profiler.h"
+
+#if LOOP_PROFILER
+
+namespace loop_profiler {
+  namespace loop_profiler_private {
+    const uint8 kLog2Nibble[] PROGMEM = {
+      0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+    };
+    uint16 last_ticks;
+    uint16 max_ticks;
+    uint16 counts[kNumBuckets];
+
+    void halveCounts() {
+      for (uint8 i = 0; i < kNumBuckets; i++) {
+        counts[i] >>= 1;
+      }
+    }
+  }
+
+  using namespace loop_profiler_private;
+
+  void reset() {
+    for (uint8 i = 0; i < kNumBuckets; i++) {
+      counts[i] = 0;
+    }
+    max_ticks = 0;
+    skipIteration();
+  }
+
+  uint16 maxTicks() {
+    return max_ticks;
+  }
+
+  uint16 bucketCount(uint8 bucket) {
+    return counts[bucket];
+  }
+
+  uint16 percentileTicks(uint16 permille) {
+    uint32 total = 0;
+    for (uint8 i = 0; i < kNumBuckets; i++) {
+      total += counts[i];
+    }
+    // Rounded up: the smallest count that covers the fraction.
+    const uint32 wanted = (total * permille + 999) / 1000;
+    uint32 sum = 0;
+    for (uint8 i = 0; i < kNumBuckets; i++) {
+      sum += counts[i];
+      if (sum >= wanted && sum) {
+        const uint16 upper = (uint16)((2UL << i) - 1);
+        return upper < max_ticks ? upper : max_ticks;
+      }
+    }
+    return max_ticks;
+  }
+}  // namespace loop_profiler
+
+#endif
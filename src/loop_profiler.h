@@ -0,0 +1,86 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include "avr_util.h"
+#include "custom_defs.h"
+#include "hardware_clock.h"
+
+// Histogram of the main loop iteration times, the latency between a
+// position frame and the relay change it causes. mark() at the start of
+// each iteration adds the hardware clock ticks since the previous one to
+// a log2 bucket: bucket k counts [2^k, 2^(k+1)) ticks, bucket 0 also
+// counts 0. About 30 cycles per iteration. With LOOP_PROFILER 0 (see
+// custom_defs.h) mark() compiles to nothing.
+namespace loop_profiler {
+  static const uint8 kNumBuckets = 16;
+
+  // Private data. Do not use from other modules.
+  namespace loop_profiler_private {
+    extern const uint8 kLog2Nibble[] PROGMEM;
+    extern uint16 last_ticks;
+    extern uint16 max_ticks;
+    extern uint16 counts[kNumBuckets];
+    // Halves all counts, keeping the shape of the histogram.
+    extern void halveCounts();
+  }
+
+  // Call at the start of each loop() iteration.
+  static inline void mark() {
+#if LOOP_PROFILER
+    using namespace loop_profiler_private;
+    const uint16 now = hardware_clock::ticksForNonIsr();
+    const uint16 ticks = now - last_ticks;
+    last_ticks = now;
+    if (ticks > max_ticks) {
+      max_ticks = ticks;
+    }
+    const uint8 high = ticks >> 8;
+    const uint8 low = ticks;
+    uint8 bucket;
+    if (high >= 16) {
+      bucket = 12 + pgm_read_byte(&kLog2Nibble[high >> 4]);
+    } else if (high) {
+      bucket = 8 + pgm_read_byte(&kLog2Nibble[high]);
+    } else if (low >= 16) {
+      bucket = 4 + pgm_read_byte(&kLog2Nibble[low >> 4]);
+    } else {
+      bucket = pgm_read_byte(&kLog2Nibble[low]);
+    }
+    if (++counts[bucket] == 0xffff) {
+      halveCounts();
+    }
+#endif
+  }
+
+  // Leaves the current iteration out, e.g. after printing a long reply.
+  static inline void skipIteration() {
+#if LOOP_PROFILER
+    loop_profiler_private::last_ticks = hardware_clock::ticksForNonIsr();
+#endif
+  }
+
+  // Clears the histogram and skips the current iteration.
+  extern void reset();
+
+  extern uint16 maxTicks();
+
+  extern uint16 bucketCount(uint8 bucket);
+
+  // Upper bound, in ticks, of the iteration times of the given fraction
+  // (in 1/1000) of the iterations. Bucket resolution, capped at the max.
+  extern uint16 percentileTicks(uint16 permille);
+}  // namespace loop_profiler
+
+#endif
@@ -12,305 +12,1006 @@
 
 #include <Arduino.h>
 #include "avr_util.h"
+#include "buttons.h"
+#include "coast_estimator.h"
+#include "command_line.h"
 #include "custom_defs.h"
+#include "desk_protocol.h"
 #include "hardware_clock.h"
 #include "io_pins.h"
+#include "isr_latency.h"
+#include "isr_profiler.h"
 #include "lin_processor.h"
+#include "lin_stats.h"
+#include "lin_trace.h"
+#include "logger.h"
+#include "loop_profiler.h"
+#include "motion.h"
+#include "position_tracker.h"
+#include "presets.h"
+#include "scheduler.h"
+#include "settings_store.h"
+#include "sio.h"
 #include "system_clock.h"
+#include "text_io.h"
 #include <EEPROM.h>
 
 
 uint16_t lastPosition = 0;
-uint16_t memOne = 0;
-uint16_t memTwo = 0;
 
-uint16_t currentTarget = 0;
-uint8_t initializedTarget = false;
 uint8_t targetThreshold = 0;
-uint8_t currentTableMovement = 0;
 
 
 const int moveTableUpPin = PD4;
 const int moveTableDownPin = PD7;
 
-const int moveUpButton = PD3;
-const int moveM2Button = PD6;
-const int moveM1Button = PD5;
-const int moveDownButton = 8;
+// What the buttons do, in table order: the first one pressed wins the jog.
+// A jog button moves the table while held. A preset button moves to its
+// preset on a short press and stores the position on a long one.
+struct ButtonBinding {
+  // A buttons::kX bit.
+  uint8_t button;
+  // motion::kUp or motion::kDown, motion::kStop for preset buttons.
+  uint8_t jog;
+  // Preset number, 0 for jog buttons.
+  uint8_t preset;
+};
+
+const ButtonBinding kButtons[] PROGMEM = {
+  { buttons::kUp, motion::kUp, 0 },
+  { buttons::kMemory1, motion::kStop, 1 },
+  { buttons::kMemory2, motion::kStop, 2 },
+  { buttons::kDown, motion::kDown, 0 },
+};
+
+static inline uint8_t buttonBit(uint8_t index) {
+  return pgm_read_byte(&kButtons[index].button);
+}
+
+static inline uint8_t buttonJog(uint8_t index) {
+  return pgm_read_byte(&kButtons[index].jog);
+}
+
+static inline uint8_t buttonPreset(uint8_t index) {
+  return pgm_read_byte(&kButtons[index].preset);
+}
+
+// Index in kButtons of a button bit, ARRAY_SIZE(kButtons) if not bound.
+static uint8_t buttonIndex(uint8_t button) {
+  uint8_t i = 0;
+  while (i < ARRAY_SIZE(kButtons) && buttonBit(i) != button) {
+    i++;
+  }
+  return i;
+}
+
+// Jog direction of the UP and DN buttons, motion::kStop if none is held.
+uint8_t lastJog = motion::kStop;
+
+// Serial protocol. Text commands (see command_line.h) until a binary packet
+// delimiter is received, then binary packets (see desk_protocol.h).
+boolean binaryMode = false;
+desk_protocol::PacketReader packetReader;
+// Stream the received LIN frames to the host, binary mode only.
+boolean linDump = false;
+
+// A position change was not logged because of the rate limit.
+boolean positionLogPending = false;
 
-int pressedButton = 0;
-int lastPressedButton = 0;
-unsigned long lastPressed = 0;
-uint8_t doOnce = false;
+#if LIN_TRACE
+// Armed at startup: stop half a ring after a LIN error or a position jump.
+const lin_trace::Config kDefaultTraceConfig = {
+  lin_trace::triggers::ERROR | lin_trace::triggers::POSITION_JUMP, 0, 100, 50
+};
+// A TRACE_DUMP is being sent, from traceDumpOffset.
+boolean traceDumping = false;
+uint16_t traceDumpOffset = 0;
+#endif
 
 
 void printValues() {
-  Serial.println("======= VALUES =======");
-  Serial.print("Memory 1 is at: ");
-  Serial.println(memOne);
-  Serial.print("Memory 2 is at: ");
-  Serial.println(memTwo);
-  Serial.print("Threshold is: ");
-  Serial.println(targetThreshold);
-  Serial.print("Current Position: ");
-  Serial.println(lastPosition);
-  Serial.println("======================");
+  text_io::println(F("======= VALUES ======="));
+  for (uint8_t i = 1; i <= presets::kCount; i++) {
+    text_io::print(F("Memory "));
+    text_io::printUint(i);
+    text_io::print(F(" is at: "));
+    text_io::printUint(presets::position(i));
+    text_io::println();
+  }
+  text_io::print(F("Threshold is: "));
+  text_io::printUint(targetThreshold);
+  text_io::println();
+  text_io::print(F("Current Position: "));
+  text_io::printUint(lastPosition);
+  text_io::println();
+  text_io::print(F("Speed (units/s): "));
+  text_io::printInt(position_tracker::velocity());
+  text_io::println();
+#if LOOP_PROFILER
+  text_io::print(F("Max loop time (us): "));
+  text_io::printUint((uint32_t)loop_profiler::maxTicks() * (1000 / hardware_clock::kTicksPerMilli));
+  text_io::println();
+#endif
+  text_io::print(F("Coast up / down: "));
+  text_io::printUint(coast_estimator::learnedCoast(motion::kUp));
+  text_io::print(F(" at "));
+  text_io::printUint(coast_estimator::learnedSpeed(motion::kUp));
+  text_io::print(F(" / "));
+  text_io::printUint(coast_estimator::learnedCoast(motion::kDown));
+  text_io::print(F(" at "));
+  text_io::printUint(coast_estimator::learnedSpeed(motion::kDown));
+  text_io::println();
+  text_io::print(F("Serial RX overruns: "));
+  text_io::printUint(sio::rxOverruns());
+  text_io::println();
+  const settings_store::Stats& settingsStats = settings_store::stats();
+  text_io::print(F("Settings record: "));
+  text_io::printUint(settingsStats.sequence);
+  text_io::print(F(", ~"));
+  text_io::printUint(settings_store::cellWrites());
+  text_io::print(F(" writes per cell"));
+  text_io::println();
+  text_io::print(F("Settings since boot: "));
+  text_io::printUint(settingsStats.records_written);
+  text_io::print(F(" records, "));
+  text_io::printUint(settingsStats.bytes_written);
+  text_io::print(F(" bytes written, "));
+  text_io::printUint(settingsStats.bytes_skipped);
+  text_io::print(F(" unchanged, "));
+  text_io::printUint(settingsStats.saves_coalesced);
+  text_io::print(F(" saves coalesced, "));
+  text_io::printUint(settingsStats.bad_records);
+  text_io::print(F(" bad records"));
+  text_io::println();
+  text_io::print(F("Log lines dropped: "));
+  text_io::printUint(logger::droppedLines());
+  text_io::print(F(", rate limited: "));
+  text_io::printUint(logger::rateLimitedLines());
+  text_io::println();
+  text_io::println(F("======================"));
+  // Printing above takes a while.
+  loop_profiler::skipIteration();
 }
 
-void printHelp() {
-  Serial.println("======= Serial Commands =======");
-  Serial.println("Send 'STOP' to stop");
-  Serial.println("Send 'HELP' to show this view");
-  Serial.println("Send 'VALUES' to show the current values");
-  Serial.println("Send 'T123' to set the threshold to 123 (255 max!)");
-  Serial.println("Send 'M1' to move to position stored in memory 1");
-  Serial.println("Send 'M2' to move to position stored in memory 2");
-  Serial.println("Send 'S1' to store current position in memory 1");
-  Serial.println("Send 'S2' to store current position in memory 2");
-  Serial.println("Send 'M15000' to move set the mem 1 position to 5000");
-  Serial.println("Send 'M25000' to move set the mem 2 position to 5000");
-  Serial.println("Send '1580' to move to position 1580.");
-  Serial.println("===============================");
-}
-
-void storeM1(uint16_t value) {
-  if (value > 150 && value < 6400) {
-    memOne = value;
-    Serial.print("New Memory 1: ");
-    Serial.println(value);
-    EEPROM.put(1, value);
-  } else {
-    Serial.println("Not stored. Keep your value between 150 and 6400");
+void printTasks() {
+  text_io::println(F("======= TASKS ======="));
+  text_io::println(F("name: runs, avg/max run (us), max late (ms), deadline misses"));
+  for (uint8_t i = 0; i < scheduler::taskCount(); i++) {
+    const scheduler::TaskStats& stats = scheduler::taskStats(i);
+    const uint32_t usPerTick = 1000 / hardware_clock::kTicksPerMilli;
+    text_io::print(scheduler::taskName(i));
+    text_io::print(F(": "));
+    text_io::printUint(stats.runs);
+    text_io::print(F(", "));
+    text_io::printUint(stats.runs ? stats.total_ticks / stats.runs * usPerTick : 0);
+    text_io::print(F("/"));
+    text_io::printUint(stats.max_ticks * usPerTick);
+    text_io::print(F(", "));
+    text_io::printUint(stats.max_late_millis);
+    text_io::print(F(", "));
+    text_io::printUint(stats.deadline_misses);
+    text_io::println();
   }
+  text_io::println(F("====================="));
+  // Printing above takes a while.
+  scheduler::clearMaxima();
+  loop_profiler::skipIteration();
 }
 
-void storeM2(uint16_t value) {
-  if (value > 150 && value < 6400) {
-    memTwo = value;
-    Serial.print("New Memory 2: ");
-    Serial.println(value);
-    EEPROM.put(3, value);
-  } else {
-    Serial.println("Not stored. Keep your value between 150 and 6400");
+// Prints and clears the loop iteration time histogram.
+void printLoopTimes() {
+#if LOOP_PROFILER
+  const uint32_t usPerTick = 1000 / hardware_clock::kTicksPerMilli;
+  text_io::println(F("======= LOOP ======="));
+  text_io::println(F("from (us): iterations"));
+  for (uint8_t i = 0; i < loop_profiler::kNumBuckets; i++) {
+    const uint16_t count = loop_profiler::bucketCount(i);
+    if (count) {
+      text_io::printUint(i ? (1UL << i) * usPerTick : 0);
+      text_io::print(F(": "));
+      text_io::printUint(count);
+      text_io::println();
+    }
   }
+  text_io::print(F("p99 (us): "));
+  text_io::printUint(loop_profiler::percentileTicks(990) * usPerTick);
+  text_io::println();
+  text_io::print(F("Max (us): "));
+  text_io::printUint(loop_profiler::maxTicks() * usPerTick);
+  text_io::println();
+  text_io::println(F("===================="));
+  loop_profiler::reset();
+#else
+  text_io::println(F("Loop profiler not built, see LOOP_PROFILER."));
+#endif
 }
 
-void storeThreshold(uint8_t value) {
-  if (value > 50 && value < 254) {
-    targetThreshold = value;
-    Serial.print("New Threshold: ");
-    Serial.println(value);
-    EEPROM.put(0, value);
-  } else {
-    Serial.println("Not stored. Keep your value between 50 and 254");
+// Prints and clears the LIN decoder ISR run times.
+void printIsrTimes() {
+#if LIN_ISR_PROFILER
+  const uint32_t nowMillis = system_clock::timeMillis();
+  const uint32_t cyclesPerTick = F_CPU / 1000 / hardware_clock::kTicksPerMilli;
+  text_io::println(F("======= ISR ======="));
+  text_io::print(F("Bit time (cycles): "));
+  text_io::printUint(F_CPU / custom_defs::kLinSpeed);
+  text_io::println();
+  text_io::println(F("slot: calls, avg/max (cycles), CPU %"));
+  uint16_t totalPercentX100 = 0;
+  for (uint8_t i = 0; i < isr_profiler::kNumSlots; i++) {
+    isr_profiler::SlotStats stats;
+    isr_profiler::get(i, &stats);
+    if (!stats.calls) {
+      continue;
+    }
+    const uint16_t percentX100 = isr_profiler::cpuPercentX100(stats, nowMillis);
+    totalPercentX100 += percentX100;
+    text_io::print(isr_profiler::slotName(i));
+    text_io::print(F(": "));
+    text_io::printUint(stats.calls);
+    text_io::print(F(", "));
+    text_io::printUint(stats.total_ticks * cyclesPerTick / stats.calls);
+    text_io::print(F("/"));
+    text_io::printUint(stats.max_ticks * cyclesPerTick);
+    text_io::print(F(", "));
+    text_io::printFixed(percentX100, 2);
+    text_io::println();
   }
+  text_io::print(F("Decoder CPU % over "));
+  text_io::printUint(isr_profiler::windowMillis(nowMillis));
+  text_io::print(F(" ms: "));
+  text_io::printFixed(totalPercentX100, 2);
+  text_io::println();
+  text_io::println(F("==================="));
+  isr_profiler::reset(nowMillis);
+  loop_profiler::skipIteration();
+#else
+  text_io::println(F("ISR profiler not built, see LIN_ISR_PROFILER."));
+#endif
 }
 
+// Prints and clears the bit tick ISR entry latencies by the section that
+// delayed the ISR.
+void printIsrLatency() {
+#if LIN_ISR_LATENCY
+  const uint8_t cyclesPerCount = isr_latency::cyclesPerCount();
+  text_io::println(F("======= LATENCY ======="));
+  text_io::print(F("Half bit (cycles): "));
+  text_io::printUint(F_CPU / custom_defs::kLinSpeed / 2);
+  text_io::println();
+  text_io::print(F("from (cycles):"));
+  for (uint8_t i = 0; i < isr_latency::kNumBuckets; i++) {
+    text_io::printchar(' ');
+    text_io::printUint(i ? (uint16_t)cyclesPerCount << i : 0);
+  }
+  text_io::println();
+  for (uint8_t section = 0; section < isr_latency::kNumSections; section++) {
+    uint32_t buckets[isr_latency::kNumBuckets];
+    uint8_t maxCount;
+    isr_latency::get(section, buckets, &maxCount);
+    if (!maxCount && !buckets[0]) {
+      continue;
+    }
+    text_io::print(isr_latency::sectionName(section));
+    text_io::printchar(':');
+    for (uint8_t i = 0; i < isr_latency::kNumBuckets; i++) {
+      text_io::printchar(' ');
+      text_io::printUint(buckets[i]);
+    }
+    text_io::print(F(", max "));
+    text_io::printUint((uint16_t)maxCount * cyclesPerCount);
+    text_io::println();
+  }
+  text_io::println(F("======================="));
+  isr_latency::reset();
+  loop_profiler::skipIteration();
+#else
+  text_io::println(F("ISR latency not built, see LIN_ISR_LATENCY."));
+#endif
+}
 
-// direction == 0 => Table stops
-// direction == 1 => Table goes upwards
-// direction == 2 => Table goes downwards
-//
-void moveTable(uint8_t direction) {
-  if (direction != currentTableMovement) {
-    currentTableMovement = direction;
-    if (direction == 0) {
-      Serial.println("Table stops");
-      digitalWrite(moveTableUpPin, HIGH);
-      digitalWrite(moveTableDownPin, HIGH);
-    } else if (direction == 1) {
-      Serial.println("Table goes up");
-      digitalWrite(moveTableDownPin, HIGH);
-      digitalWrite(moveTableUpPin, LOW);
+// Prints the LIN bus statistics, most frequent ids first.
+void printBusStats() {
+#if LIN_BUS_STATS
+  const uint32_t usPerTick = 1000 / hardware_clock::kTicksPerMilli;
+  const lin_stats::BusStats& bus = lin_stats::busStats();
+  text_io::println(F("======= BUS ======="));
+  text_io::print(F("Load %: "));
+  text_io::printFixed(bus.load_x100, 2);
+  text_io::print(F(", last second "));
+  text_io::printFixed(bus.last_window_load_x100, 2);
+  text_io::println();
+  text_io::print(F("Frames: "));
+  text_io::printUint(bus.frames);
+  text_io::print(F(", dropped after the id "));
+  text_io::printUint(bus.header_frames);
+  text_io::print(F(", of evicted ids "));
+  text_io::printUint(bus.evicted_frames);
+  text_io::println();
+  text_io::print(F("Errors:"));
+  for (uint8_t i = 0; i < lin_stats::kNumErrorTypes; i++) {
+    text_io::printchar(' ');
+    text_io::print(lin_processor::errorBitName(i));
+    text_io::printchar(' ');
+    text_io::printUint(bus.errors[i]);
+  }
+  text_io::print(F(", without id "));
+  text_io::printUint(bus.errors_without_id);
+  text_io::println();
+  text_io::println(F("id: frames, interval min/avg/max (us), errors, bad frames"));
+  lin_stats::sortIds();
+  for (uint8_t i = 0; i < lin_stats::idCount(); i++) {
+    const lin_stats::IdStats& stats = lin_stats::idStats(i);
+    text_io::print(F("0x"));
+    text_io::printHex(stats.id, 2);
+    text_io::print(F(": "));
+    text_io::printUint(stats.frames);
+    text_io::print(F(", "));
+    if (stats.intervals) {
+      text_io::printUint(stats.min_interval_ticks * usPerTick);
+      text_io::print(F("/"));
+      text_io::printUint(stats.interval_sum_ticks / stats.intervals * usPerTick);
+      text_io::print(F("/"));
+      text_io::printUint(stats.max_interval_ticks * usPerTick);
     } else {
-      Serial.println("Table goes down");
-      digitalWrite(moveTableUpPin, HIGH);
-      digitalWrite(moveTableDownPin, LOW);
+      text_io::print(F("-"));
     }
+    text_io::print(F(", "));
+    text_io::printUint(stats.errors);
+    text_io::print(F(", "));
+    text_io::printUint(stats.bad_frames);
+    text_io::println();
+  }
+  text_io::println(F("==================="));
+  loop_profiler::skipIteration();
+#else
+  text_io::println(F("Bus statistics not built, see LIN_BUS_STATS."));
+#endif
+}
+
+// Logs a line made of a text and an optional number.
+void logLine(uint8_t level, uint8_t messageClass, const __FlashStringHelper* text) {
+  if (logger::begin(level, messageClass)) {
+    logger::print(text);
+    logger::end();
   }
 }
 
-// direction == 0 => Table is levelled
-// direction == 1 => Target is above table
-// direction == 2 => Target is below table
-uint8_t desiredTableDirection() {
+void logValue(uint8_t level, uint8_t messageClass, const __FlashStringHelper* text,
+    uint32_t value) {
+  if (logger::begin(level, messageClass)) {
+    logger::print(text);
+    logger::printUint(value);
+    logger::end();
+  }
+}
+
+// Prints the state of the LIN trace recorder.
+void printTrace() {
+#if LIN_TRACE
+  const uint8_t state = lin_trace::state();
+  const lin_trace::Config& config = lin_trace::config();
+  text_io::print(F("Trace: "));
+  text_io::print(state == lin_trace::states::ARMED ? F("armed")
+      : state == lin_trace::states::TRIGGERED ? F("triggered")
+      : state == lin_trace::states::STOPPED ? F("stopped") : F("off"));
+  text_io::print(F(", triggers 0x"));
+  text_io::printHex(config.triggers, 2);
+  text_io::print(F(" (id 0x"));
+  text_io::printHex(config.id, 2);
+  text_io::print(F(", jump "));
+  text_io::printUint(config.position_jump);
+  text_io::print(F("), cause 0x"));
+  text_io::printHex(lin_trace::cause(), 2);
+  text_io::print(F(", "));
+  text_io::printUint(lin_trace::recordBytes());
+  text_io::print(F(" bytes, "));
+  text_io::printUint(lin_trace::lostRecords());
+  text_io::println(F(" records lost"));
+#else
+  text_io::println(F("Trace recorder not built, see LIN_TRACE."));
+#endif
+}
 
-  int distance = lastPosition - currentTarget;
-  uint16_t absDistance = abs(distance);
+void printHelp() {
+  text_io::println(F("======= Serial Commands ======="));
+  text_io::println(F("Send 'STOP' to stop"));
+  text_io::println(F("Send 'HELP' to show this view"));
+  text_io::println(F("Send 'VALUES' to show the current values"));
+  text_io::println(F("Send 'TASKS' to show the task run times and deadline misses"));
+  text_io::println(F("Send 'LOOP' to show and clear the loop time histogram"));
+  text_io::println(F("Send 'ISR' to show and clear the LIN decoder ISR times"));
+  text_io::println(F("Send 'LATENCY' to show and clear the bit tick ISR latencies"));
+  text_io::println(F("Send 'BUS' to show the LIN bus statistics"));
+  text_io::println(F("Send 'TRACE' to show the LIN trace recorder state"));
+  text_io::println(F("Send 'T123' to set the threshold to 123 (255 max!)"));
+  text_io::print(F("Memories are 1 to "));
+  text_io::printUint(presets::kCount);
+  text_io::println();
+  text_io::println(F("Send 'M1' to move to position stored in memory 1"));
+  text_io::println(F("Send 'S1' to store current position in memory 1"));
+  text_io::println(F("Send 'M1=5000' or 'M15000' to set the mem 1 position to 5000"));
+  text_io::println(F("Send '1580' to move to position 1580."));
+  text_io::println(F("==============================="));
+}
 
-  if (absDistance > targetThreshold) {
-    if (distance <= 0) { // table has to move up
-      return 1;
+boolean storePreset(uint8_t number, uint16_t value) {
+  if (!presets::isValidNumber(number)) {
+    logValue(logger::levels::WARN, logger::classes::SETTINGS, F("No such memory: "), number);
+    return false;
+  }
+  if (presets::store(number, value)) {
+    if (logger::begin(logger::levels::INFO, logger::classes::SETTINGS)) {
+      logger::print(F("New Memory "));
+      logger::printUint(number);
+      logger::print(F(": "));
+      logger::printUint(value);
+      logger::end();
     }
-    return 2;
+    return true;
   }
-  return 0;
+  logLine(logger::levels::WARN, logger::classes::SETTINGS,
+      F("Not stored. Keep your value between 150 and 6400"));
+  return false;
+}
 
+boolean storeThreshold(uint8_t value) {
+  if (value > 50 && value < 254) {
+    targetThreshold = value;
+    motion::setThreshold(value);
+    settings_store::Settings settings = settings_store::settings();
+    settings.threshold = value;
+    settings_store::save(settings);
+    logValue(logger::levels::INFO, logger::classes::SETTINGS, F("New Threshold: "), value);
+    return true;
+  }
+  logLine(logger::levels::WARN, logger::classes::SETTINGS,
+      F("Not stored. Keep your value between 50 and 254"));
+  return false;
 }
 
+// ----- Binary protocol output, see desk_protocol.h -----
 
-void processLINFrame(LinFrame frame) {
-  // Get the first byte which is the LIN ID
-  uint8_t id = frame.get_byte(0);
+void sendPacket(uint8_t type, const uint8_t* body, uint8_t bodyLength) {
+  uint8_t wire[desk_protocol::kMaxWirePacket];
+  const uint8_t n = desk_protocol::encodePacket(type, body, bodyLength, wire);
+  text_io::write(wire, n);
+}
 
-  // 0x92 is the ID of the LIN node that sends the table position
-  if (id == 0x92) {
+void sendPosition() {
+  uint8_t body[4];
+  desk_protocol::putU16(body, lastPosition);
+  desk_protocol::putU16(body + 2, position_tracker::velocity());
+  sendPacket(desk_protocol::messages::POSITION, body, sizeof(body));
+}
 
-    // the table position is a two byte value. LSB is sent first.
-    uint8_t varA = frame.get_byte(2); //1st byte of the value (LSB)
-    uint8_t varB = frame.get_byte(1); //2nd byte (MSB)
-    uint16_t temp = 0;
+void sendStatus() {
+  uint8_t body[12];
+  desk_protocol::putU16(body, lastPosition);
+  desk_protocol::putU16(body + 2, motion::target());
+  desk_protocol::putU16(body + 4, presets::position(1));
+  desk_protocol::putU16(body + 6, presets::position(2));
+  body[8] = targetThreshold;
+  body[9] = motion::direction();
+  desk_protocol::putU16(body + 10, position_tracker::velocity());
+  sendPacket(desk_protocol::messages::STATUS, body, sizeof(body));
+}
 
-    temp = varA;
-    temp <<= 8;
-    temp = temp | varB;
+void sendAck(uint8_t request, uint8_t result) {
+  const uint8_t body[2] = {request, result};
+  sendPacket(desk_protocol::messages::ACK, body, sizeof(body));
+}
 
-    if (temp != lastPosition) {
-      lastPosition = temp;
-      String myString = String(temp);
-      char buffer[5];
-      myString.toCharArray(buffer, 5);
-      Serial.print("Current Position: ");
-      Serial.println(buffer);
+void sendLinFrame(const LinFrame& frame) {
+  uint8_t body[1 + LinFrame::kMaxBytes];
+  const uint8_t n = frame.num_bytes();
+  body[0] = frame.flags();
+  for (uint8_t i = 0; i < n; i++) {
+    body[1 + i] = frame.get_byte(i);
+  }
+  sendPacket(desk_protocol::messages::LIN_FRAME, body, 1 + n);
+}
+
+#if LIN_TRACE
+// Sends the next TRACE_DATA packet of a TRACE_DUMP when there is room in
+// the sio buffer, and the ACK after the last one.
+void sendTraceData() {
+  if (!traceDumping || sio::capacity() < desk_protocol::kMaxWirePacket) {
+    return;
+  }
+  uint8_t body[desk_protocol::kMaxBody];
+  const uint16_t left = lin_trace::blockSize() - traceDumpOffset;
+  const uint8_t n = left < sizeof(body) - 2 ? left : sizeof(body) - 2;
+  desk_protocol::putU16(body, traceDumpOffset);
+  lin_trace::readBlock(traceDumpOffset, body + 2, n);
+  sendPacket(desk_protocol::messages::TRACE_DATA, body, 2 + n);
+  traceDumpOffset += n;
+  if (traceDumpOffset >= lin_trace::blockSize()) {
+    traceDumping = false;
+    sendAck(desk_protocol::messages::TRACE_DUMP, desk_protocol::results::OK);
+  }
+}
+#endif
 
-      if (initializedTarget == false) {
-        currentTarget = temp;
-        initializedTarget = true;
-      }
-    }
 
+// The motion::MotorOutput, drives the relays of the stock controller.
+// direction == 0 => Table stops
+// direction == 1 => Table goes upwards
+// direction == 2 => Table goes downwards
+void driveMotor(uint8_t direction) {
+  if (binaryMode) {
+    sendStatus();
+  }
+  if (direction == motion::kStop) {
+    logLine(logger::levels::INFO, logger::classes::MOTION, F("Table stops"));
+    digitalWrite(moveTableUpPin, HIGH);
+    digitalWrite(moveTableDownPin, HIGH);
+  } else if (direction == motion::kUp) {
+    logLine(logger::levels::INFO, logger::classes::MOTION, F("Table goes up"));
+    digitalWrite(moveTableDownPin, HIGH);
+    digitalWrite(moveTableUpPin, LOW);
+  } else {
+    logLine(logger::levels::INFO, logger::classes::MOTION, F("Table goes down"));
+    digitalWrite(moveTableUpPin, HIGH);
+    digitalWrite(moveTableDownPin, LOW);
   }
 }
 
-void readButtons() {
 
-  if (digitalRead(moveUpButton) == HIGH) {
+// LIN id of the node that sends the table position (0x92 on the wire,
+// with the parity bits).
+const uint8_t kPositionFrameId = 0x12;
+
+// Logs lastPosition, at most every kLogPositionIntervalMillis while the
+// table moves. A skipped position is logged by a later call.
+void logPosition() {
+  positionLogPending = true;
+  if (logger::begin(logger::levels::INFO, logger::classes::POSITION)) {
+    logger::print(F("Current Position: "));
+    logger::printUint(lastPosition);
+    logger::print(F(" ("));
+    logger::printInt(position_tracker::velocity());
+    logger::print(F("/s)"));
+    logger::end();
+    positionLogPending = false;
+  }
+}
 
-    pressedButton = moveUpButton;
-    if (lastPressedButton != pressedButton) {
-      Serial.println("Button UP Pressed");
-      lastPressedButton = pressedButton;
-    }
-    return;
+// Handler of the kPositionFrameId frames.
+void processPositionFrame(const LinFrame& frame) {
+  if (linDump) {
+    sendLinFrame(frame);
   }
 
-  if (digitalRead(moveM1Button) == HIGH) {
-    pressedButton = moveM1Button;
-    if (lastPressedButton != pressedButton) {
-      Serial.println("Button M1 Pressed");
-      lastPressedButton = pressedButton;
+  // Corrupted, or a different checksum version than learned for this id.
+  if (!frame.isValid()) {
+    return;
+  }
 
+  // the table position is a two byte value. LSB is sent first.
+  uint8_t varA = frame.get_byte(2); //1st byte of the value (LSB)
+  uint8_t varB = frame.get_byte(1); //2nd byte (MSB)
+  uint16_t temp = 0;
+
+  temp = varA;
+  temp <<= 8;
+  temp = temp | varB;
+
+  position_tracker::addSample(temp, frame.timestamp());
+  // The frame may have waited in the queue, motion extrapolates from its end.
+  motion::onPosition(temp, position_tracker::velocity(),
+      system_clock::extendMillis(frame.timestamp()), system_clock::timeMillis());
+
+  if (temp != lastPosition) {
+#if LIN_TRACE
+    const uint16_t jump = temp > lastPosition ? temp - lastPosition : lastPosition - temp;
+    if (lastPosition && jump >= lin_trace::config().position_jump) {
+      lin_trace::trigger(lin_trace::triggers::POSITION_JUMP);
+    }
+#endif
+    lastPosition = temp;
+    if (binaryMode) {
+      sendPosition();
+    } else {
+      logPosition();
     }
-    return;
   }
+}
 
-  if (digitalRead(moveM2Button) == HIGH) {
-    pressedButton = moveM2Button;
-    if (lastPressedButton != pressedButton) {
-      Serial.println("Button M2 Pressed");
-      lastPressedButton = pressedButton;
+void logButton(const __FlashStringHelper* what, uint8_t index) {
+  if (logger::begin(logger::levels::INFO, logger::classes::BUTTONS)) {
+    const uint8_t jog = buttonJog(index);
+    logger::print(F("Button "));
+    if (jog == motion::kStop) {
+      logger::print(F("M"));
+      logger::printUint(buttonPreset(index));
+    } else {
+      logger::print(jog == motion::kUp ? F("UP") : F("DN"));
+    }
+    logger::print(what);
+    logger::end();
+  }
+}
 
+void loopButtons(uint32_t nowMillis) {
+  buttons::loop(hardware_clock::ticksForNonIsr(), nowMillis);
+
+  // The table moves while a jog button is held, unless a button before it
+  // in the table is held too.
+  const uint8_t pressed = buttons::pressed();
+  uint8_t jog = motion::kStop;
+  for (uint8_t i = 0; i < ARRAY_SIZE(kButtons); i++) {
+    if (pressed & buttonBit(i)) {
+      jog = buttonJog(i);
+      break;
     }
-    return;
+  }
+  if (jog != lastJog) {
+    lastJog = jog;
+    motion::onJog(jog, nowMillis);
   }
 
-  if (digitalRead(moveDownButton) == HIGH) {
-    pressedButton = moveDownButton;
-    if (lastPressedButton != pressedButton) {
-      Serial.println("Button DN Pressed");
-      lastPressedButton = pressedButton;
+  buttons::Event event;
+  while (buttons::nextEvent(&event)) {
+    const uint8_t index = buttonIndex(event.button);
+    if (index >= ARRAY_SIZE(kButtons)) {
+      continue;
+    }
+    const uint8_t preset = buttonPreset(index);
+    if (event.type == buttons::events::PRESS) {
+      logButton(F(" Pressed"), index);
+    } else if (event.type == buttons::events::LONG_PRESS) {
+      if (preset) {
+        storePreset(preset, lastPosition);
+      }
+    } else {
+      logValue(logger::levels::DEBUG, logger::classes::BUTTONS, F("Button pressed (ms): "),
+          event.held_millis);
+      // Moves to the preset on a short press, not when a jog button was
+      // held meanwhile.
+      if (preset && event.held_millis < buttons::kLongPressMillis && jog == motion::kStop) {
+        motion::onTarget(presets::position(preset), nowMillis);
+      }
     }
-    return;
   }
+}
 
+// Settings of older firmware, at fixed EEPROM addresses. Read once, until
+// the first record is stored. Unset values are all ones either way.
+void loadLegacySettings() {
+  settings_store::Settings settings = settings_store::settings();
+  EEPROM.get(0, settings.threshold);
+  EEPROM.get(1, settings.memory[0]);
+  EEPROM.get(3, settings.memory[1]);
+  for (uint8_t i = 0; i < 2; i++) {
+    EEPROM.get(coast_estimator::kLegacyEepromAddress + 2 * i, settings.coast[i]);
+    EEPROM.get(coast_estimator::kLegacyEepromAddress + 4 + 2 * i, settings.coast_speed[i]);
+  }
+  settings_store::save(settings);
+}
 
-  pressedButton = 0;
 
-}
 
-void loopButtons() {
 
-  if (pressedButton != 0) {
+// Binary requests, see desk_protocol.h.
+void handlePacket(uint32_t nowMillis) {
+  using namespace desk_protocol;
+  const uint8_t type = packetReader.type();
+  const uint8_t* body = packetReader.body();
+  const uint8_t n = packetReader.body_length();
+  uint8_t result = results::OK;
 
-    if (lastPressedButton == moveUpButton) {
-      moveTable(1);
-      currentTarget = lastPosition + (targetThreshold * 2);
-    } else if (lastPressedButton == moveDownButton) {
-      moveTable(2);
-      currentTarget = lastPosition - (targetThreshold * 2);
-    } else {
-      if (doOnce == false) {
-        lastPressed = millis();
-        doOnce = true;
+  switch (type) {
+    case messages::GET_STATUS:
+      sendStatus();
+      return;
+
+    case messages::MOVE_TO:
+      if (n != 2) {
+        result = results::BAD_REQUEST;
+      } else if (getU16(body) > 150 && getU16(body) < 6400) {
+        motion::onTarget(getU16(body), nowMillis);
+      } else {
+        result = results::OUT_OF_RANGE;
+      }
+      break;
+
+    case messages::STOP:
+      motion::onStop(nowMillis);
+      break;
+
+    case messages::SET_MEMORY:
+    case messages::STORE_MEMORY: {
+      const uint8_t expected = type == messages::SET_MEMORY ? 3 : 1;
+      if (n != expected || !presets::isValidNumber(body[0])) {
+        result = results::BAD_REQUEST;
+        break;
       }
+      const uint16_t value = type == messages::SET_MEMORY ? getU16(body + 1) : lastPosition;
+      if (!storePreset(body[0], value)) {
+        result = results::OUT_OF_RANGE;
+      }
+      break;
     }
 
-  } else {
+    case messages::MOVE_TO_MEMORY:
+      if (n != 1 || !presets::isValidNumber(body[0])) {
+        result = results::BAD_REQUEST;
+      } else {
+        motion::onTarget(presets::position(body[0]), nowMillis);
+      }
+      break;
+
+    case messages::GET_MEMORY:
+      if (n != 1 || !presets::isValidNumber(body[0])) {
+        result = results::BAD_REQUEST;
+      } else {
+        uint8_t reply[3] = {body[0]};
+        putU16(reply + 1, presets::position(body[0]));
+        sendPacket(messages::MEMORY, reply, sizeof(reply));
+        return;
+      }
+      break;
+
+    case messages::SET_THRESHOLD:
+      if (n != 1) {
+        result = results::BAD_REQUEST;
+      } else if (!storeThreshold(body[0])) {
+        result = results::OUT_OF_RANGE;
+      }
+      break;
 
-    if (doOnce) {
+    case messages::SET_LIN_DUMP:
+      if (n != 1) {
+        result = results::BAD_REQUEST;
+      } else {
+        linDump = body[0] != 0;
+      }
+      break;
 
-      unsigned int pressDuration = millis() - lastPressed;
+#if LIN_TRACE
+    case messages::TRACE_ARM:
+      if (n != 5 || body[4] > 100) {
+        result = results::BAD_REQUEST;
+      } else {
+        const lin_trace::Config config = {body[0], (uint8_t)(body[1] & 0x3f), getU16(body + 2),
+            body[4]};
+        traceDumping = false;
+        lin_trace::arm(config);
+      }
+      break;
+
+    case messages::TRACE_DUMP:
+      lin_trace::stop();
+      traceDumping = true;
+      traceDumpOffset = 0;
+      // Acked by sendTraceData() after the data.
+      return;
+#endif
+
+    case messages::TEXT_MODE:
+      sendAck(type, result);
+      binaryMode = false;
+      linDump = false;
+#if LIN_TRACE
+      traceDumping = false;
+#endif
+      logger::setMuted(false);
+      text_io::println(F("Text mode. Type 'HELP' to display all commands."));
+      return;
+
+    default:
+      result = results::BAD_REQUEST;
+      break;
+  }
+  sendAck(type, result);
+}
 
-      if (pressDuration > 0 && pressDuration < 1000) { // short press
+// Serial commands, see command_line.h.
+void handleCommand(const command_line::Command& command, uint32_t nowMillis) {
+  switch (command.id) {
+    case command_line::commands::HELP:
+      printHelp();
+      break;
 
-        Serial.print("Button pressed for ");
-        Serial.print(pressDuration);
-        Serial.println(" ms.");
+    case command_line::commands::VALUES:
+      printValues();
+      break;
+
+    case command_line::commands::TASKS:
+      printTasks();
+      break;
+
+    case command_line::commands::LOOP_TIMES:
+      printLoopTimes();
+      break;
+
+    case command_line::commands::ISR_TIMES:
+      printIsrTimes();
+      break;
+
+    case command_line::commands::ISR_LATENCY:
+      printIsrLatency();
+      break;
+
+    case command_line::commands::BUS_STATS:
+      printBusStats();
+      break;
+
+    case command_line::commands::TRACE:
+      printTrace();
+      break;
+
+    case command_line::commands::STOP:
+      motion::onStop(nowMillis);
+      text_io::print(F("STOP at "));
+      text_io::printUint(lastPosition);
+      text_io::println();
+      break;
+
+    case command_line::commands::SET_THRESHOLD:
+      storeThreshold(command.value > 255 ? 255 : (uint8_t)command.value);
+      break;
+
+    case command_line::commands::MOVE_TO_PRESET:
+      if (presets::isValidNumber(command.preset)) {
+        motion::onTarget(presets::position(command.preset), nowMillis);
+      } else {
+        text_io::println(F("No such memory. Type 'HELP' to display all commands."));
+      }
+      break;
+
+    case command_line::commands::SET_PRESET:
+      storePreset(command.preset, command.value);
+      break;
+
+    case command_line::commands::STORE_PRESET:
+      storePreset(command.preset, lastPosition);
+      break;
+
+    case command_line::commands::MOVE_TO:
+      if (command.value > 150 && command.value < 6400) {
+        text_io::print(F("New Target "));
+        text_io::printUint(command.value);
+        text_io::println();
+        motion::onTarget(command.value, nowMillis);
+      } else {
+        text_io::println(F("Not stored. Keep your value between 150 and 6400"));
+      }
+      break;
 
-        if (lastPressedButton == moveM1Button) {
-          currentTarget = memOne;
-        } else if (lastPressedButton == moveM2Button) {
-          currentTarget = memTwo;
-        }
+    default:
+      text_io::println(F("Unknown command. Type 'HELP' to display all commands."));
+      break;
+  }
+}
 
-      } else if (pressDuration >= 1000) {
+// ----- Tasks, see scheduler.h -----
 
-        Serial.print("Button pressed for ");
-        Serial.print(pressDuration);
-        Serial.println(" ms.");
+// Handle recieved LIN frames, in place in the rx queue.
+void taskLin(uint32_t) {
+  lin_processor::dispatchFrames();
+}
 
-        if (lastPressedButton == moveM1Button) {
-          storeM1(lastPosition);
-        } else if (lastPressedButton == moveM2Button) {
-          storeM2(lastPosition);
-        }
+// Motion timeouts: the motor cut between position frames, settling and
+// stall detection. See motion.h.
+void taskMotion(uint32_t nowMillis) {
+  if (motion::hasDeadline() && (int32_t)(nowMillis - motion::deadline()) >= 0) {
+    motion::onTimeout(nowMillis);
+  }
+}
 
+// Serial commands or packets. Only the bytes already received are read,
+// at most one command is handled per pass. The sio RX interrupt holds
+// the input that arrives meanwhile, e.g. while a long reply is printed.
+void taskSerial(uint32_t nowMillis) {
+  command_line::Command command;
+  boolean hasCommand = false;
+  boolean hasPacket = false;
+  if (sio::available()) {
+    while (!hasCommand && !hasPacket && sio::available()) {
+      const uint8_t b = sio::read();
+      // A text line never contains a zero byte, it is a packet delimiter.
+      if (b == 0) {
+        binaryMode = true;
+        logger::setMuted(true);
+      }
+      if (binaryMode) {
+        hasPacket = packetReader.handleByte(b);
+      } else {
+        hasCommand = command_line::handleByte(b, nowMillis, &command);
       }
-
     }
+  } else if (!binaryMode) {
+    hasCommand = command_line::handleIdle(nowMillis, &command);
+  }
+  if (hasCommand) {
+    handleCommand(command, nowMillis);
+  }
+  if (hasPacket) {
+    handlePacket(nowMillis);
+  }
+#if LIN_TRACE
+  sendTraceData();
+#endif
+}
 
+// LIN errors, bus load and the position log lines held back by the rate
+// limit.
+void taskTelemetry(uint32_t nowMillis) {
+#if LIN_BUS_STATS
+  lin_stats::loop(nowMillis);
+#else
+  (void)nowMillis;
+#endif
+
+  const uint8_t linErrors = lin_processor::getAndClearErrorFlags();
+  if (linErrors) {
+    if (binaryMode) {
+      sendPacket(desk_protocol::messages::LIN_ERRORS, &linErrors, 1);
+    } else if (logger::begin(logger::levels::WARN, logger::classes::LIN)) {
+      logger::print(F("LIN errors: "));
+      logger::printHex(linErrors, 2);
+      logger::end();
+    }
+  }
 
-    doOnce = false;
+  if (positionLogPending && !binaryMode) {
+    logPosition();
   }
+}
 
+// Writes the changed settings in the background.
+void taskSettings(uint32_t nowMillis) {
+  settings_store::loop(nowMillis);
 }
 
+const char kLinTaskName[] PROGMEM = "LIN";
+const char kMotionTaskName[] PROGMEM = "MOTION";
+const char kSerialTaskName[] PROGMEM = "SERIAL";
+const char kButtonsTaskName[] PROGMEM = "BUTTONS";
+const char kTelemetryTaskName[] PROGMEM = "TELEMETRY";
+const char kSettingsTaskName[] PROGMEM = "SETTINGS";
+
+const scheduler::Task kTasks[] PROGMEM = {
+  { kLinTaskName, taskLin, scheduler::kEveryPass, 5, 0 },
+  { kMotionTaskName, taskMotion, scheduler::kEveryPass, 5, 0 },
+  { kSerialTaskName, taskSerial, scheduler::kEveryPass, 2, 0 },
+  { kButtonsTaskName, loopButtons, 1, 5, 1 },
+  { kTelemetryTaskName, taskTelemetry, 20, 50, 2 },
+  { kSettingsTaskName, taskSettings, scheduler::kEveryPass, scheduler::kNoDeadline,
+      scheduler::kBackground },
+};
 
 void setup() {
 
 
-  Serial.begin(115200);
-  while (!Serial) {;};
+  // Hard coded to 115.2k baud. Uses URART0, no interrupts.
+  sio::setup();
 
-  Serial.println("IKEA Hackant v1.0");
-  Serial.println("Type 'HELP' to display all commands.");
+  text_io::println(F("IKEA Hackant v1.0"));
+  text_io::println(F("Type 'HELP' to display all commands."));
 
   pinMode(moveTableUpPin, OUTPUT);
   pinMode(moveTableDownPin, OUTPUT);
 
-  pinMode(moveUpButton, INPUT);
-  pinMode(moveDownButton, INPUT);
-  pinMode(moveM1Button, INPUT);
-  pinMode(moveM2Button, INPUT);
-
-  Serial.print("moveUpButton ");
-  Serial.println(moveUpButton);
-  Serial.print("moveDownButton ");
-  Serial.println(moveDownButton);
-  Serial.print("moveM1Button ");
-  Serial.println(moveM1Button);
-  Serial.print("moveM2Button ");
-  Serial.println(moveM2Button);
+  buttons::setup();
+  for (uint8_t i = 0; i < ARRAY_SIZE(kButtons); i++) {
+    const uint8_t bit = buttonBit(i);
+    text_io::print(bit & buttons::kPortBMask ? F("Button PB") : F("Button PD"));
+    uint8_t bitIndex = 0;
+    while (!(bit & H(bitIndex))) {
+      bitIndex++;
+    }
+    text_io::printUint(bitIndex);
+    text_io::print(F(": "));
+    if (buttonPreset(i)) {
+      text_io::print(F("memory "));
+      text_io::printUint(buttonPreset(i));
+    } else {
+      text_io::print(buttonJog(i) == motion::kUp ? F("up") : F("down"));
+    }
+    text_io::println();
+  }
 
   digitalWrite(moveTableUpPin, HIGH);
   digitalWrite(moveTableDownPin, HIGH);
@@ -318,6 +1019,15 @@ void setup() {
   // setup everything that the LIN library needs.
   hardware_clock::setup();
   lin_processor::setup();
+  // Only the position frames are of interest. The others are dropped by
+  // the LIN decoder, unless it reads all of them for the bus statistics.
+  lin_processor::subscribe(kPositionFrameId, processPositionFrame);
+#if LIN_BUS_STATS
+  lin_stats::setup(system_clock::timeMillis());
+#endif
+#if LIN_TRACE
+  lin_trace::arm(kDefaultTraceConfig);
+#endif
 
   // Enable global interrupts.
   sei();
@@ -325,111 +1035,40 @@ void setup() {
 
 
 
-  EEPROM.get(0, targetThreshold);
-  if (targetThreshold == 255) {
-    storeThreshold(120);
+  if (!settings_store::setup()) {
+    loadLegacySettings();
   }
+  const settings_store::Settings& settings = settings_store::settings();
 
-  EEPROM.get(1, memOne);
-  if (memOne == 65535) {
-    storeM1(3500);
+  targetThreshold = settings.threshold;
+  if (targetThreshold == 255) {
+    storeThreshold(120);
   }
 
+  presets::setup();
 
-  EEPROM.get(3, memTwo);
-  if (memTwo == 65535) {
-    storeM2(3500);
-  }
+  // Until learned, coast as far as the old fixed threshold assumed.
+  coast_estimator::setup(targetThreshold);
+  motion::setup(driveMotor, targetThreshold);
 
   printValues();
 
-}
-
+  scheduler::setup(kTasks, ARRAY_SIZE(kTasks), system_clock::timeMillis());
+#if LOOP_PROFILER
+  loop_profiler::reset();
+#endif
+#if LIN_ISR_PROFILER
+  isr_profiler::reset(system_clock::timeMillis());
+#endif
 
+}
 
 void loop() {
-
+  loop_profiler::mark();
 
   // Periodic updates.
+  sio::loop();
   system_clock::loop();
 
-
-  // Handle recieved LIN frames.
-  LinFrame frame;
-
-  // if there is a LIN frame
-  if (lin_processor::readNextFrame(&frame)) {
-    processLINFrame(frame);
-  }
-
-  // direction == 0 => Table is levelled
-  // direction == 1 => Target is above table
-  // direction == 2 => Target is below table
-  uint8_t direction = desiredTableDirection();
-  moveTable(direction);
-
-
-  if (Serial.available() > 0) {
-
-    // read the incoming byte:
-    String val = Serial.readString();
-
-    if (val.indexOf("HELP") != -1 || val.indexOf("help") != -1) {
-      printHelp();
-    } else if (val.indexOf("VALUES") != -1 || val.indexOf("values") != -1) {
-      printValues();
-    } else if (val.indexOf("STOP") != -1 || val.indexOf("stop") != -1) {
-
-      if (direction == 1)
-        currentTarget = lastPosition + (targetThreshold * 2);
-      else if (direction == 2)
-        currentTarget = lastPosition - (targetThreshold * 2);
-
-      Serial.print("STOP at ");
-      Serial.println(currentTarget);
-
-
-    } else if (val.indexOf('T') != -1 || val.indexOf("t") != -1) {
-      uint8_t threshold = (uint8_t)val.substring(1).toInt();
-      storeThreshold(threshold);
-
-    } else if (val.indexOf("M1") != -1 || val.indexOf("m1") != -1) {
-
-      if (val.length() == 2) {
-        currentTarget = memOne;
-      } else {
-        storeM1(val.substring(2).toInt());
-      }
-
-
-    } else if (val.indexOf("M2") != -1 || val.indexOf("m2") != -1) {
-
-      if (val.length() == 2) {
-        currentTarget = memTwo;
-      } else {
-        storeM2(val.substring(2).toInt());
-      }
-
-    } else if (val.indexOf("S1") != -1 || val.indexOf("s1") != -1) {
-
-      storeM1(lastPosition);
-
-    } else if (val.indexOf("S2") != -1 || val.indexOf("s2") != -1) {
-
-      storeM2(lastPosition);
-
-    } else {
-      if (val.toInt() > 150 && val.toInt() < 6400) {
-        Serial.print("New Target ");
-        Serial.println(val);
-        currentTarget = val.toInt();
-      } else {
-        Serial.println("Not stored. Keep your value between 150 and 6400");
-      }
-    }
-  }
-
-  readButtons();
-  loopButtons();
-
+  scheduler::runPass(system_clock::timeMillis());
 }
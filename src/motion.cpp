@@ -0,0 +1,325 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "motion.h"
+
+#include "coast_estimator.h"
+#include "logger.h"
+
+namespace motion {
+  static MotorOutput motor_output;
+  static uint8 threshold;
+
+  static uint8 state_ = states::IDLE;
+  static uint8 motor;
+  // kUp or kDown, of the current or last move.
+  static uint8 move_direction;
+  // The current or last move is a jog, it has no target.
+  static boolean jogging;
+  // Jog held while the table settles, started once settled. kStop for none.
+  static uint8 pending_jog;
+
+  static boolean has_target;
+  static uint16 target_;
+
+  static boolean has_position;
+  static uint16 position;
+  static int16 velocity;
+  static uint32 position_millis;
+
+  // MOVING: last progress in the move direction. SETTLING: last position
+  // change.
+  static uint32 last_change_millis;
+  static uint32 move_start_millis;
+  static uint32 cut_millis;
+  static uint16 cut_position;
+  static int16 cut_speed;
+
+  static boolean has_deadline;
+  static uint32 deadline_;
+
+  // True if time a is before time b, across the millis wrap around.
+  static inline boolean isBefore(uint32 a, uint32 b) {
+    return (int32)(a - b) < 0;
+  }
+
+  static void setMotor(uint8 direction) {
+    if (direction != motor) {
+      motor = direction;
+      motor_output(direction);
+    }
+  }
+
+  // Signed distance from the table to the target, positive in the move
+  // direction.
+  static int32 distanceToTarget() {
+    const int32 distance = (int32)target_ - position;
+    return move_direction == kUp ? distance : -distance;
+  }
+
+  // Speed in the move direction.
+  static inline int16 moveSpeed() {
+    return move_direction == kUp ? velocity : -velocity;
+  }
+
+  // Distance left until the motor must be cut so that the table coasts to
+  // the target from its current speed.
+  static int32 distanceToCut() {
+    return distanceToTarget() - coast_estimator::coastDistance(move_direction, moveSpeed());
+  }
+
+  // The table stops at the target if the motor is cut now. Not before the
+  // table moves, so that a coast estimate longer than a short correction
+  // move does not cut it right away.
+  static boolean shouldCut() {
+    return distanceToTarget() <= 0 || (moveSpeed() > 0 && distanceToCut() <= 0);
+  }
+
+  static uint16 predictedPosition(uint32 now_millis) {
+    const int32 p = (int32)position +
+        (int32)velocity * (int32)(now_millis - position_millis) / 1000;
+    return p < 0 ? 0 : (p > 0xffff ? 0xffff : p);
+  }
+
+  static void updateDeadline(uint32 now_millis) {
+    has_deadline = false;
+    if (state_ == states::MOVING_UP || state_ == states::MOVING_DOWN) {
+      has_deadline = true;
+      deadline_ = last_change_millis + kStallMillis;
+      if (jogging) {
+        return;
+      }
+      const int16 speed = moveSpeed();
+      if (shouldCut()) {
+        deadline_ = now_millis;
+      } else if (speed > 0) {
+        const uint32 cut_at = position_millis + (uint32)(distanceToCut() * 1000 / speed);
+        if (isBefore(cut_at, deadline_)) {
+          deadline_ = cut_at;
+        }
+      }
+    } else if (state_ == states::SETTLING) {
+      has_deadline = true;
+      deadline_ = last_change_millis + kSettleMillis;
+    }
+  }
+
+  static void startMove(uint8 direction, boolean is_jog, uint32 now_millis) {
+    state_ = direction == kUp ? states::MOVING_UP : states::MOVING_DOWN;
+    move_direction = direction;
+    jogging = is_jog;
+    move_start_millis = now_millis;
+    last_change_millis = now_millis;
+    setMotor(direction);
+  }
+
+  // Starts a move if the target is outside the dead band.
+  static void startMoveToTarget(uint32 now_millis) {
+    if (!has_target || !has_position) {
+      return;
+    }
+    const int32 distance = (int32)target_ - position;
+    if (distance > threshold) {
+      startMove(kUp, false, now_millis);
+    } else if (distance < -(int32)threshold) {
+      startMove(kDown, false, now_millis);
+    }
+  }
+
+  static void cut(uint32 now_millis) {
+    setMotor(kStop);
+    state_ = states::SETTLING;
+    cut_millis = now_millis;
+    cut_position = predictedPosition(now_millis);
+    cut_speed = moveSpeed();
+    last_change_millis = now_millis;
+  }
+
+  static void settled(uint32 now_millis) {
+    state_ = states::IDLE;
+    const boolean learned = (cut_millis - move_start_millis) >= kMinLearnMillis;
+    if (learned) {
+      const int32 coast = move_direction == kUp ? (int32)position - cut_position
+          : (int32)cut_position - position;
+      coast_estimator::learn(move_direction, coast > 0 ? coast : 0, cut_speed);
+    }
+    if (logger::begin(logger::levels::INFO, logger::classes::MOTION)) {
+      logger::print(F("Move "));
+      logger::printUint(last_change_millis - move_start_millis);
+      logger::print(F(" ms"));
+      if (has_target && !jogging) {
+        logger::print(F(", error "));
+        logger::printInt((int32)position - target_);
+      }
+      logger::print(learned ? F(", coast ") : F(", not learned "));
+      logger::printUint(coast_estimator::learnedCoast(move_direction));
+      logger::print(F(" at "));
+      logger::printUint(coast_estimator::learnedSpeed(move_direction));
+      logger::end();
+    }
+    if (pending_jog != kStop) {
+      startMove(pending_jog, true, now_millis);
+      pending_jog = kStop;
+    } else if (!jogging) {
+      // Correction, if the table stopped outside the dead band.
+      startMoveToTarget(now_millis);
+    }
+  }
+
+  static void fault() {
+    setMotor(kStop);
+    state_ = states::FAULT;
+    has_target = false;
+    pending_jog = kStop;
+    if (logger::begin(logger::levels::ERROR, logger::classes::MOTION)) {
+      logger::print(F("Fault: table does not move. Send STOP."));
+      logger::end();
+    }
+  }
+
+  void setup(MotorOutput output, uint8 threshold_value) {
+    motor_output = output;
+    threshold = threshold_value;
+    state_ = states::IDLE;
+    motor = kStop;
+    has_target = false;
+    has_position = false;
+    has_deadline = false;
+    pending_jog = kStop;
+  }
+
+  void setThreshold(uint8 threshold_value) {
+    threshold = threshold_value;
+  }
+
+  void onPosition(uint16 new_position, int16 new_velocity, uint32 sample_millis,
+      uint32 now_millis) {
+    const boolean is_first = !has_position;
+    const boolean progress = move_direction == kUp ? new_position > position
+        : new_position < position;
+    // Not before the event that started the move or the cut.
+    const uint32 change_millis = isBefore(sample_millis, last_change_millis) ?
+        last_change_millis : sample_millis;
+    if ((state_ == states::MOVING_UP || state_ == states::MOVING_DOWN) && progress) {
+      last_change_millis = change_millis;
+    } else if (state_ == states::SETTLING && new_position != position) {
+      last_change_millis = change_millis;
+    }
+    position = new_position;
+    velocity = new_velocity;
+    position_millis = sample_millis;
+    has_position = true;
+
+    if (state_ == states::IDLE && is_first) {
+      // A target that arrived before the first position.
+      startMoveToTarget(now_millis);
+    } else if ((state_ == states::MOVING_UP || state_ == states::MOVING_DOWN) && !jogging &&
+        shouldCut()) {
+      cut(now_millis);
+    }
+    updateDeadline(now_millis);
+  }
+
+  void onTarget(uint16 new_target, uint32 now_millis) {
+    if (state_ == states::FAULT) {
+      return;
+    }
+    target_ = new_target;
+    has_target = true;
+    pending_jog = kStop;
+    // The target replaces a jog, also one that is settling.
+    jogging = false;
+    if (state_ == states::IDLE) {
+      startMoveToTarget(now_millis);
+    } else if (state_ == states::MOVING_UP || state_ == states::MOVING_DOWN) {
+      // Also when the target is behind the table. The move towards it
+      // starts once settled.
+      if (shouldCut()) {
+        cut(now_millis);
+      }
+    }
+    // SETTLING: the move to the new target starts once settled.
+    updateDeadline(now_millis);
+  }
+
+  void onJog(uint8 direction, uint32 now_millis) {
+    const boolean is_moving = state_ == states::MOVING_UP || state_ == states::MOVING_DOWN;
+    if (direction == kStop) {
+      pending_jog = kStop;
+      if (is_moving && jogging) {
+        cut(now_millis);
+      }
+    } else if (state_ == states::IDLE) {
+      has_target = false;
+      startMove(direction, true, now_millis);
+    } else if (is_moving) {
+      has_target = false;
+      jogging = true;
+      if (direction != move_direction) {
+        // The jog starts once settled.
+        pending_jog = direction;
+        cut(now_millis);
+      }
+    } else if (state_ == states::SETTLING) {
+      has_target = false;
+      pending_jog = direction;
+    }
+    updateDeadline(now_millis);
+  }
+
+  void onStop(uint32 now_millis) {
+    has_target = false;
+    pending_jog = kStop;
+    if (state_ == states::MOVING_UP || state_ == states::MOVING_DOWN) {
+      cut(now_millis);
+    } else if (state_ == states::FAULT) {
+      state_ = states::IDLE;
+    }
+    updateDeadline(now_millis);
+  }
+
+  void onTimeout(uint32 now_millis) {
+    if (!has_deadline || isBefore(now_millis, deadline_)) {
+      return;
+    }
+    if (state_ == states::MOVING_UP || state_ == states::MOVING_DOWN) {
+      if (!isBefore(now_millis, last_change_millis + kStallMillis)) {
+        fault();
+      } else {
+        cut(now_millis);
+      }
+    } else if (state_ == states::SETTLING) {
+      settled(now_millis);
+    }
+    updateDeadline(now_millis);
+  }
+
+  boolean hasDeadline() {
+    return has_deadline;
+  }
+
+  uint32 deadline() {
+    return deadline_;
+  }
+
+  uint8 state() {
+    return state_;
+  }
+
+  uint8 direction() {
+    return motor;
+  }
+
+  uint16 target() {
+    return has_target ? target_ : position;
+  }
+}  // namespace motion
@@ -0,0 +1,99 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "avr_util.h"
+
+// Table motion state machine. All motion decisions are made here, in
+// response to events: a new position, a new target, a jog button, a stop
+// request or a timeout. Nothing is done between events.
+//
+//   IDLE        -> MOVING_UP/DOWN  target more than the threshold away, or jog
+//                                  (also one held while moving the other
+//                                  way or settling, once settled)
+//   MOVING_*    -> SETTLING        motor cut: predicted coast reaches the
+//                                  target, stop, jog released or target
+//                                  behind the table
+//   SETTLING    -> IDLE            position stable for kSettleMillis. The
+//                                  coast is learned (coast_estimator.h) and
+//                                  a correction move may follow
+//   MOVING_*    -> FAULT           no progress for kStallMillis
+//   FAULT       -> IDLE            stop request only
+//
+// The motor cut between two position frames is a timeout at the time the
+// table is predicted to reach the cut point, from the last position, its
+// measurement time and the velocity. The caller checks deadline() and
+// delivers onTimeout().
+namespace motion {
+  // Like enum but 8 bits only.
+  namespace states {
+    static const uint8 IDLE = 1;
+    static const uint8 MOVING_UP = 2;
+    static const uint8 MOVING_DOWN = 3;
+    static const uint8 SETTLING = 4;
+    static const uint8 FAULT = 5;
+  }
+
+  // Motor directions.
+  static const uint8 kStop = 0;
+  static const uint8 kUp = 1;
+  static const uint8 kDown = 2;
+
+  // The table stopped when the position did not change for this time.
+  static const uint16 kSettleMillis = 300;
+  // Moves with less motor time than this are not learned from, the table
+  // did not reach full speed.
+  static const uint16 kMinLearnMillis = 1000;
+  // FAULT if the position does not move in the motor direction for this
+  // time, e.g. at the end stop or without position frames.
+  static const uint16 kStallMillis = 1500;
+
+  // Called only when the motor direction changes.
+  typedef void (*MotorOutput)(uint8 direction);
+
+  // threshold is the dead band for starting a move.
+  extern void setup(MotorOutput output, uint8 threshold);
+  extern void setThreshold(uint8 threshold);
+
+  // ----- Events -----
+
+  // A measured position and the current velocity (units per second).
+  // sample_millis is the time of the measurement, the end of its LIN frame,
+  // which can be some time before now when the frame waited in the queue.
+  extern void onPosition(uint16 position, int16 velocity, uint32 sample_millis,
+      uint32 now_millis);
+  // Move to the given position. Ignored in FAULT.
+  extern void onTarget(uint16 target, uint32 now_millis);
+  // Jog button pressed (kUp or kDown) or released (kStop). Ignored in
+  // FAULT. While moving the other way or settling the jog starts once
+  // settled.
+  extern void onJog(uint8 direction, uint32 now_millis);
+  // Cut the motor now and stay where the table coasts to. Clears FAULT.
+  extern void onStop(uint32 now_millis);
+  // Deliver when hasDeadline() and deadline() passed.
+  extern void onTimeout(uint32 now_millis);
+
+  extern boolean hasDeadline();
+  extern uint32 deadline();
+
+  // ----- State -----
+
+  extern uint8 state();
+  // Current motor direction.
+  extern uint8 direction();
+  // Last target, the position if none yet.
+  extern uint16 target();
+}  // namespace motion
+
+#endif
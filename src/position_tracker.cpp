@@ -0,0 +1,48 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "position_tracker.h"
+
+namespace position_tracker {
+  // Velocities are fixed point position units per tick, with 20 fraction
+  // bits. One bit is ~0.24 units per second.
+  static const uint8 kVelocityShift = 20;
+
+  // Larger position steps between two samples are not table motion. Also
+  // keeps the fixed point math in range.
+  static const int16 kMaxStep = 1023;
+
+  static uint16 last_position;
+  static uint16 last_ticks;
+  static boolean has_sample;
+  static int32 velocity_q20;
+
+  void addSample(uint16 position, uint16 timestamp_ticks) {
+    const uint16 dt = timestamp_ticks - last_ticks;
+    const int16 step = position - last_position;
+    if (!has_sample || dt > kMaxSampleGapTicks || step > kMaxStep || step < -kMaxStep) {
+      velocity_q20 = 0;
+    } else if (dt) {
+      const int32 sample_q20 = ((int32)step << kVelocityShift) / dt;
+      // Running average with a 1/4 weight for the new sample.
+      velocity_q20 += (sample_q20 - velocity_q20) / 4;
+    }
+    last_position = position;
+    last_ticks = timestamp_ticks;
+    has_sample = true;
+  }
+
+  int16 velocity() {
+    // ticks per second / 2^20 is 15625 / 2^16.
+    return (int16)((velocity_q20 * 15625) / ((int32)1 << 16));
+  }
+}  // namespace position_tracker
@@ -0,0 +1,36 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef POSITION_TRACKER_H
+#define POSITION_TRACKER_H
+
+#include "avr_util.h"
+#include "hardware_clock.h"
+
+// Table velocity from the position frames. Each decoded position comes
+// with the hardware clock time at the end of its LIN frame (stamped by the
+// decoder ISR). The tracker keeps a filtered velocity, with which motion.h
+// extrapolates the position from the frame time.
+//
+// Times are hardware_clock ticks, which wrap every ~262ms.
+namespace position_tracker {
+  // Velocity is reset if two samples are further apart than this.
+  static const uint16 kMaxSampleGapTicks = 200 * hardware_clock::kTicksPerMilli;
+
+  // Call with every decoded position, changed or not.
+  extern void addSample(uint16 position, uint16 timestamp_ticks);
+
+  // Filtered velocity in position units per second. Positive is up.
+  extern int16 velocity();
+}  // namespace position_tracker
+
+#endif
@@ -0,0 +1,41 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "presets.h"
+
+#include "settings_store.h"
+
+namespace presets {
+  void setup() {
+    settings_store::Settings settings = settings_store::settings();
+    for (uint8 i = 0; i < kCount; i++) {
+      if (!isValidPosition(settings.memory[i])) {
+        settings.memory[i] = kDefaultPosition;
+      }
+    }
+    settings_store::save(settings);
+  }
+
+  uint16 position(uint8 number) {
+    return settings_store::settings().memory[number - 1];
+  }
+
+  boolean store(uint8 number, uint16 position) {
+    if (!isValidNumber(number) || !isValidPosition(position)) {
+      return false;
+    }
+    settings_store::Settings settings = settings_store::settings();
+    settings.memory[number - 1] = position;
+    settings_store::save(settings);
+    return true;
+  }
+}  // namespace presets
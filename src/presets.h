@@ -0,0 +1,51 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include "avr_util.h"
+#include "custom_defs.h"
+
+// Memory presets: table positions recalled and stored by the buttons, the
+// M<n>/S<n> commands and the *_MEMORY requests. Numbered from 1. The
+// positions are one packed array in the settings_store record, read in
+// place.
+namespace presets {
+  static const uint8 kCount = custom_defs::kNumPresets;
+  static_assert(kCount >= 2 && kCount <= 16, "kNumPresets must be 2 to 16");
+
+  // Position of the presets never stored.
+  static const uint16 kDefaultPosition = 3500;
+
+  inline boolean isValidNumber(uint8 number) {
+    return number >= 1 && number <= kCount;
+  }
+
+  // Positions the table can be moved to, presets or not.
+  inline boolean isValidPosition(uint16 position) {
+    return position > 150 && position < 6400;
+  }
+
+  // Stores kDefaultPosition in the presets never stored. Call after
+  // settings_store::setup().
+  extern void setup();
+
+  // Position of a valid preset number.
+  extern uint16 position(uint8 number);
+
+  // Returns false and stores nothing if the number or the position is not
+  // valid.
+  extern boolean store(uint8 number, uint16 position);
+}  // namespace presets
+
+#endif
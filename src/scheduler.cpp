@@ -0,0 +1,121 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "scheduler.h"
+
+#include "hardware_clock.h"
+
+namespace scheduler {
+  static const Task* tasks;
+  static uint8 task_count;
+
+  // When each task is due next. The last start for the every pass tasks.
+  static uint32 due_millis[kMaxTasks];
+  static TaskStats stats[kMaxTasks];
+
+  static inline uint16 taskPeriod(uint8 index) {
+    return pgm_read_word(&tasks[index].period_millis);
+  }
+
+  static inline uint8 taskPriority(uint8 index) {
+    return pgm_read_byte(&tasks[index].priority);
+  }
+
+  static void runTask(uint8 index, uint32 now_millis) {
+    TaskStats& s = stats[index];
+    const uint32 late = now_millis - due_millis[index];
+    const uint16 deadline = pgm_read_word(&tasks[index].deadline_millis);
+    if (deadline != kNoDeadline && late > deadline && s.deadline_misses < 0xffff) {
+      s.deadline_misses++;
+    }
+    if (late > s.max_late_millis) {
+      s.max_late_millis = late > 0xffff ? 0xffff : late;
+    }
+
+    const TaskFunction run = (TaskFunction)pgm_read_word(&tasks[index].run);
+    const uint16 start_ticks = hardware_clock::ticksForNonIsr();
+    run(now_millis);
+    const uint16 ticks = hardware_clock::ticksForNonIsr() - start_ticks;
+
+    s.runs++;
+    s.total_ticks += ticks;
+    if (ticks > s.max_ticks) {
+      s.max_ticks = ticks;
+    }
+  }
+
+  void setup(const Task* table, uint8 count, uint32 now_millis) {
+    tasks = table;
+    task_count = count > kMaxTasks ? kMaxTasks : count;
+    for (uint8 i = 0; i < task_count; i++) {
+      due_millis[i] = now_millis + taskPeriod(i);
+      stats[i] = TaskStats();
+    }
+  }
+
+  void runPass(uint32 now_millis) {
+    uint8 best = task_count;
+    for (uint8 i = 0; i < task_count; i++) {
+      if (taskPeriod(i) == kEveryPass) {
+        if (taskPriority(i) != kBackground) {
+          runTask(i, now_millis);
+          due_millis[i] = now_millis;
+        }
+        continue;
+      }
+      if ((int32)(now_millis - due_millis[i]) < 0) {
+        continue;
+      }
+      if (best == task_count || taskPriority(i) < taskPriority(best) ||
+          (taskPriority(i) == taskPriority(best) &&
+              (int32)(due_millis[i] - due_millis[best]) < 0)) {
+        best = i;
+      }
+    }
+
+    if (best != task_count) {
+      runTask(best, now_millis);
+      // Periods missed entirely are skipped, not run back to back.
+      due_millis[best] += taskPeriod(best);
+      if ((int32)(now_millis - due_millis[best]) >= 0) {
+        due_millis[best] = now_millis + taskPeriod(best);
+      }
+      return;
+    }
+
+    for (uint8 i = 0; i < task_count; i++) {
+      if (taskPeriod(i) == kEveryPass && taskPriority(i) == kBackground) {
+        runTask(i, now_millis);
+        due_millis[i] = now_millis;
+      }
+    }
+  }
+
+  uint8 taskCount() {
+    return task_count;
+  }
+
+  const __FlashStringHelper* taskName(uint8 index) {
+    return reinterpret_cast<const __FlashStringHelper*>(pgm_read_word(&tasks[index].name));
+  }
+
+  const TaskStats& taskStats(uint8 index) {
+    return stats[index];
+  }
+
+  void clearMaxima() {
+    for (uint8 i = 0; i < task_count; i++) {
+      stats[i].max_ticks = 0;
+      stats[i].max_late_millis = 0;
+    }
+  }
+}  // namespace scheduler
@@ -0,0 +1,77 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "avr_util.h"
+
+// Cooperative scheduler of the main loop. Tasks are a PROGMEM table given to
+// setup(). Each runPass() runs:
+//
+// * the every pass tasks, in table order,
+// * then the due periodic task of the highest priority, one per pass so that
+//   a slow task delays the every pass tasks by one run at most,
+// * or, if no periodic task was due, the background tasks.
+//
+// A run that starts more than deadline_millis after the task was due (the
+// previous start for the every pass tasks) counts as a deadline miss. Times
+// are in system_clock millis, run times in hardware clock ticks.
+namespace scheduler {
+  typedef void (*TaskFunction)(uint32 now_millis);
+
+  // Task::period_millis of the tasks run on each pass.
+  static const uint16 kEveryPass = 0;
+  // Task::priority of the every pass tasks run only when idle.
+  static const uint8 kBackground = 255;
+  // Task::deadline_millis of the tasks without one.
+  static const uint16 kNoDeadline = 0;
+
+  static const uint8 kMaxTasks = 8;
+
+  struct Task {
+    // PROGMEM string.
+    const char* name;
+    TaskFunction run;
+    uint16 period_millis;
+    uint16 deadline_millis;
+    // Lower runs first. Ties go to the task due first.
+    uint8 priority;
+  };
+
+  struct TaskStats {
+    uint32 runs;
+    uint32 total_ticks;
+    uint16 max_ticks;
+    uint16 deadline_misses;
+    uint16 max_late_millis;
+  };
+
+  // tasks is a PROGMEM table of at most kMaxTasks. Periodic tasks are first
+  // due one period from now.
+  extern void setup(const Task* tasks, uint8 count, uint32 now_millis);
+
+  // Call from the main loop.
+  extern void runPass(uint32 now_millis);
+
+  extern uint8 taskCount();
+
+  // PROGMEM name of a task.
+  extern const __FlashStringHelper* taskName(uint8 index);
+
+  extern const TaskStats& taskStats(uint8 index);
+
+  // Resets max_ticks and max_late_millis of all tasks.
+  extern void clearMaxima();
+}  // namespace scheduler
+
+#endif
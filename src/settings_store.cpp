@@ -0,0 +1,254 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "settings_store.h"
+
+#include <string.h>
+
+#include "isr_latency.h"
+
+namespace settings_store {
+  static const uint8 kSequenceBytes = 4;
+  static const uint8 kCrcOffset = kRecordSize - 2;
+
+  static Settings current;
+  static Stats stats_;
+
+  // Slot and sequence of the next record.
+  static uint8 next_slot;
+  static uint32 next_sequence;
+
+  // A change is not written yet, since dirty_millis.
+  static boolean dirty;
+  static boolean dirty_time_pending;
+  static uint32 dirty_millis;
+
+  // The record being written by the ISR. Main fills it, and the offsets of
+  // the bytes that differ from the slot, while no write is in progress. The
+  // ISR writes one byte per call.
+  static uint8 record[kRecordSize];
+  static uint8 changed[kRecordSize];
+  static uint8 num_changed;
+  static uint16 record_address;
+  static volatile uint8 write_index;
+  static volatile boolean writing;
+  // Updated by the ISR.
+  static volatile uint16 bytes_written;
+
+  // Only while no write is in progress.
+  static uint8 readByte(uint16 address) {
+    EEAR = address;
+    EECR |= H(EERE);
+    return EEDR;
+  }
+
+  // CRC-16/CCITT-FALSE. Erased slots do not pass.
+  static uint16 crc16(const uint8* data, uint8 n) {
+    uint16 crc = 0xffff;
+    while (n--) {
+      crc ^= (uint16)*data++ << 8;
+      for (uint8 i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  static uint32 readSequence(uint8 slot) {
+    const uint16 address = (uint16)slot * kRecordSize;
+    uint32 sequence = 0;
+    for (uint8 i = kSequenceBytes; i-- > 0;) {
+      sequence = (sequence << 8) | readByte(address + i);
+    }
+    return sequence;
+  }
+
+  // The first record goes to slot 1 with sequence 1 and each next one to
+  // the next slot, so a record's sequence modulo kSlots is its slot. Other
+  // bytes (erased cells, the fixed address layout of older firmware) that
+  // fail this are not records.
+  static boolean isRecordSequence(uint8 slot, uint32 sequence) {
+    return sequence != 0 && sequence != 0xffffffff && sequence % kSlots == slot;
+  }
+
+  // Reads a slot into record[]. True if its CRC matches.
+  static boolean readRecord(uint8 slot) {
+    const uint16 address = (uint16)slot * kRecordSize;
+    for (uint8 i = 0; i < kRecordSize; i++) {
+      record[i] = readByte(address + i);
+    }
+    const uint16 crc = crc16(record, kCrcOffset);
+    return record[kCrcOffset] == (uint8)crc && record[kCrcOffset + 1] == (uint8)(crc >> 8);
+  }
+
+  boolean setup() {
+    // Wait for a write of the Arduino EEPROM library.
+    while (EECR & H(EEPE)) {
+    }
+    memset(&current, 0xff, sizeof(current));
+    memset(&stats_, 0, sizeof(stats_));
+    dirty = false;
+    writing = false;
+    bytes_written = 0;
+
+    // Slot 0 may hold the settings of older firmware until the journal
+    // wraps around and claims it, right after the last slot. Until then its
+    // bytes are ignored, also if they pass as a sequence by chance.
+    uint32 max_sequence = 0;
+    for (uint8 slot = 1; slot < kSlots; slot++) {
+      const uint32 sequence = readSequence(slot);
+      if (isRecordSequence(slot, sequence) && sequence > max_sequence) {
+        max_sequence = sequence;
+      }
+    }
+    const boolean slot0_claimed = readSequence(0) <= max_sequence + 1;
+
+    // The highest sequence below limit, 4 reads per slot. Then its record,
+    // normally valid on the first pass.
+    uint32 limit = 0xffffffff;
+    for (;;) {
+      uint8 best_slot = kSlots;
+      uint32 best_sequence = 0;
+      for (uint8 slot = slot0_claimed ? 0 : 1; slot < kSlots; slot++) {
+        const uint32 sequence = readSequence(slot);
+        if (!isRecordSequence(slot, sequence)) {
+          continue;
+        }
+        if (sequence < limit && (best_slot == kSlots || sequence > best_sequence)) {
+          best_slot = slot;
+          best_sequence = sequence;
+        }
+      }
+      if (best_slot == kSlots) {
+        // Nothing stored. Start at slot 1, slot 0 may hold the settings of
+        // the fixed address layout of older firmware.
+        next_slot = 1;
+        next_sequence = 1;
+        return false;
+      }
+      if (readRecord(best_slot)) {
+        memcpy(&current, record + kSequenceBytes, sizeof(current));
+        stats_.sequence = best_sequence;
+        next_slot = best_slot + 1 < kSlots ? best_slot + 1 : 0;
+        next_sequence = best_sequence + 1;
+        return true;
+      }
+      stats_.bad_records++;
+      limit = best_sequence;
+    }
+  }
+
+  const Settings& settings() {
+    return current;
+  }
+
+  void save(const Settings& settings) {
+    if (!memcmp(&settings, &current, sizeof(current))) {
+      return;
+    }
+    current = settings;
+    if (dirty) {
+      stats_.saves_coalesced++;
+      return;
+    }
+    dirty = true;
+    dirty_time_pending = true;
+  }
+
+  void loop(uint32 now_millis) {
+    if (!dirty) {
+      return;
+    }
+    if (dirty_time_pending) {
+      dirty_time_pending = false;
+      dirty_millis = now_millis;
+    }
+    if (writing || now_millis - dirty_millis < kWriteDelayMillis) {
+      return;
+    }
+
+    // Sequence first, CRC last. A record torn anywhere fails the CRC.
+    uint32 sequence = next_sequence;
+    for (uint8 i = 0; i < kSequenceBytes; i++) {
+      record[i] = (uint8)sequence;
+      sequence >>= 8;
+    }
+    memcpy(record + kSequenceBytes, &current, sizeof(current));
+    const uint16 crc = crc16(record, kCrcOffset);
+    record[kCrcOffset] = (uint8)crc;
+    record[kCrcOffset + 1] = (uint8)(crc >> 8);
+
+    record_address = (uint16)next_slot * kRecordSize;
+    // Compared here rather than in the ISR, where reading a slot that mostly
+    // holds the same values would block the LIN ISRs.
+    num_changed = 0;
+    for (uint8 i = 0; i < kRecordSize; i++) {
+      if (readByte(record_address + i) != record[i]) {
+        changed[num_changed++] = i;
+      } else {
+        stats_.bytes_skipped++;
+      }
+    }
+    stats_.sequence = next_sequence;
+    stats_.records_written++;
+    next_sequence++;
+    next_slot = next_slot + 1 < kSlots ? next_slot + 1 : 0;
+    dirty = false;
+    if (!num_changed) {
+      return;
+    }
+
+    write_index = 0;
+    writing = true;
+    MEMORY_BARRIER();
+    // EE_READY fires right away, no write is in progress.
+    EECR |= H(EERIE);
+  }
+
+  boolean pending() {
+    return dirty || writing;
+  }
+
+  const Stats& stats() {
+    // 16 bit, updated by the ISR.
+    cli();
+    stats_.bytes_written = bytes_written;
+    isr_latency::endSection(isr_latency::sections::STATS_COPY);
+    sei();
+    return stats_;
+  }
+
+  uint32 cellWrites() {
+    return (stats_.sequence + kSlots - 1) / kSlots;
+  }
+
+  // ----- ISR Handler -----
+
+  // EEPROM ready. Starts the write of the next changed byte of the record,
+  // or ends the record.
+  ISR(EE_READY_vect)
+  {
+    if (write_index < num_changed) {
+      const uint8 offset = changed[write_index++];
+      EEAR = record_address + offset;
+      EEDR = record[offset];
+      EECR |= H(EEMPE);
+      EECR |= H(EEPE);
+      bytes_written++;
+      isr_latency::endSection(isr_latency::sections::EEPROM_ISR);
+      return;
+    }
+    EECR &= ~H(EERIE);
+    writing = false;
+    isr_latency::endSection(isr_latency::sections::EEPROM_ISR);
+  }
+}  // namespace settings_store
@@ -0,0 +1,88 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include "avr_util.h"
+#include "custom_defs.h"
+
+// Persistent settings in a journal over the whole 1KB EEPROM. Each save
+// appends a record [sequence][settings][crc16] to the next slot, wrapping
+// around, so every cell wears at the same rate and a torn record never
+// destroys the latest good one. Boot loads the valid record with the
+// highest sequence.
+//
+// Saves only update the RAM copy. loop() starts the record write at most
+// kWriteDelayMillis after the first unsaved change, so a burst of changes
+// becomes one record. loop() compares the record with the slot, and the
+// bytes that differ are written from the EE_READY interrupt, one per call
+// every ~3.4ms. Nothing waits for the EEPROM in the main loop or the ISR.
+// Changes not written yet are lost on power loss.
+//
+// No other code may write the EEPROM once setup() was called.
+namespace settings_store {
+  // Fields never saved read as all ones (0xff, 0xffff).
+  struct Settings {
+    // See presets.h.
+    uint16 memory[custom_defs::kNumPresets];
+    // Learned by coast_estimator, indexed by direction - 1.
+    uint16 coast[2];
+    uint16 coast_speed[2];
+    uint8 threshold;
+  };
+
+  static const uint16 kEepromSize = 1024;
+  // Sequence, settings and CRC.
+  static const uint8 kRecordSize = 4 + sizeof(Settings) + 2;
+  static const uint8 kSlots = kEepromSize / kRecordSize;
+  static const uint16 kWriteDelayMillis = 1000;
+
+  struct Stats {
+    // Of the latest record. Counts the records of the EEPROM lifetime.
+    uint32 sequence;
+    // Since boot.
+    uint16 records_written;
+    uint16 bytes_written;
+    // Cells that already held the value.
+    uint16 bytes_skipped;
+    // Saves merged into an unwritten record.
+    uint16 saves_coalesced;
+    // Slots with a record sequence but a bad CRC at boot, e.g. torn by a
+    // power loss.
+    uint8 bad_records;
+  };
+
+  // Loads the latest valid record. Returns false if there is none, the
+  // settings are then all ones. Call with interrupts enabled, before the
+  // first save().
+  extern boolean setup();
+
+  extern const Settings& settings();
+
+  // Schedules a write if the settings changed.
+  extern void save(const Settings& settings);
+
+  // Call from the main loop.
+  extern void loop(uint32 now_millis);
+
+  // True while a save is not written yet.
+  extern boolean pending();
+
+  extern const Stats& stats();
+
+  // Erase and write cycles of the most worn cell so far. A cell endures
+  // about 100,000.
+  extern uint32 cellWrites();
+}  // namespace settings_store
+
+#endif